@@ -10,6 +10,15 @@ constexpr int WIN_HEIGHT    = 450;      ///< window height
 constexpr int WIN_PAD       =  75;      ///< distance from left and top border
 constexpr int WIN_COLL_OFS  =  30;      ///< offset of collated windows
 
+#if !IBM
+// strcpy_s is only available with Microsoft's C runtime
+static void strcpy_s (char* dest, size_t destSize, const char* src)
+{
+    std::strncpy(dest, src, destSize);
+    dest[destSize - 1] = '\0';
+}
+#endif
+
 // --- Global Variables ---
 
 // Is VR enabled?
@@ -20,6 +29,20 @@ typedef std::shared_ptr<ImgWindow> ImgWindowSPtrTy;
 typedef std::vector<ImgWindowSPtrTy> ImgWindowSPtrVecTy;
 ImgWindowSPtrVecTy gWndList;
 
+// Our menu and whether GPU timing of our windows is on
+XPLMMenuID gMenu = nullptr;
+int gMenuItemGpuTiming = -1;
+bool gGpuTiming = false;
+
+// The profiler window (if opened) and the flight loop counting the profiler's frames
+std::shared_ptr<ProfilerWindow> gProfilerWnd;
+XPLMFlightLoopID gProfilerFrameFL = nullptr;
+int gMenuItemProfiler = -1;
+
+// Recording of a trace file
+ImgTraceWriter gTraceWriter;
+int gMenuItemTrace = -1;
+
 // Calculate window's standard coordinates
 void CalcWinCoords (int& left, int& top, int& right, int& bottom)
 {
@@ -45,6 +68,78 @@ void AddWindow (XPLMWindowDecoration decoration = xplm_WindowDecorationRoundRect
     gWndList.emplace_back(std::make_shared<ImguiWidget>(left, top, right, bottom,
                                                         decoration,
                                                         layer));
+    gWndList.back()->SetGpuTiming(gGpuTiming);
+}
+
+// Saves GPU timing of all windows to Output/FlightMAX_GPU_timing.csv and logs a summary
+void SaveGpuTiming ()
+{
+    char path[512];
+    XPLMGetSystemPath(path);
+    const std::string fileName = std::string(path) + "Output" + XPLMGetDirectorySeparator() + "FlightMAX_GPU_timing.csv";
+    std::ofstream out(fileName);
+    if (!out) {
+        XPLMDebugString(("FlightMAX: Could not write " + fileName + "\n").c_str());
+        return;
+    }
+    out << "window,frame,gpu_ms\n";
+    char msg[256];
+    for (size_t i = 0; i < gWndList.size(); i++) {
+        const std::string label = "Window " + std::to_string(i+1);
+        gWndList[i]->WriteGpuTimingCSV(out, label);
+        const ImgGpuTimer::Stats stats = gWndList[i]->GetGpuTimingStats();
+        std::snprintf(msg, sizeof(msg), "FlightMAX: GPU time of %s: min %.3f / avg %.3f / p99 %.3f ms (%lu draws)\n",
+                      label.c_str(), stats.minMs, stats.avgMs, stats.p99Ms, (unsigned long)stats.samples);
+        XPLMDebugString(msg);
+    }
+    XPLMDebugString(("FlightMAX: GPU timing saved to " + fileName + "\n").c_str());
+}
+
+// Starts a new profiler frame once per sim frame
+float cbProfilerFrame (float, float, int, void*)
+{
+    IMG_PROFILE_NEW_FRAME();
+    return -1.0f;
+}
+
+// Opens the profiler window, or shows it if it exists already
+void ShowProfilerWindow ()
+{
+    if (gProfilerWnd) {
+        gProfilerWnd->SetVisible(true);
+        gProfilerWnd->BringWindowToFront();
+        return;
+    }
+    int left, top, right, bottom;
+    CalcWinCoords(left, top, right, bottom);
+    gProfilerWnd = std::make_shared<ProfilerWindow>(left, top, right, bottom);
+}
+
+// Starts or stops recording a trace to Output/FlightMAX_trace_<date>_<time>.json
+void ToggleTraceRecording ()
+{
+    if (gTraceWriter.IsRecording()) {
+        gTraceWriter.Stop();
+        char msg[128];
+        std::snprintf(msg, sizeof(msg), "FlightMAX: Trace recording stopped, %lu zones written, %lu lost\n",
+                      (unsigned long)gTraceWriter.GetNumWritten(), (unsigned long)gTraceWriter.GetNumLost());
+        XPLMDebugString(msg);
+    }
+    else {
+        char path[512];
+        XPLMGetSystemPath(path);
+        char stamp[32];
+        const std::time_t t = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&t));
+        const std::string fileName = std::string(path) + "Output" + XPLMGetDirectorySeparator() +
+                                     "FlightMAX_trace_" + stamp + ".json";
+        if (gTraceWriter.Start(fileName))
+            XPLMDebugString(("FlightMAX: Recording trace to " + fileName + "\n").c_str());
+        else
+            XPLMDebugString(("FlightMAX: Could not record trace to " + fileName + "\n").c_str());
+    }
+    XPLMCheckMenuItem(gMenu, gMenuItemTrace,
+                      gTraceWriter.IsRecording() ? xplm_Menu_Checked : xplm_Menu_Unchecked);
 }
 
 // Callback function for menu
@@ -78,6 +173,30 @@ void CBMenu (void* /*inMenuRef*/, void* inItemRef)
         AddWindow(xplm_WindowDecorationSelfDecoratedResizable,
                   xplm_WindowLayerFloatingWindows);
     }
+    // Toggle GPU timing of all windows?
+    else if (inItemRef == (void*)4)
+    {
+        gGpuTiming = !gGpuTiming;
+        for (ImgWindowSPtrTy& pWnd: gWndList)
+            if (!pWnd->SetGpuTiming(gGpuTiming))
+                gGpuTiming = false;         // not supported by the driver
+        XPLMCheckMenuItem(gMenu, gMenuItemGpuTiming, gGpuTiming ? xplm_Menu_Checked : xplm_Menu_Unchecked);
+    }
+    // Save GPU timing?
+    else if (inItemRef == (void*)5)
+    {
+        SaveGpuTiming();
+    }
+    // Show the profiler?
+    else if (inItemRef == (void*)6)
+    {
+        ShowProfilerWindow();
+    }
+    // Start/stop recording a trace?
+    else if (inItemRef == (void*)7)
+    {
+        ToggleTraceRecording();
+    }
 }
 
 
@@ -101,6 +220,21 @@ PLUGIN_API int XPluginStart(char * outName, char * outSig, char * outDesc) {
     XPLMAppendMenuItem(hMenu, "Collate All Windows",      (void*)1, 0);
     XPLMAppendMenuItem(hMenu, "Add Window (solid)",       (void*)2, 0);
     XPLMAppendMenuItem(hMenu, "Add Window (transparent)", (void*)3, 0);
+    XPLMAppendMenuSeparator(hMenu);
+    gMenuItemGpuTiming =
+    XPLMAppendMenuItem(hMenu, "GPU Timing",               (void*)4, 0);
+    XPLMAppendMenuItem(hMenu, "Save GPU Timing (CSV)",    (void*)5, 0);
+    XPLMCheckMenuItem(hMenu, gMenuItemGpuTiming, xplm_Menu_Unchecked);
+    gMenuItemProfiler =
+    XPLMAppendMenuItem(hMenu, "Profiler",                 (void*)6, 0);
+    gMenuItemTrace =
+    XPLMAppendMenuItem(hMenu, "Record Trace",             (void*)7, 0);
+    XPLMCheckMenuItem(hMenu, gMenuItemTrace, xplm_Menu_Unchecked);
+    if (!ImgProfiler::isEnabled()) {
+        XPLMEnableMenuItem(hMenu, gMenuItemProfiler, 0);
+        XPLMEnableMenuItem(hMenu, gMenuItemTrace, 0);
+    }
+    gMenu = hMenu;
 
     // Initialize random number generator
     std::srand((unsigned)std::time(nullptr));
@@ -112,19 +246,44 @@ PLUGIN_API void	XPluginStop(void) {
 }
 
 PLUGIN_API void XPluginDisable(void) {
+    // Finish a trace file being recorded
+    gTraceWriter.Stop();
+    XPLMCheckMenuItem(gMenu, gMenuItemTrace, xplm_Menu_Unchecked);
+
     // Destroy all window object in order to properly clean up.
     // (Can't use ImgWindow::SafeDelete here as that would wait for a
     //  flight loop callback, which won't be delivered any longer.
     //  Delete should be safe here as no rendering is taking place and will no longer.)
     gWndList.clear();
+    gProfilerWnd.reset();
+
+    // Stop counting profiler frames
+    if (gProfilerFrameFL) {
+        XPLMDestroyFlightLoop(gProfilerFrameFL);
+        gProfilerFrameFL = nullptr;
+    }
     
     // Cleanup the general stuff
     cleanupAfterImgWindow();
 }
 
 PLUGIN_API int XPluginEnable(void) {
+    IMG_PROFILE_ZONE("XPluginEnable");
+
     // Some general ImGui setup
     configureImgWindow();
+
+    // Count profiler frames, one per sim frame
+    if (ImgProfiler::isEnabled()) {
+        XPLMCreateFlightLoop_t flParams = {
+            sizeof(flParams),                           // structSize
+            xplm_FlightLoop_Phase_BeforeFlightModel,    // phase
+            cbProfilerFrame,                            // callbackFunc
+            nullptr,                                    // refcon
+        };
+        gProfilerFrameFL = XPLMCreateFlightLoop(&flParams);
+        XPLMScheduleFlightLoop(gProfilerFrameFL, -1.0f, true);
+    }
     
     // Create a first window
     AddWindow();
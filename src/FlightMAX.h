@@ -12,6 +12,10 @@
 	#include <string>
 	#include <vector>
 	#include <algorithm>
+	#include <cmath>
+	#include <cstdio>
+	#include <cstring>
+	#include <fstream>
 
 	// X-Plane SDK header
 	#include "XPLMDisplay.h"
@@ -27,9 +31,12 @@
 	#include "imgui.h"
 	#include "imgui_stdlib.h"
 	#include "ImgWindow.h"
+	#include "ImgProfiler.h"
+	#include "ImgTraceWriter.h"
 
 	// Our Window definition
 	#include "FlightMAX_starter_window.h"
+	#include "FlightMAX_profiler_window.h"
 
 	// Definitions for OpenFontIcons
 	#include "IconsFontAwesome5.h"
@@ -0,0 +1,200 @@
+// All our headers combined
+#include "FlightMAX.h"
+
+#include <map>
+
+//
+// MARK: ProfilerWindow
+//
+
+// Row height of the flame chart (in addition to text height)
+constexpr float FLAME_ROW_PAD = 4.0f;
+
+// A color per zone name: hue derived from the name
+static ImU32 zoneColor (const char* name)
+{
+    unsigned h = 2166136261u;                   // FNV-1a
+    for (const char* c = name; *c; ++c)
+        h = (h ^ (unsigned char)*c) * 16777619u;
+    return ImColor::HSV(float(h % 360) / 360.0f, 0.45f, 0.75f);
+}
+
+ProfilerWindow::ProfilerWindow(int left, int top, int right, int bot) :
+    ImgWindow(left, top, right, bot)
+{
+    // Disable reading/writing of "imgui.ini"
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+
+    SetWindowTitle("FlightMAX Profiler");
+    SetWindowResizingLimits(300, 200, 2048, 2048);
+    SetVisible(true);
+}
+
+void ProfilerWindow::buildInterface()
+{
+    if (!ImgProfiler::isEnabled()) {
+        ImGui::TextDisabled("The profiler is not compiled in (CMake option FLIGHTMAX_PROFILING).");
+        return;
+    }
+
+    // -- Controls --
+    ImGui::Checkbox("Pause", &bPaused);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(200.0f);
+    const bool bFramesChanged = ImGui::SliderInt("Frames", &numFrames, 1, 30);
+
+    // Collect the zones of the last complete frames (the current frame is still running).
+    // While paused we keep what we have unless the number of frames changes.
+    if (!bPaused || bFramesChanged) {
+        if (!bPaused)
+            lastFrame = ImgProfiler::currentFrame() > 0 ? ImgProfiler::currentFrame() - 1 : 0;
+        firstFrame = lastFrame >= std::uint32_t(numFrames - 1) ? lastFrame - std::uint32_t(numFrames - 1) : 0;
+        ImgProfiler::collect(firstFrame, lastFrame, events);
+    }
+
+    ImGui::SameLine();
+    ImGui::Text("Frames %u - %u, %lu zones", firstFrame, lastFrame, (unsigned long)events.size());
+
+    // Video memory we added to the sim's
+    const ImgWindow::VramUsage vram = ImgWindow::GetVramUsage();
+    ImGui::Text("VRAM: %.1f KiB font atlas, %.1f KiB window caches, %.1f KiB stream buffers, %.1f KiB images",
+                double(vram.fontAtlas) / 1024.0, double(vram.renderCaches) / 1024.0,
+                double(vram.streamBuffers) / 1024.0, double(vram.images) / 1024.0);
+    const ImgImageService::Stats images = ImgImageService::get().getStats();
+    ImGui::Text("Images: %u hits, %u misses, %u evictions, %.1f of %.1f MiB resident",
+                images.hits, images.misses, images.evictions,
+                double(images.bytesResident) / (1024.0 * 1024.0),
+                double(ImgImageService::get().getBudget()) / (1024.0 * 1024.0));
+
+    buildFlameChart();
+    ImGui::Spacing();
+    buildStatsTable();
+}
+
+void ProfilerWindow::buildFlameChart()
+{
+    if (events.empty()) {
+        ImGui::TextDisabled("No zones recorded yet.");
+        return;
+    }
+
+    // Time range: from start of first frame to start of the frame after the last one
+    std::uint64_t t0 = ImgProfiler::frameStart(firstFrame);
+    std::uint64_t t1 = ImgProfiler::frameStart(lastFrame + 1);
+    if (!t0) t0 = events.front().startNs;
+    for (const ImgProfiler::Event& ev: events) {
+        t0 = std::min(t0, ev.startNs);
+        if (!ImgProfiler::frameStart(lastFrame + 1))
+            t1 = std::max(t1, ev.endNs);
+    }
+    if (t1 <= t0) t1 = t0 + 1;
+
+    // Each thread gets as many rows as its deepest nesting needs
+    std::vector<int> threadRowBase;
+    for (const ImgProfiler::Event& ev: events) {
+        if (ev.thread >= threadRowBase.size())
+            threadRowBase.resize(ev.thread + 1, 0);
+        threadRowBase[ev.thread] = std::max(threadRowBase[ev.thread], ev.depth + 1);
+    }
+    int numRows = 0;
+    for (int& rows: threadRowBase) {
+        const int n = rows;
+        rows = numRows;                         // now: first row of this thread
+        numRows += n;
+    }
+
+    // Reserve the space
+    const float rowH = ImGui::GetTextLineHeight() + FLAME_ROW_PAD;
+    const ImVec2 p0 = ImGui::GetCursorScreenPos();
+    const float width = std::max(ImGui::GetContentRegionAvail().x, 50.0f);
+    ImGui::InvisibleButton("FlameChart", ImVec2(width, rowH * float(numRows)));
+    const bool bHovered = ImGui::IsItemHovered();
+    const ImVec2 mouse = ImGui::GetIO().MousePos;
+
+    ImDrawList* dl = ImGui::GetWindowDrawList();
+    const double scale = double(width) / double(t1 - t0);
+    dl->AddRectFilled(p0, ImVec2(p0.x + width, p0.y + rowH * float(numRows)), IM_COL32(0x20, 0x20, 0x20, 0xff));
+
+    // Frame boundaries
+    for (std::uint32_t f = firstFrame + 1; f <= lastFrame; f++) {
+        const std::uint64_t fs = ImgProfiler::frameStart(f);
+        if (fs > t0 && fs < t1) {
+            const float x = p0.x + float(double(fs - t0) * scale);
+            dl->AddLine(ImVec2(x, p0.y), ImVec2(x, p0.y + rowH * float(numRows)), IM_COL32(0x80, 0x80, 0x80, 0xff));
+        }
+    }
+
+    // The zones
+    const ImgProfiler::Event* hovered = nullptr;
+    for (const ImgProfiler::Event& ev: events) {
+        const float x1 = p0.x + float(double(ev.startNs - t0) * scale);
+        const float x2 = std::max(x1 + 1.0f, p0.x + float(double(ev.endNs - t0) * scale));
+        const float y1 = p0.y + rowH * float(threadRowBase[ev.thread] + ev.depth);
+        const ImVec4 rect(x1, y1, x2, y1 + rowH - 1.0f);
+        dl->AddRectFilled(ImVec2(rect.x, rect.y), ImVec2(rect.z, rect.w), zoneColor(ev.name));
+        if (x2 - x1 > 20.0f)
+            dl->AddText(nullptr, 0.0f, ImVec2(x1 + 2.0f, y1 + FLAME_ROW_PAD / 2.0f),
+                        IM_COL32_BLACK, ev.name, nullptr, 0.0f, &rect);
+        if (bHovered &&
+            mouse.x >= rect.x && mouse.x < rect.z &&
+            mouse.y >= rect.y && mouse.y < rect.w)
+            hovered = &ev;
+    }
+
+    if (hovered)
+        ImGui::SetTooltip("%s\n%.3f ms (frame %u)", hovered->name,
+                          double(hovered->endNs - hovered->startNs) / 1.0e6, hovered->frame);
+}
+
+void ProfilerWindow::buildStatsTable()
+{
+    // Aggregate per zone name
+    struct ZoneStatTy {
+        unsigned long   calls   = 0;
+        std::uint64_t   totalNs = 0;
+        std::uint64_t   maxNs   = 0;
+    };
+    std::map<std::string, ZoneStatTy> stats;
+    for (const ImgProfiler::Event& ev: events) {
+        ZoneStatTy& zs = stats[ev.name];
+        const std::uint64_t ns = ev.endNs - ev.startNs;
+        zs.calls++;
+        zs.totalNs += ns;
+        zs.maxNs = std::max(zs.maxNs, ns);
+    }
+
+    // Most expensive zones first
+    std::vector<std::pair<std::string, ZoneStatTy>> sorted(stats.begin(), stats.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<std::string, ZoneStatTy>& a, const std::pair<std::string, ZoneStatTy>& b)
+              { return a.second.totalNs > b.second.totalNs; });
+
+    const double frames = double(lastFrame - firstFrame + 1);
+    if (ImGui::BeginTable("ZoneStats", 5,
+                          ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders |
+                          ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupColumn("Zone", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Calls/frame", ImGuiTableColumnFlags_WidthFixed, 80);
+        ImGui::TableSetupColumn("ms/frame", ImGuiTableColumnFlags_WidthFixed, 70);
+        ImGui::TableSetupColumn("Avg ms", ImGuiTableColumnFlags_WidthFixed, 70);
+        ImGui::TableSetupColumn("Max ms", ImGuiTableColumnFlags_WidthFixed, 70);
+        ImGui::TableSetupScrollFreeze(0,1);
+        ImGui::TableHeadersRow();
+        for (const std::pair<std::string, ZoneStatTy>& z: sorted) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(z.first.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", double(z.second.calls) / frames);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", double(z.second.totalNs) / 1.0e6 / frames);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", double(z.second.totalNs) / 1.0e6 / double(z.second.calls));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", double(z.second.maxNs) / 1.0e6);
+        }
+        ImGui::EndTable();
+    }
+}
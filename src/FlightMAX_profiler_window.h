@@ -0,0 +1,32 @@
+#ifndef SRC_PROFILERWINDOW_H_
+#define SRC_PROFILERWINDOW_H_
+
+#include "ImgWindow.h"
+#include "ImgProfiler.h"
+#include <cstdint>
+#include <vector>
+
+// Shows the CPU profiler's zones of the last frames as flame chart and statistics table
+class ProfilerWindow: public ImgWindow {
+protected:
+    // Number of frames shown
+    int         numFrames   = 3;
+    // Freeze the view?
+    bool        bPaused     = false;
+    // Range of frames currently shown
+    std::uint32_t firstFrame = 0;
+    std::uint32_t lastFrame  = 0;
+    // Zones of the frames shown
+    std::vector<ImgProfiler::Event> events;
+public:
+    ProfilerWindow(int left, int top, int right, int bot);
+protected:
+    // Main function: creates the window's UI
+    void buildInterface() override;
+    // The flame chart: one row per nesting level, time from left to right
+    void buildFlameChart();
+    // Per-zone statistics
+    void buildStatsTable();
+};
+
+#endif /* SRC_PROFILERWINDOW_H_ */
@@ -2,9 +2,11 @@
 // All our headers combined
 #include "FlightMAX.h"
 
-// Image processing (for reading "imgui_demo.jpg"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+// Shader support for distance field fonts
+#include "XOGLUtils.h"
+
+// Images are loaded in the background
+#include "ImgImageService.h"
 
 //
 // MARK: ImGui extension: formatted IDs
@@ -65,8 +67,10 @@ namespace ImGui {
 // MARK: Global data and functions
 //
 
-// The raw TTF data of OpenFontIcons has been generated into the following file
-#include "fa-solid-900.inc"
+// The raw TTF data of OpenFontIcons, cut down at build time to the icons used in
+// our sources (tools/FontSubset.cpp), and the glyph ranges of these icons
+#include "fa-solid-900-subset.inc"
+#include "IconsUsed.h"
 
 // Initial data for the example table
 ImguiWidget::tableDataListTy TABLE_CONTENT = {
@@ -84,6 +88,8 @@ ImguiWidget::tableDataListTy TABLE_CONTENT = {
     {"N451QX","DHC-8-402","DH8D","Horizon Air Industries Inc",0.0f,true},
     {"N1125J","1125 WESTWIND ASTRA","ASTR","Djb Air Llc",0.0f,false},
     {"N250SH","AS 350 B2","AS50","Sundance Helicopters Inc",0.0f,true},
+    {"RA-89049","Sukhoi Superjet 100-95LR","SU95","Аэрофлот",0.0f,false},
+    {"SX-DGT","A320-232","A320","Αιγαίον",0.0f,true},
 };
 
 // To show how global values synch between window instances we declare here 2 global variables
@@ -97,62 +103,94 @@ const std::string IMAGE_NAME = "./Resources/plugins/FlightMAX/FlightMAX_demo.jpg
 
 // Font size, also roughly defines height of one line
 constexpr float FONT_SIZE = 15.0f;
+// Font size currently in use (can be changed in node "Fonts")
+float       g_fontSize  = FONT_SIZE;
+
+// Distance field fonts are baked once in this size and then scaled to any other
+constexpr float SDF_FONT_SIZE = 32.0f;
+// How many pixels around the glyph outlines the distance fields reach
+constexpr int   SDF_SPREAD    = 4;
+// Are we using distance field fonts? (if the driver can run the shader)
+bool        g_sdfFonts  = false;
+
+// Where the baked font atlas is kept between plugin starts
+static std::string fontCacheFile()
+{
+    char path[512];
+    XPLMGetSystemPath(path);
+    return std::string(path) + "Output" + XPLMGetDirectorySeparator() + "FlightMAX_font_atlas.cache";
+}
 
-/// Uses "stb_image" library to load a picture into memory
-/// @param fileName Path to image file
-/// @param[out] imgWidth Image width in pixel
-/// @param[out] imgHeight Image height in pixel
-/// @return texture id
-/// @exception std::runtime_error if image not found
-int loadImage(const std::string& fileName, int& imgWidth, int& imgHeight) {
-    int nComps;
-    uint8_t *data = stbi_load(fileName.c_str(), &imgWidth, &imgHeight, &nComps, sizeof(uint32_t));
-
-    if (!data) {
-        throw std::runtime_error(std::string("Couldn't load image: ") + stbi_failure_reason());
-    }
-
-    int id;
-    XPLMGenerateTextureNumbers(&id, 1);
-    XPLMBindTexture2d(id, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glPixelStorei  (GL_UNPACK_ROW_LENGTH, 0);
-    glTexImage2D   (GL_TEXTURE_2D, 0, GL_RGBA, imgWidth, imgHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+// Where the derived image textures are kept between plugin starts
+static std::string imageCachePrefix()
+{
+    char path[512];
+    XPLMGetSystemPath(path);
+    return std::string(path) + "Output" + XPLMGetDirectorySeparator() + "FlightMAX_image_";
+}
 
-    stbi_image_free(data);
+/// Creates the font atlas with all our fonts in the given size
+/// @param bSdf Bake distance fields in SDF_FONT_SIZE instead, scaled to `fontSize` when drawn
+/// @note Also runs on a worker thread when the font size changes, so no XPLM calls in here!
+static std::shared_ptr<ImgFontAtlas> makeFontAtlas(float fontSize, const std::string& cacheFile, bool bSdf)
+{
+  std::shared_ptr<ImgFontAtlas> atlas = std::make_shared<ImgFontAtlas>();
+  const float displaySize = fontSize;
+  if (bSdf)
+      fontSize = SDF_FONT_SIZE;
 
-    return id;
-}
+  // you can use any of these fonts that are provided with X-Plane or find you own.
+  // Currently you can only load one font and not sure if this might change in the future.
+  // atlas->AddFontFromFileTTF("./Resources/fonts/DejaVuSans.ttf", fontSize);
+  // atlas->AddFontFromFileTTF("./Resources/fonts/DejaVuSansMono.ttf", fontSize);
+  //atlas->AddFontFromFileTTF("./Resources/fonts/Inconsolata.ttf", fontSize);
+  //atlas->AddFontFromFileTTF("./Resources/fonts/ProFontWindows.ttf", fontSize);
+  // atlas->AddFontFromFileTTF("./Resources/fonts/Roboto-Bold.ttf", fontSize);
+  // atlas->AddFontFromFileTTF("./Resources/fonts/RobotoCondensed-Regular.ttf", fontSize);
+  // atlas->AddFontFromFileTTF("./Resources/fonts/Roboto-Light.ttf", fontSize);
+   atlas->AddFontFromFileTTF("./Resources/fonts/Roboto-Regular.ttf", fontSize);
+  // atlas->AddFontFromFileTTF("./Resources/fonts/tahomabd.ttf", fontSize);
+  //atlas->AddFontFromFileTTF("./Resources/fonts/ProggyClean.ttf", fontSize);
 
-/// Wrapper around loadImage() capturing the possible exception
-/// @param fileName Path to image file
-/// @param[out] imgSize Image size in pixel
-/// @return texture id for loaded image, or 0 in case of failure
-int try2load_image(const std::string& fileName, ImVec2& imgSize) {
-    try {
-        int imgWidth=0, imgHeight=0;
-        int ret = loadImage(fileName, imgWidth, imgHeight);
-        imgSize.x = float(imgWidth);
-        imgSize.y = float(imgHeight);
-        return ret;
-    } catch (const std::exception &e) {
-        std::string err = std::string("FlightMAX Error: ") + e.what() + " in " + fileName + "\n";
-        XPLMDebugString(err.c_str());
-        return 0;
+    
+    // Now we merge some icons from the OpenFontsIcons font into the above font (see `imgui/docs/FONTS.txt`)
+    ImFontConfig config;
+    config.MergeMode = true;
+    
+    // Merge the icon font with the text font. It only holds the ICON_FA_* icons
+    // used anywhere in our sources, which are exactly the glyphs we read from it.
+    atlas->AddFontFromMemoryCompressedTTF(fa_solid_900_compressed_data,
+                                          fa_solid_900_compressed_size,
+                                          fontSize,
+                                          &config,
+                                          ICONS_USED_RANGES);
+
+    // Names in the data may be in any script: Glyphs beyond the ranges above are
+    // rasterized when first shown instead of baking all of them up front.
+    // Roboto covers Latin, Greek and Cyrillic, other scripts need a fallback font.
+    atlas->enableGlyphCache();
+    // atlas->addGlyphSource("./Resources/plugins/FlightMAX/NotoSansCJK-Regular.ttc");
+
+    // The atlas holds coverage only, a single-channel texture needs a quarter of the VRAM
+    atlas->setCompactTexture(true);
+
+    // One distance field atlas serves all font sizes and window scales
+    if (bSdf) {
+        atlas->setDistanceField(SDF_SPREAD);
+        atlas->setFontScale(displaySize / SDF_FONT_SIZE);
     }
-}
 
-// Helper: Turns a string upper case
-inline std::string& toupper (std::string& s)
-{
-    std::for_each(s.begin(), s.end(), [](char& c) { c = toupper(c); });
-    return s;
+    // Keep the baked atlas between plugin starts, saves rasterizing the fonts on every enable
+    atlas->setCacheFile(cacheFile);
+    return atlas;
 }
 
 void configureImgWindow()
 {
-  ImgWindow::sFontAtlas = std::make_shared<ImgFontAtlas>();
+  g_sdfFonts = OGL_UtilsInit() && OGL_HasShaders();
+  ImgWindow::sFontAtlas = makeFontAtlas(g_fontSize, fontCacheFile(), g_sdfFonts);
+  // Mipmapped, and compressed if the GPU can, kept in Output/ so only the first load decodes
+  ImgImageService::get().setTextureCache(imageCachePrefix(), OGL_HasTextureCompression());
 
   // use actual parameters to configure the font, or use one of the other methods.
 
@@ -171,78 +209,39 @@ void configureImgWindow()
   // It's probably a bug that the instance of ImgWindow doesn't actually take a copy of the shared_ptr to ensure
   // the font atlas remains valid until it's destroyed.  I was working on a lot of things when I threw that update
   // together and I was heading down that path, but I think I forgot to finish it.
+}
 
-
-  // you can use any of these fonts that are provided with X-Plane or find you own.
-  // Currently you can only load one font and not sure if this might change in the future.
-  // ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/DejaVuSans.ttf", FONT_SIZE);
-  // ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/DejaVuSansMono.ttf", FONT_SIZE);
-  //ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/Inconsolata.ttf", FONT_SIZE);
-  //ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/ProFontWindows.ttf", FONT_SIZE);
-  // ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/Roboto-Bold.ttf", FONT_SIZE);
-  // ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/RobotoCondensed-Regular.ttf", FONT_SIZE);
-  // ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/Roboto-Light.ttf", FONT_SIZE);
-   ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/Roboto-Regular.ttf", FONT_SIZE);
-  // ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/tahomabd.ttf", FONT_SIZE);
-  //ImgWindow::sFontAtlas->AddFontFromFileTTF("./Resources/fonts/ProggyClean.ttf", FONT_SIZE);
-
-    
-    // Now we merge some icons from the OpenFontsIcons font into the above font (see `imgui/docs/FONTS.txt`)
-    ImFontConfig config;
-    config.MergeMode = true;
-    
-    // We only read very selectively the individual glyphs we are actually using to save on texture space
-    static ImVector<ImWchar> icon_ranges;
-    ImFontGlyphRangesBuilder builder;
-    // Add all icons that are actually used (they concatenate into one string)
-    builder.AddText(ICON_FA_TRASH_ALT ICON_FA_SEARCH
-                    ICON_FA_EXTERNAL_LINK_SQUARE_ALT
-                    ICON_FA_WINDOW_MAXIMIZE ICON_FA_WINDOW_MINIMIZE
-                    ICON_FA_WINDOW_RESTORE ICON_FA_WINDOW_CLOSE);
-    builder.BuildRanges(&icon_ranges);
-
-    // Merge the icon font with the text font
-    ImgWindow::sFontAtlas->AddFontFromMemoryCompressedTTF(fa_solid_900_compressed_data,
-                                                          fa_solid_900_compressed_size,
-                                                          FONT_SIZE,
-                                                          &config,
-                                                          icon_ranges.Data);
+// Rebuild all fonts in a new size, in the background so the sim doesn't stall
+void changeFontSize(float fontSize)
+{
+    g_fontSize = fontSize;
+    // Distance field fonts just get drawn at another scale
+    if (g_sdfFonts && ImgWindow::sFontAtlas) {
+        ImgWindow::sFontAtlas->setFontScale(fontSize / SDF_FONT_SIZE);
+        return;
+    }
+    ImgWindow::RebuildFontAtlas([fontSize, cacheFile = fontCacheFile()]() {
+        return makeFontAtlas(fontSize, cacheFile, false);
+    });
 }
 
 // Undo what we did in configureImgWindow()
 void cleanupAfterImgWindow()
 {
-    // We just destroy the font atlas
+    // We just destroy the font atlas, and any new one still in the making
+    ImgWindow::CancelFontAtlasRebuild();
     ImgWindow::sFontAtlas.reset();
+    // ...and all images
+    ImgImageService::get().shutdown();
 }
 
 //
 // MARK: ImguiWidget (our example implementation of ImguiWindow)
 //
 
-// texture number and size of the image we want to show
-// (static, because we want to load the image into a texture just once)
-int      ImguiWidget::image_id = 0;
-ImVec2   ImguiWidget::image_size;
-
 // Counter for the number of windows opened
 int      ImguiWidget::num_win = 0;
 
-// Does any text contain the characters in s?
-bool ImguiWidget::tableDataTy::contains (const std::string& s) const
-{
-    // try finding s in all our texts
-    for (const std::string& t: {reg, model, typecode, owner} )
-    {
-        std::string l = t;
-        if (toupper(l).find(s) != std::string::npos)
-            return true;
-    }
-    
-    // not found
-    return false;
-}
-
 ImguiWidget::ImguiWidget(int left, int top, int right, int bot,
                          XPLMWindowDecoration decoration,
                          XPLMWindowLayer layer) :
@@ -280,6 +279,10 @@ ImguiWidget::ImguiWidget(int left, int top, int right, int bot,
     //SetWindowTitle("FlightMAX v" IMGUI_VERSION " for XP11. (c) Dave Svab");
     SetWindowTitle("FlightMAX v" IMGUI_VERSION " for XP11. (c) Dave Svab");
     SetWindowResizingLimits(100, 100, 1024, 1024);
+    // Most of our content is static: only rebuild the UI on input or animation
+    SetRetainedMode(true);
+    // ...and redraw the cached texture in between, refreshing it at most 30 times a second
+    SetCachedRenderRate(30.0f);
     SetVisible(true);
     
     // Initialize the list content
@@ -288,20 +291,60 @@ ImguiWidget::ImguiWidget(int left, int top, int right, int bot,
         "6th line", "7th line", "8th line", "9th line", "10th line"
     };
     
-    // if not yet loaded: try loading an image for display
-    if (!image_id)
-        image_id = try2load_image(IMAGE_NAME, image_size);
+    // start loading an image for display
+    // (all windows share the same texture, the service counts references)
+    image_handle = ImgImageService::get().request(IMAGE_NAME);
     
     // copy initial table example data, init with random heading
-    tableList = TABLE_CONTENT;
-    for (tableDataTy& td: tableList)
-        td.heading = float(std::rand() % 3600) / 10.0f;
+    for (const tableDataTy& td: TABLE_CONTENT)
+        traffic.add(td.reg, td.model, td.typecode, td.owner,
+                    float(std::rand() % 3600) / 10.0f, td.turnsLeft);
 }
 
 ImguiWidget::~ImguiWidget()
 {
     if (flId)
         XPLMDestroyFlightLoop(flId);
+    // the texture may be evicted once no window uses it
+    ImgImageService::get().release(image_handle);
+}
+
+// Collect the rows passing the filter into tableRows, if needed
+void ImguiWidget::updateTableRows(const char* filter)
+{
+    if (!tableRowsDirty && !tableSearchDirty && tableRowsFilter == filter)
+        return;
+
+    // Rows added or deleted? Then index their texts again (sorting doesn't change rows)
+    if (tableSearchDirty) {
+        // (the pool has the upper case forms of interned texts ready)
+        const StringPool& pool = StringPool::get();
+        tableSearch.build(traffic.size(), [this, &pool](size_t i, std::vector<const char*>& texts)
+        {
+            texts.insert(texts.end(), { traffic.reg(i),
+                                        pool.upper(traffic.text(i, TrafficStore::COL_TYPECODE)),
+                                        pool.upper(traffic.text(i, TrafficStore::COL_MODEL)),
+                                        pool.upper(traffic.text(i, TrafficStore::COL_OWNER)) });
+        });
+        tableSearchDirty = false;
+    }
+    tableRowsFilter = filter;
+    tableRowsDirty = false;
+
+    // no filter defined -> display all
+    const std::vector<size_t>& found = tableSearch.find(filter);
+    if (found.size() == traffic.size()) {
+        tableRows = traffic.order();
+        return;
+    }
+    // ...otherwise the rows found, in sort order
+    tableRowMatches.assign(traffic.size(), 0);
+    for (size_t row: found)
+        tableRowMatches[row] = 1;
+    tableRows.clear();
+    for (size_t row: traffic.order())
+        if (tableRowMatches[row])
+            tableRows.push_back(row);
 }
 
 void ImguiWidget::buildInterface() {
@@ -309,6 +352,9 @@ void ImguiWidget::buildInterface() {
     float win_width = ImGui::GetWindowWidth();
     float win_height = ImGui::GetWindowHeight();
 
+    // How often do we need rebuilding for animated content? (Nodes below increase it as needed)
+    float animRate = 0.0f;
+
     // If we are a transparent HUD-like window then we draw 3 lines that look
     // a bit like a head...so people know where to drag the window to move it
     if (HasWindowDragArea()) {
@@ -327,7 +373,7 @@ void ImguiWidget::buildInterface() {
 
     // Button with fixed width 30 and standard height
     // to pop out the window in an OS window
-    static float btnWidth = ImGui::CalcTextSize(ICON_FA_WINDOW_MAXIMIZE).x + 5;
+    const float btnWidth = ImGui::CalcTextSize(ICON_FA_WINDOW_MAXIMIZE).x + 5;
     const bool bBtnPopOut = !IsPoppedOut();
     const bool bBtnPopIn  = IsPoppedOut() || IsInVR();
     const bool bBtnVR     = vr_is_enabled && !IsInVR();
@@ -490,6 +536,8 @@ void ImguiWidget::buildInterface() {
         ImGui::DragFloat("Drag Float", &g_dragVal1, 1.0, 0, 1000, "%.2f", 0);
         ImGui::DragInt("Drag Int", &g_dragVal2, 1.0, 0, 1000, "%d");
         ImGui::TextUnformatted("Note: These values are global and synched between windows.");
+        // other windows may change the values any time
+        animRate = std::max(animRate, 10.0f);
         ImGui::TreePop();
     }
 
@@ -575,10 +623,9 @@ void ImguiWidget::buildInterface() {
     }
 
     if (ImGui::TreeNode("Images")) {
-        ImGui::Text("image_id = %d", image_id);
-        // Draw a previously loaded image
-        if (image_id)
-            ImGui::Image((void*)(intptr_t)image_id, image_size);
+        ImGui::Text("image_handle = %d", image_handle);
+        // Draw the image, or a placeholder while it is still loading
+        ImgImageService::get().image(image_handle);
 
         ImGui::TreePop();
     }
@@ -646,18 +693,11 @@ void ImguiWidget::buildInterface() {
         
         static char sFilter[100];
         // Note: "##SearchText" creates a unique id, but due to ## it doesn't create a label"
-        if (ImGui::InputTextWithHint("##SearchText", ICON_FA_SEARCH " Search", sFilter, IM_ARRAYSIZE(sFilter),
-                             ImGuiInputTextFlags_CharsUppercase |
-                             ImGuiInputTextFlags_CharsNoBlank))
-        {
-            // determine if an item is to be shown
-            for (tableDataTy& td: tableList) {
-                if (sFilter[0])         // some filter defined
-                    td.filtered = td.contains(sFilter);
-                else                    // no filter defined -> display all
-                    td.filtered = true;
-            }
-        }
+        ImGui::InputTextWithHint("##SearchText", ICON_FA_SEARCH " Search", sFilter, IM_ARRAYSIZE(sFilter),
+                                 ImGuiInputTextFlags_CharsUppercase |
+                                 ImGuiInputTextFlags_CharsNoBlank);
+        // determine which rows are to be shown (the filter is shared with the other windows)
+        updateTableRows(sFilter);
         
         // -- The table --
         
@@ -672,14 +712,9 @@ void ImguiWidget::buildInterface() {
                               ImGuiTableFlags_ScrollX | ImGuiTableFlags_ScrollY))
         {
             // Prepare our data: We fake some movement by turning the planes (1° per second)
-            const ImGuiIO& io = ImGui::GetIO();
-            for (tableDataTy& td: tableList) {
-                if (td.turnsLeft) {
-                    if ((td.heading -= io.DeltaTime) <    0.0f) td.heading += 360.0;
-                } else {
-                    if ((td.heading += io.DeltaTime) >= 360.0f) td.heading -= 360.0;
-                }
-            }
+            // Headings are shown in full degrees, so a few updates per second suffice
+            animRate = std::max(animRate, 4.0f);
+            traffic.turn(ImGui::GetIO().DeltaTime);
             
             // Set up the columns of the table
             ImGui::TableSetupColumn("Tail", ImGuiTableColumnFlags_DefaultSort, 60);
@@ -696,95 +731,85 @@ void ImguiWidget::buildInterface() {
             ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
             if (sortSpecs && sortSpecs->SpecsDirty &&
                 sortSpecs->Specs && sortSpecs->SpecsCount >= 1 &&
-                tableList.size() > 1)
+                traffic.size() > 1)
             {
                 // We sort only by one column, no multi-column sort yet
                 const ImGuiTableColumnSortSpecs& colSpec = *(sortSpecs->Specs);
-                // We directly sort the tableList
-                std::sort(tableList.begin(), tableList.end(),
-                          [colSpec](const tableDataTy& a, const tableDataTy& b)
-                {
-                    int cmp =       // less than 0 if a < b
-                    colSpec.ColumnIndex == 0 ? a.reg.compare(b.reg)             :
-                    colSpec.ColumnIndex == 1 ? a.typecode.compare(b.typecode)   :
-                    colSpec.ColumnIndex == 2 ? a.model.compare(b.model)         :
-                    colSpec.ColumnIndex == 3 ? a.owner.compare(b.owner)         :
-                    colSpec.ColumnIndex == 4 ? int(a.heading - b.heading)       :
-                    colSpec.ColumnIndex == 5 ? a.turnsLeft - b.turnsLeft        : 0;
-                    
-                    return colSpec.SortDirection == ImGuiSortDirection_Ascending ?
-                    cmp < 0 : cmp > 0;
-                });
+                // Only the sort order changes, the rows stay where they are
+                traffic.sort(TrafficStore::Column(colSpec.ColumnIndex),
+                             colSpec.SortDirection == ImGuiSortDirection_Ascending);
                 sortSpecs->SpecsDirty = false;
+                tableRowsDirty = true;
+                updateTableRows(sFilter);
             }
 
             // Here we remember which row to delete if any
-            tableDataListTy::iterator delIter = tableList.end();
-
-            // Add rows to the table
-            for (auto iter = tableList.begin(); iter != tableList.end(); ++iter)
-            {
-                tableDataTy& td = *iter;
-                
-                // Skip rows which are not currently filtered
-                if (!td.filtered) continue;
+            size_t delIdx = traffic.size();
+
+            // Add rows to the table, but only those visible:
+            // the clipper skips the others, just advancing the layout by their height
+            ImGuiListClipper clipper;
+            clipper.Begin(int(tableRows.size()));
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                    const size_t idx = tableRows[size_t(row)];
+
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(traffic.reg(idx));
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(traffic.typecode(idx));
+                    ImGui::TableNextColumn();
+                    RequestGlyphs(traffic.model(idx));
+                    ImGui::TextUnformatted(traffic.model(idx));
+                    ImGui::TableNextColumn();
+                    RequestGlyphs(traffic.owner(idx));
+                    ImGui::TextUnformatted(traffic.owner(idx));
+                    ImGui::TableNextColumn();
+                    // Heading: left = red / right = green
+                    bool bTurnsLeft = traffic.turnsLeft(idx);
+                    float& heading = traffic.heading(idx);
+                    ImGui::TextColored(bTurnsLeft ? ImColor(255, 0, 0) : ImColor(0, 255, 0),
+                                       "%03.0f", heading);
+                    // action widget require a unique id per table row (otherwise only the first line's widget work),
+                    // one id scope per row, the widgets within differ by their labels
+                    ImGui::PushID(int(idx));
+                    // Checkbox
+                    ImGui::TableNextColumn();
+                    if (ImGui::Checkbox("##Left", &bTurnsLeft))
+                        traffic.setTurnsLeft(idx, bTurnsLeft);
                 
-                ImGui::TableNextRow();
-                ImGui::TableNextColumn();
-                ImGui::TextUnformatted(td.reg.c_str());
-                ImGui::TableNextColumn();
-                ImGui::TextUnformatted(td.typecode.c_str());
-                ImGui::TableNextColumn();
-                ImGui::TextUnformatted(td.model.c_str());
-                ImGui::TableNextColumn();
-                ImGui::TextUnformatted(td.owner.c_str());
-                ImGui::TableNextColumn();
-                // Heading: left = red / right = green
-                ImGui::TextColored(td.turnsLeft ? ImColor(255, 0, 0) : ImColor(0, 255, 0),
-                                   "%03.0f", td.heading);
-                // Checkbox
-                ImGui::TableNextColumn();
-                ImGui::PushID_formatted("Left_%p", (void*)&td); // action widget require a unique id per table row (otherwise only the first line's widget work)
-                ImGui::Checkbox("", &td.turnsLeft);
-                ImGui::PopID();
-                
-                // Actions: A few buttons
-                ImGui::TableNextColumn();
+                    // Actions: A few buttons
+                    ImGui::TableNextColumn();
 
-                ImGui::PushID_formatted("N_%p", (void*)&td);   // North
-                if (ImGui::ArrowButton("", ImGuiDir_Up))
-                    td.heading = 0.0f;
-                ImGui::PopID();
+                    if (ImGui::ArrowButton("N", ImGuiDir_Up))       // North
+                        heading = 0.0f;
 
-                ImGui::SameLine();
-                ImGui::PushID_formatted("E_%p", (void*)&td);   // East
-                if (ImGui::ArrowButton("", ImGuiDir_Right))
-                    td.heading = 90.0f;
-                ImGui::PopID();
+                    ImGui::SameLine();
+                    if (ImGui::ArrowButton("E", ImGuiDir_Right))    // East
+                        heading = 90.0f;
 
-                ImGui::SameLine();
-                ImGui::PushID_formatted("S_%p", (void*)&td);   // South
-                if (ImGui::ArrowButton("", ImGuiDir_Down))
-                    td.heading = 180.0f;
-                ImGui::PopID();
+                    ImGui::SameLine();
+                    if (ImGui::ArrowButton("S", ImGuiDir_Down))     // South
+                        heading = 180.0f;
 
-                ImGui::SameLine();
-                ImGui::PushID_formatted("W_%p", (void*)&td);   // West
-                if (ImGui::ArrowButton("", ImGuiDir_Left))
-                    td.heading = 270.0f;
-                ImGui::PopID();
+                    ImGui::SameLine();
+                    if (ImGui::ArrowButton("W", ImGuiDir_Left))     // West
+                        heading = 270.0f;
 
-                ImGui::SameLine();
-                ImGui::PushID_formatted("Del_%p", (void*)&td);
-                if (ImGui::ButtonTooltip(ICON_FA_TRASH_ALT, "Delete row"))
-                    // remember the row to delete, but don't delete right now
-                    delIter = iter;
-                ImGui::PopID();
+                    ImGui::SameLine();
+                    if (ImGui::ButtonTooltip(ICON_FA_TRASH_ALT "##Del", "Delete row"))
+                        // remember the row to delete, but don't delete right now
+                        delIdx = idx;
+                    ImGui::PopID();
+                }
             }
             
             // Now only delete a row if requested to do so
-            if (delIter != tableList.end())
-                tableList.erase(delIter);
+            if (delIdx < traffic.size()) {
+                traffic.erase(delIdx);
+                tableSearchDirty = true;
+            }
 
             // -- Add a row to enter new data
             static char sTail[10] = "", sType[5] = "", sModel[100] = "", sOwner[100] = "";
@@ -814,9 +839,8 @@ void ImguiWidget::buildInterface() {
             if (sTail[0] && sType[0] && sModel[0] && sOwner[0]) {
                 ImGui::PushID("New_Add");
                 if (ImGui::SmallButton("Add")) {
-                    tableList.emplace_back(tableDataTy{
-                        sTail, sModel, sType, sOwner, float(iHead), bLeft
-                    });
+                    traffic.add(sTail, sModel, sType, sOwner, float(iHead), bLeft);
+                    tableSearchDirty = true;
                     // init our static text for a new entry
                     sTail[0] = '\0';
                     sType[0] = '\0';
@@ -843,7 +867,26 @@ void ImguiWidget::buildInterface() {
 
     if (ImGui::TreeNode("Fonts")) {
 
-        ImGui::Text("Default DejaVuSansMono.ttf %.1f font \n", FONT_SIZE);
+        ImGui::Text("Default DejaVuSansMono.ttf %.1f font \n", g_fontSize);
+        if (g_sdfFonts)
+            ImGui::Text("Distance field atlas baked at %.0f", SDF_FONT_SIZE);
+
+        // A new size means a new font atlas, which is built in the background
+        // (unless distance field fonts are just drawn larger or smaller)
+        static float newFontSize = g_fontSize;
+        ImGui::SliderFloat("Font size", &newFontSize, 8.0f, 32.0f, "%.0f");
+        if (ImGui::IsItemDeactivatedAfterEdit())
+            changeFontSize(std::round(newFontSize));
+        if (ImgWindow::IsRebuildingFontAtlas()) {
+            ImGui::SameLine();
+            ImGui::TextUnformatted("Rebuilding...");
+            animRate = std::max(animRate, 10.0f);
+        }
+
+        // Scales the text of just this window, as one would for VR or a high-DPI pop-out
+        float winFontScale = GetFontScale();
+        if (ImGui::SliderFloat("Window text scale", &winFontScale, 0.5f, 3.0f, "%.2f"))
+            SetFontScale(winFontScale);
 
         ImGui::TextUnformatted("");
         // Green color
@@ -876,11 +919,14 @@ void ImguiWidget::buildInterface() {
         ImGui::TreePop();
 
     }
+
+    SetAnimationRate(animRate);
 }
 
 // Outside all rendering we can change things like window mode
 float ImguiWidget::cbFlightLoop(float, float, int, void* inRefcon)
 {
+    IMG_PROFILE_ZONE("ImguiWidget::cbFlightLoop");
     // refcon is pointer to ImguiWidget
     ImguiWidget& wnd = *reinterpret_cast<ImguiWidget*>(inRefcon);
 
@@ -2,19 +2,23 @@
 #define SRC_IMGUIWIDGET_H_
 
 #include "ImgWindow.h"
+#include "ImgImageService.h"
+#include "FlightMAX_table_search.h"
+#include "FlightMAX_traffic_store.h"
 #include <vector>
 
 // Configure one-time setup like fonts
 void configureImgWindow();
+// Rebuild the fonts in another size (in the background)
+void changeFontSize(float fontSize);
 // Cleanup one-time setup
 void cleanupAfterImgWindow();
 
 // Our own class defining our own UI
 class ImguiWidget: public ImgWindow {
 protected:
-    // texture number and size of the image we want to show
-    static int      image_id;
-    static ImVec2   image_size;
+    // the image we want to show
+    ImgImageService::Handle image_handle = 0;
     // Counter for the number of windows opened
     static int      num_win;
     // I am window number...
@@ -43,22 +47,31 @@ protected:
     int         listSelItem = 0;
     // Structure and data used for displaying a table
 public:
+    // One row as initially defined, traffic interns the texts
     struct tableDataTy {
-        std::string     reg;
-        std::string     model;
-        std::string     typecode;
-        std::string     owner;
+        const char*     reg;
+        const char*     model;
+        const char*     typecode;
+        const char*     owner;
         float           heading = 0.0f;
         bool            turnsLeft = false;
-        bool            filtered = true;    // included in search result?
-        
-        // is s (upper cased!) in any text?
-        bool contains (const std::string& s) const;
-        
     };
     typedef std::vector<tableDataTy> tableDataListTy;
 protected:
-    tableDataListTy     tableList;
+    // The table's rows, stored by column
+    TrafficStore        traffic;
+    // Rows of traffic passing the filter, in sort order
+    std::vector<size_t> tableRows;
+    // Search index over the texts of traffic
+    TableSearchIndex    tableSearch;
+    // Rows matching the filter, by row, while making tableRows
+    std::vector<std::uint8_t> tableRowMatches;
+    // Filter text tableRows was made for
+    std::string         tableRowsFilter;
+    // Sort order changed, so tableRows needs to be made again
+    bool                tableRowsDirty = true;
+    // Rows were added or deleted, so also tableSearch needs to be made again
+    bool                tableSearchDirty = true;
 public:
     ImguiWidget(int left, int top, int right, int bot,
                 XPLMWindowDecoration decoration = xplm_WindowDecorationRoundRectangle,
@@ -68,6 +81,9 @@ protected:
     // Main function: creates the window's UI
     void buildInterface() override;
 
+    // Collect the rows passing the filter into tableRows, if needed
+    void updateTableRows(const char* filter);
+
     // flight loop callback for stuff we cannot do during drawing callback
     static float cbFlightLoop(
         float                inElapsedSinceLastCall,
@@ -0,0 +1,136 @@
+// Just the pool, so that benchmarks can do without X-Plane
+#include "FlightMAX_string_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+//
+// MARK: StringPool
+//
+
+// C++14 wants definitions of the constants passed by reference
+constexpr StringPool::Handle StringPool::EMPTY;
+constexpr StringPool::Handle StringPool::NO_HANDLE;
+constexpr size_t StringPool::BLOCK_SIZE;
+
+// FNV-1a, 32 bit
+static std::uint32_t hashOf(const char* s, size_t len)
+{
+    std::uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+StringPool& StringPool::get()
+{
+    static StringPool thePool;
+    return thePool;
+}
+
+StringPool::StringPool()
+{
+    table.assign(1024, NO_HANDLE);
+    intern("", 0);                              // becomes EMPTY
+}
+
+char* StringPool::store(const char* s, size_t len)
+{
+    char* p = nullptr;
+    if (len + 1 > BLOCK_SIZE / 4) {
+        // Long strings get a block of their own, the next string starts a new block
+        blocks.emplace_back(new char[len + 1]);
+        arenaBytes += len + 1;
+        p = blocks.back().get();
+        blockUsed = BLOCK_SIZE;
+    } else {
+        if (blockUsed + len + 1 > BLOCK_SIZE) {
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            arenaBytes += BLOCK_SIZE;
+            blockUsed = 0;
+        }
+        p = blocks.back().get() + blockUsed;
+        blockUsed += len + 1;
+    }
+    std::memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+void StringPool::growTable()
+{
+    table.assign(table.size() * 2, NO_HANDLE);
+    const size_t mask = table.size() - 1;
+    for (Handle h = 0; h < entries.size(); ++h) {
+        size_t slot = entries[h].hash & mask;
+        while (table[slot] != NO_HANDLE)
+            slot = (slot + 1) & mask;
+        table[slot] = h;
+    }
+}
+
+StringPool::Handle StringPool::intern(const char* s)
+{
+    return intern(s, std::strlen(s));
+}
+
+StringPool::Handle StringPool::intern(const char* s, size_t len)
+{
+    const std::uint32_t h = hashOf(s, len);
+    const size_t mask = table.size() - 1;
+    size_t slot = h & mask;
+    for (; table[slot] != NO_HANDLE; slot = (slot + 1) & mask) {
+        const Entry& e = entries[table[slot]];
+        if (e.hash == h && e.len == len && std::memcmp(e.str, s, len) == 0)
+            return table[slot];
+    }
+
+    // New string, also keep its upper case form unless it's the same
+    Entry e;
+    e.str = store(s, len);
+    e.upper = e.str;
+    e.len = std::uint32_t(len);
+    e.hash = h;
+    const char* lower = std::find_if(s, s + len, [](char c) { return c >= 'a' && c <= 'z'; });
+    if (lower != s + len) {
+        char* up = store(s, len);
+        for (char* c = up + (lower - s); c < up + len; ++c)
+            if (*c >= 'a' && *c <= 'z')
+                *c = char(*c - 'a' + 'A');
+        e.upper = up;
+    }
+    const Handle handle = Handle(entries.size());
+    entries.push_back(e);
+    table[slot] = handle;
+
+    // Keep the table at most half full, so probe sequences stay short
+    if (entries.size() * 2 > table.size())
+        growTable();
+    return handle;
+}
+
+const std::vector<std::uint32_t>& StringPool::ranks()
+{
+    if (rankedCount == entries.size())
+        return rankOf;
+
+    // Sort just the strings added since, then merge them in
+    auto less = [this](Handle a, Handle b) { return std::strcmp(entries[a].str, entries[b].str) < 0; };
+    for (size_t h = rankedCount; h < entries.size(); ++h)
+        sorted.push_back(Handle(h));
+    std::sort(sorted.begin() + std::ptrdiff_t(rankedCount), sorted.end(), less);
+    std::inplace_merge(sorted.begin(), sorted.begin() + std::ptrdiff_t(rankedCount), sorted.end(), less);
+    rankedCount = entries.size();
+
+    rankOf.resize(entries.size());
+    for (size_t r = 0; r < sorted.size(); ++r)
+        rankOf[sorted[r]] = std::uint32_t(r);
+    return rankOf;
+}
+
+size_t StringPool::bytesUsed() const
+{
+    return blocks.size() * sizeof(blocks[0]) + arenaBytes +
+           entries.capacity() * sizeof(Entry) + table.capacity() * sizeof(Handle) +
+           sorted.capacity() * sizeof(Handle) + rankOf.capacity() * sizeof(std::uint32_t);
+}
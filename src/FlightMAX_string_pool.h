@@ -0,0 +1,80 @@
+#ifndef SRC_STRINGPOOL_H_
+#define SRC_STRINGPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Interned strings, each kept only once and referred to by a 32-bit handle
+//
+// Typecodes, models and owners repeat over and over in a fleet, so rows
+// store handles instead of copies. Equal strings get the same handle, so
+// comparing for equality is comparing handles, and rank() orders handles
+// alphabetically. Strings are never removed: handles and the pointers
+// str() and upper() return stay valid as long as the pool exists.
+// Not thread safe, use from the main thread only.
+class StringPool {
+public:
+    typedef std::uint32_t Handle;
+
+    // Handle of the empty string
+    static constexpr Handle EMPTY = 0;
+
+    // The one pool
+    static StringPool& get();
+
+    StringPool();
+
+    // Handle of `s`, adding it to the pool if needed
+    Handle intern(const char* s);
+    Handle intern(const char* s, size_t len);
+
+    // The string, zero-terminated
+    const char* str(Handle h) const         { return entries[h].str; }
+    // The string with ASCII letters upper case
+    const char* upper(Handle h) const       { return entries[h].upper; }
+    size_t length(Handle h) const           { return entries[h].len; }
+    std::uint32_t hash(Handle h) const      { return entries[h].hash; }
+
+    // Alphabetical position of each handle among all strings, indexed by handle
+    const std::vector<std::uint32_t>& ranks();
+    std::uint32_t rank(Handle h)            { return ranks()[h]; }
+
+    // Number of different strings
+    size_t size() const                     { return entries.size(); }
+
+    // Memory used by strings, entries and the lookup table
+    size_t bytesUsed() const;
+
+protected:
+    struct Entry {
+        const char*     str;
+        const char*     upper;                  // same as `str` if there are no lower case letters
+        std::uint32_t   len;
+        std::uint32_t   hash;
+    };
+
+    // Copy `len` characters plus a terminating zero into the arena
+    char* store(const char* s, size_t len);
+    // Double the lookup table
+    void growTable();
+
+    // Strings live in blocks that never move
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t              blockUsed = BLOCK_SIZE;     // of the last block
+    size_t              arenaBytes = 0;             // all blocks
+
+    std::vector<Entry>  entries;
+    // Open addressing by hash, NO_HANDLE marks free slots
+    static constexpr Handle NO_HANDLE = UINT32_MAX;
+    std::vector<Handle> table;
+
+    // Handles in alphabetical order, the first `rankedCount` handles are in there
+    std::vector<Handle> sorted;
+    std::vector<std::uint32_t> rankOf;
+    size_t              rankedCount = 0;
+};
+
+#endif /* SRC_STRINGPOOL_H_ */
@@ -0,0 +1,201 @@
+// Just the search, so that benchmarks can do without X-Plane
+#include "FlightMAX_table_search.h"
+#include "FlightMAX_text_search.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+//
+// MARK: TableSearchIndex
+//
+
+// Separates the texts of a row, never part of a filter text
+constexpr char TEXT_SEPARATOR = '\x1f';
+
+unsigned TableSearchIndex::bucketOf(const char* tri)
+{
+    const std::uint32_t v = std::uint32_t((unsigned char)tri[0]) |
+                            std::uint32_t((unsigned char)tri[1]) << 8 |
+                            std::uint32_t((unsigned char)tri[2]) << 16;
+    return (v * 2654435761u) >> 16;             // Fibonacci hashing, top 16 bits
+}
+
+void TableSearchIndex::beginBuild(size_t numRows)
+{
+    text.clear();
+    rowStart.clear();
+    rowStart.reserve(numRows + 1);
+    rowStart.push_back(0);
+    rowTexts.clear();
+    bResultValid = false;
+}
+
+void TableSearchIndex::addRow()
+{
+    for (const char* s: rowTexts) {
+        for (; *s; ++s)
+            text.push_back(*s >= 'a' && *s <= 'z' ? char(*s - 'a' + 'A') : *s);
+        text.push_back(TEXT_SEPARATOR);
+    }
+    rowTexts.clear();
+    rowStart.push_back(std::uint32_t(text.size()));
+}
+
+void TableSearchIndex::collectBuckets(size_t row)
+{
+    rowBuckets.clear();
+    for (size_t i = rowStart[row]; i + 3 <= rowStart[row+1]; ++i) {
+        // Trigrams across texts can't be part of a filter
+        if (text[i] == TEXT_SEPARATOR || text[i+1] == TEXT_SEPARATOR || text[i+2] == TEXT_SEPARATOR)
+            continue;
+        const unsigned b = bucketOf(&text[i]);
+        if (bucketRow[b] != row + 1) {
+            bucketRow[b] = std::uint32_t(row + 1);
+            rowBuckets.push_back(b);
+        }
+    }
+}
+
+void TableSearchIndex::endBuild()
+{
+    // The posting lists are made when the first filter long enough needs them,
+    // rows added or deleted with no such filter don't cost more than copying their texts
+    bPostingsValid = false;
+}
+
+void TableSearchIndex::indexTrigrams()
+{
+    if (bPostingsValid)
+        return;
+    bPostingsValid = true;
+
+    // Two passes over all rows: count the rows per bucket, then fill in the rows.
+    // Rows are visited in order, so each posting list ends up sorted.
+    postStart.assign(NUM_BUCKETS + 1, 0);
+    bucketRow.assign(NUM_BUCKETS, 0);
+    for (size_t row = 0; row < numRows(); ++row) {
+        collectBuckets(row);
+        for (unsigned b: rowBuckets)
+            postStart[b+1]++;
+    }
+    std::partial_sum(postStart.begin(), postStart.end(), postStart.begin());
+
+    postRows.resize(postStart.back());
+    std::vector<std::uint32_t> fill(postStart.begin(), postStart.end() - 1);
+    bucketRow.assign(NUM_BUCKETS, 0);
+    for (size_t row = 0; row < numRows(); ++row) {
+        collectBuckets(row);
+        for (unsigned b: rowBuckets)
+            postRows[fill[b]++] = std::uint32_t(row);
+    }
+}
+
+bool TableSearchIndex::rowContains(size_t row, const char* pat, size_t patLen) const
+{
+    // Both are upper case already, and rows are too short for the vector kernels to pay off
+    const char* p = text.data() + rowStart[row];
+    const char* end = text.data() + rowStart[row+1];
+    while (size_t(end - p) >= patLen) {
+        p = static_cast<const char*>(std::memchr(p, pat[0], size_t(end - p) - patLen + 1));
+        if (!p)
+            return false;
+        if (std::memcmp(p + 1, pat + 1, patLen - 1) == 0)
+            return true;
+        ++p;
+    }
+    return false;
+}
+
+const std::vector<size_t>& TableSearchIndex::find(const char* filter)
+{
+    rowsCompared = 0;
+    const size_t len = std::strlen(filter);
+    if (!len) {
+        result.resize(numRows());
+        std::iota(result.begin(), result.end(), size_t(0));
+        lastFilter.clear();
+        bResultValid = true;
+        return result;
+    }
+
+    // Comparing row by row costs more per row than scanning all text in one go,
+    // so that's only worth it for a small part of the rows
+    const size_t maxRowsToCompare = numRows() / 16;
+
+    // A longer filter containing the last one only matches rows found last time
+    bool bRefine = bResultValid && std::strstr(filter, lastFilter.c_str()) != nullptr &&
+                   result.size() <= maxRowsToCompare;
+    bool bCandidates = false;
+    if (len >= 3) {
+        indexTrigrams();
+        // The filter's trigrams, those with the fewest rows first
+        filterBuckets.clear();
+        for (size_t i = 0; i + 3 <= len; ++i) {
+            const unsigned b = bucketOf(filter + i);
+            if (std::find(filterBuckets.begin(), filterBuckets.end(), b) == filterBuckets.end())
+                filterBuckets.push_back(b);
+        }
+        auto listLen = [this](unsigned b) { return size_t(postStart[b+1] - postStart[b]); };
+        std::sort(filterBuckets.begin(), filterBuckets.end(),
+                  [&listLen](unsigned a, unsigned b) { return listLen(a) < listLen(b); });
+
+        // Too many rows even for the rarest trigram? Then scanning all text is faster.
+        // Also narrowing down the last result may be less work.
+        const unsigned best = filterBuckets.front();
+        if (listLen(best) <= maxRowsToCompare && (!bRefine || listLen(best) < result.size())) {
+            candidates.assign(postRows.begin() + postStart[best], postRows.begin() + postStart[best+1]);
+            // Candidates also need all other trigrams: merge with their sorted rows,
+            // as long as that's less work than comparing the candidates with the filter
+            for (size_t k = 1; k < filterBuckets.size() && !candidates.empty(); ++k) {
+                const unsigned b = filterBuckets[k];
+                if (listLen(b) > candidates.size() * MERGE_PER_COMPARE)
+                    break;
+                const std::uint32_t* next = postRows.data() + postStart[b];
+                const std::uint32_t* last = postRows.data() + postStart[b+1];
+                size_t kept = 0;
+                for (size_t row: candidates) {
+                    while (next != last && *next < row)
+                        ++next;
+                    if (next == last)
+                        break;
+                    if (*next == row)
+                        candidates[kept++] = row;
+                }
+                candidates.resize(kept);
+            }
+            bRefine = false;
+            bCandidates = true;
+        }
+    }
+
+    // Compare the remaining rows with the filter text
+    if (bRefine) {
+        rowsCompared = result.size();
+        result.erase(std::remove_if(result.begin(), result.end(),
+                                    [this, filter, len](size_t row) { return !rowContains(row, filter, len); }),
+                     result.end());
+    } else if (bCandidates) {
+        rowsCompared = candidates.size();
+        result.clear();
+        for (size_t row: candidates)
+            if (rowContains(row, filter, len))
+                result.push_back(row);
+    } else {
+        // All rows: scan the whole text in one go, continuing after the row of each match
+        rowsCompared = numRows();
+        result.clear();
+        size_t pos = 0, row = 0;
+        while (const char* match = TextSearch::findNoCase(text.data() + pos, text.size() - pos, filter, len)) {
+            const std::uint32_t at = std::uint32_t(match - text.data());
+            row = size_t(std::upper_bound(rowStart.begin() + std::ptrdiff_t(row) + 1, rowStart.end(), at) -
+                         rowStart.begin()) - 1;
+            result.push_back(row);
+            pos = rowStart[row+1];
+        }
+    }
+
+    lastFilter = filter;
+    bResultValid = true;
+    return result;
+}
@@ -0,0 +1,89 @@
+#ifndef SRC_TABLESEARCH_H_
+#define SRC_TABLESEARCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Substring search over the texts of many table rows, as typed into a search box
+//
+// build() copies the texts of all rows, upper cased, into one contiguous
+// buffer, the first search text of 3 or more characters indexes them by
+// their trigrams (3 characters in a row). find() then only needs to look
+// at rows containing the search text's rarest trigrams, and if the search
+// text just got longer, only at the rows found last time. If that's still
+// a large part of all rows, scanning all text in one go with TextSearch is
+// faster. Searching doesn't allocate once the buffers have grown.
+class TableSearchIndex {
+public:
+    // Make the index for `numRows` rows, `getTexts(row, texts)` appends the row's zero-terminated texts
+    template <class GetTexts>
+    void build(size_t numRows, GetTexts getTexts)
+    {
+        beginBuild(numRows);
+        for (size_t row = 0; row < numRows; ++row) {
+            getTexts(row, rowTexts);
+            addRow();
+        }
+        endBuild();
+    }
+
+    // Index the trigrams now instead of on the first search text of 3 or more characters
+    void indexTrigrams();
+
+    // Rows in which any text contains `filter` (already upper case), in ascending order
+    // (all rows if `filter` is empty)
+    const std::vector<size_t>& find(const char* filter);
+
+    // Rows in the index
+    size_t numRows() const { return rowStart.empty() ? 0 : rowStart.size() - 1; }
+
+    // Rows the last find() had to compare with the filter text
+    size_t lastRowsCompared() const { return rowsCompared; }
+
+protected:
+    void beginBuild(size_t numRows);
+    void addRow();
+    void endBuild();
+
+    // Index of the posting list a trigram is found in
+    static unsigned bucketOf(const char* tri);
+    // Collect the buckets of the trigrams of row `row` into rowBuckets, no duplicates
+    void collectBuckets(size_t row);
+    // Does row `row` contain `pat`?
+    bool rowContains(size_t row, const char* pat, size_t patLen) const;
+
+    // Trigrams are hashed into this many buckets, each with a posting list
+    static constexpr unsigned NUM_BUCKETS = 1u << 16;
+    // Merge a posting list only if it has at most this many entries per candidate
+    // (comparing a row costs a few times more than a merge step, but most merges don't narrow it down)
+    static constexpr size_t MERGE_PER_COMPARE = 4;
+
+    // Texts of the row being added
+    std::vector<const char*> rowTexts;
+    // Texts of all rows, upper case, separated by a character no filter contains
+    std::string         text;
+    // Where each row starts in `text`, plus one entry for the end
+    std::vector<std::uint32_t> rowStart;
+    // Posting lists: rows of bucket `b` are postRows[postStart[b]..postStart[b+1])
+    std::vector<std::uint32_t> postStart;
+    std::vector<std::uint32_t> postRows;
+    bool                bPostingsValid = false;
+    // Buckets of one row's trigrams while building
+    std::vector<unsigned> rowBuckets;
+    // Last row + 1 that collected each bucket, to skip duplicates
+    std::vector<std::uint32_t> bucketRow;
+
+    // The last search and its result, to narrow down from
+    std::string         lastFilter;
+    std::vector<size_t> result;
+    bool                bResultValid = false;
+    // Buckets of the filter's trigrams, no duplicates
+    std::vector<unsigned> filterBuckets;
+    // Candidates from the posting lists
+    std::vector<size_t> candidates;
+    size_t              rowsCompared = 0;
+};
+
+#endif /* SRC_TABLESEARCH_H_ */
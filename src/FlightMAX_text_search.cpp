@@ -0,0 +1,209 @@
+#include "FlightMAX_text_search.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXT_SEARCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// The AVX2 kernel is compiled for AVX2 on its own, the rest of the plugin stays baseline x86-64
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace TextSearch {
+
+typedef const char* (*FindFunc)(const char* text, size_t len, const char* pat, size_t patLen);
+
+static inline char foldCase(char c)
+{
+    return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+static inline bool isLetter(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+static inline bool equalNoCase(const char* a, const char* b, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        if (foldCase(a[i]) != foldCase(b[i]))
+            return false;
+    return true;
+}
+
+static const char* findScalar(const char* text, size_t len, const char* pat, size_t patLen)
+{
+    if (!patLen)
+        return text;
+    if (patLen > len)
+        return nullptr;
+    const char first = foldCase(pat[0]);
+    const char last  = foldCase(pat[patLen-1]);
+    for (size_t i = 0; i + patLen <= len; ++i) {
+        if (foldCase(text[i]) == first && foldCase(text[i+patLen-1]) == last &&
+            equalNoCase(text + i, pat, patLen))
+            return text + i;
+    }
+    return nullptr;
+}
+
+#if TEXT_SEARCH_X86
+
+static inline unsigned lowestBit(std::uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return unsigned(idx);
+#else
+    return unsigned(__builtin_ctz(mask));
+#endif
+}
+
+// Setting bit 5 turns upper case letters into lower case ones. Applied to other
+// characters that may match something it shouldn't, but that is just one more
+// candidate, which the full comparison then rejects.
+static const char* findSSE2(const char* text, size_t len, const char* pat, size_t patLen)
+{
+    if (!patLen)
+        return text;
+    if (patLen > len)
+        return nullptr;
+    const char first = pat[0], last = pat[patLen-1];
+    const __m128i firstFold = _mm_set1_epi8(isLetter(first) ? 0x20 : 0);
+    const __m128i lastFold  = _mm_set1_epi8(isLetter(last)  ? 0x20 : 0);
+    const __m128i firstChar = _mm_set1_epi8(char(first | (isLetter(first) ? 0x20 : 0)));
+    const __m128i lastChar  = _mm_set1_epi8(char(last  | (isLetter(last)  ? 0x20 : 0)));
+
+    size_t i = 0;
+    for (; i + patLen - 1 + 16 <= len; i += 16) {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const __m128i blockLast  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + patLen - 1));
+        const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(blockFirst, firstFold), firstChar),
+                                         _mm_cmpeq_epi8(_mm_or_si128(blockLast, lastFold), lastChar));
+        std::uint32_t mask = std::uint32_t(_mm_movemask_epi8(eq));
+        while (mask) {
+            const char* candidate = text + i + lowestBit(mask);
+            if (equalNoCase(candidate, pat, patLen))
+                return candidate;
+            mask &= mask - 1;
+        }
+    }
+    // less than a block left
+    return findScalar(text + i, len - i, pat, patLen);
+}
+
+TARGET_AVX2
+static const char* findAVX2(const char* text, size_t len, const char* pat, size_t patLen)
+{
+    if (!patLen)
+        return text;
+    if (patLen > len)
+        return nullptr;
+    const char first = pat[0], last = pat[patLen-1];
+    const __m256i firstFold = _mm256_set1_epi8(isLetter(first) ? 0x20 : 0);
+    const __m256i lastFold  = _mm256_set1_epi8(isLetter(last)  ? 0x20 : 0);
+    const __m256i firstChar = _mm256_set1_epi8(char(first | (isLetter(first) ? 0x20 : 0)));
+    const __m256i lastChar  = _mm256_set1_epi8(char(last  | (isLetter(last)  ? 0x20 : 0)));
+
+    size_t i = 0;
+    for (; i + patLen - 1 + 32 <= len; i += 32) {
+        const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        const __m256i blockLast  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + patLen - 1));
+        const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(blockFirst, firstFold), firstChar),
+                                            _mm256_cmpeq_epi8(_mm256_or_si256(blockLast, lastFold), lastChar));
+        std::uint32_t mask = std::uint32_t(_mm256_movemask_epi8(eq));
+        while (mask) {
+            const char* candidate = text + i + lowestBit(mask);
+            if (equalNoCase(candidate, pat, patLen))
+                return candidate;
+            mask &= mask - 1;
+        }
+    }
+    // less than a block left
+    return findSSE2(text + i, len - i, pat, patLen);
+}
+
+static bool cpuHasAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // The OS must save the AVX registers, too
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // TEXT_SEARCH_X86
+
+// Kernel in use, picked on first use
+static Kernel gKernel = Kernel(-1);
+static FindFunc gFind = nullptr;
+
+Kernel bestKernel()
+{
+#if TEXT_SEARCH_X86
+    static const bool bAVX2 = cpuHasAVX2();
+    return bAVX2 ? KERNEL_AVX2 : KERNEL_SSE2;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+bool setKernel(Kernel kernel)
+{
+    if (kernel < KERNEL_SCALAR || kernel > bestKernel())
+        return false;
+    switch (kernel) {
+#if TEXT_SEARCH_X86
+        case KERNEL_AVX2:   gFind = findAVX2;   break;
+        case KERNEL_SSE2:   gFind = findSSE2;   break;
+#endif
+        default:            gFind = findScalar; break;
+    }
+    gKernel = kernel;
+    return true;
+}
+
+Kernel getKernel()
+{
+    if (!gFind)
+        setKernel(bestKernel());
+    return gKernel;
+}
+
+const char* kernelName(Kernel kernel)
+{
+    switch (kernel) {
+        case KERNEL_SCALAR: return "scalar";
+        case KERNEL_SSE2:   return "SSE2";
+        case KERNEL_AVX2:   return "AVX2";
+    }
+    return "?";
+}
+
+const char* findNoCase(const char* text, size_t len, const char* pat, size_t patLen)
+{
+    if (!gFind)
+        setKernel(bestKernel());
+    return gFind(text, len, pat, patLen);
+}
+
+}
@@ -0,0 +1,38 @@
+#ifndef SRC_TEXTSEARCH_H_
+#define SRC_TEXTSEARCH_H_
+
+#include <cstddef>
+
+// Case-insensitive substring search (ASCII letters) in long texts
+//
+// The vector kernels compare the first and the last character of the search
+// text with 16 (SSE2) or 32 (AVX2) positions of the text at once, and only
+// compare the whole search text where both match. The best kernel the CPU
+// supports is picked on first use, others are there for comparison.
+namespace TextSearch {
+
+    enum Kernel {
+        KERNEL_SCALAR = 0,          // one position at a time, any CPU
+        KERNEL_SSE2,                // 16 positions at a time, any x86-64 CPU
+        KERNEL_AVX2,                // 32 positions at a time
+    };
+
+    // The fastest kernel this CPU supports
+    Kernel bestKernel();
+
+    // Kernel in use
+    Kernel getKernel();
+
+    // Use another kernel, e.g. for benchmarks
+    // @return `false` if the CPU doesn't support it
+    bool setKernel(Kernel kernel);
+
+    // "scalar", "SSE2", "AVX2"
+    const char* kernelName(Kernel kernel);
+
+    // First position of `pat` in `text`, ignoring the case of ASCII letters
+    // @return `nullptr` if not found
+    const char* findNoCase(const char* text, size_t len, const char* pat, size_t patLen);
+}
+
+#endif /* SRC_TEXTSEARCH_H_ */
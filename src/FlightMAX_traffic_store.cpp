@@ -0,0 +1,99 @@
+#include "FlightMAX_traffic_store.h"
+
+#include <algorithm>
+#include <cstring>
+
+//
+// MARK: TrafficStore
+//
+
+void TrafficStore::add(const char* reg, const char* model, const char* typecode, const char* owner,
+                       float heading, bool turnsLeft)
+{
+    StringPool& pool = StringPool::get();
+    texts.insert(texts.end(), { pool.intern(typecode), pool.intern(model), pool.intern(owner) });
+    regStart.push_back(std::uint32_t(regChars.size()));
+    regChars.append(reg);
+    regChars.push_back('\0');
+    headings.push_back(heading);
+    turnLeft.push_back(turnsLeft ? 1 : 0);
+    rowOrder.push_back(size() - 1);
+}
+
+void TrafficStore::erase(size_t row)
+{
+    unusedChars += std::strlen(reg(row)) + 1;
+    regStart.erase(regStart.begin() + std::ptrdiff_t(row));
+    texts.erase(texts.begin() + std::ptrdiff_t(row * NUM_POOLED),
+                texts.begin() + std::ptrdiff_t((row + 1) * NUM_POOLED));
+    headings.erase(headings.begin() + std::ptrdiff_t(row));
+    turnLeft.erase(turnLeft.begin() + std::ptrdiff_t(row));
+
+    // The sort order stays, just without the row
+    rowOrder.erase(std::remove(rowOrder.begin(), rowOrder.end(), row), rowOrder.end());
+    for (size_t& r: rowOrder)
+        if (r > row)
+            --r;
+
+    if (unusedChars > regChars.size() / 2)
+        compact();
+}
+
+void TrafficStore::compact()
+{
+    std::string packed;
+    packed.reserve(regChars.size() - unusedChars);
+    for (std::uint32_t& start: regStart) {
+        const char* r = regChars.data() + start;
+        start = std::uint32_t(packed.size());
+        packed.append(r);
+        packed.push_back('\0');
+    }
+    regChars.swap(packed);
+    unusedChars = 0;
+}
+
+void TrafficStore::turn(float degrees)
+{
+    // Straight through both arrays, without branches the compiler can vectorize it
+    const size_t n = size();
+    float* h = headings.data();
+    const std::uint8_t* left = turnLeft.data();
+    for (size_t i = 0; i < n; ++i) {
+        float v = h[i] + (left[i] ? -degrees : degrees);
+        v += v < 0.0f ? 360.0f : 0.0f;
+        v -= v >= 360.0f ? 360.0f : 0.0f;
+        h[i] = v;
+    }
+}
+
+void TrafficStore::sort(Column col, bool bAscending)
+{
+    // Compares rows by one column, ties keep the rows' order.
+    // Interned texts compare by their rank in the pool, which is the alphabetical order.
+    const std::vector<std::uint32_t>& ranks = StringPool::get().ranks();
+    auto less = [this, col, bAscending, &ranks](size_t a, size_t b)
+    {
+        int cmp = 0;
+        switch (col) {
+            case COL_REG:        cmp = std::strcmp(reg(a), reg(b));                 break;
+            case COL_HEADING:    cmp = (headings[a] > headings[b]) - (headings[a] < headings[b]); break;
+            case COL_TURNS_LEFT: cmp = int(turnLeft[a]) - int(turnLeft[b]);         break;
+            default: {
+                const std::uint32_t ra = ranks[text(a, col)], rb = ranks[text(b, col)];
+                cmp = (ra > rb) - (ra < rb);
+            }
+        }
+        if (!bAscending)
+            cmp = -cmp;
+        return cmp != 0 ? cmp < 0 : a < b;
+    };
+    std::sort(rowOrder.begin(), rowOrder.end(), less);
+}
+
+size_t TrafficStore::bytesUsed() const
+{
+    return headings.capacity() * sizeof(float) + turnLeft.capacity() +
+           texts.capacity() * sizeof(StringPool::Handle) + regStart.capacity() * sizeof(std::uint32_t) +
+           regChars.capacity() + rowOrder.capacity() * sizeof(size_t);
+}
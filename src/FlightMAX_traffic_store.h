@@ -0,0 +1,91 @@
+#ifndef SRC_TRAFFICSTORE_H_
+#define SRC_TRAFFICSTORE_H_
+
+#include "FlightMAX_string_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Traffic shown in the example table, stored column by column
+//
+// The numbers each have their own array, so animating all headings per
+// frame only touches the headings and turn directions. Typecodes, models
+// and owners repeat a lot, they are interned in StringPool::get() and rows
+// just keep their handles, so sorting by them compares the handles' ranks.
+// Registrations are unique, they share one character buffer of the store.
+// Rows keep their index when sorted: sort() only rearranges order().
+class TrafficStore {
+public:
+    // Columns as shown in the table, from left to right
+    enum Column {
+        COL_REG = 0,
+        COL_TYPECODE,
+        COL_MODEL,
+        COL_OWNER,
+        COL_HEADING,
+        COL_TURNS_LEFT,
+    };
+
+    // Number of rows
+    size_t size() const { return headings.size(); }
+
+    // Add a row at the end, also at the end of order()
+    void add(const char* reg, const char* model, const char* typecode, const char* owner,
+             float heading, bool turnsLeft);
+
+    // Remove a row, the rows after it move up by one
+    void erase(size_t row);
+
+    // Interned text of a row, `col` is COL_TYPECODE, COL_MODEL or COL_OWNER
+    StringPool::Handle text(size_t row, Column col) const
+    { return texts[row * NUM_POOLED + (col - COL_TYPECODE)]; }
+
+    // Texts of a row, the registration is valid until the next add() or erase()
+    const char* reg(size_t row) const       { return regChars.data() + regStart[row]; }
+    const char* model(size_t row) const     { return str(row, COL_MODEL); }
+    const char* typecode(size_t row) const  { return str(row, COL_TYPECODE); }
+    const char* owner(size_t row) const     { return str(row, COL_OWNER); }
+
+    float& heading(size_t row)              { return headings[row]; }
+    bool turnsLeft(size_t row) const        { return turnLeft[row] != 0; }
+    void setTurnsLeft(size_t row, bool bLeft) { turnLeft[row] = bLeft ? 1 : 0; }
+
+    // Turn all aircraft by `degrees`, each in its direction
+    void turn(float degrees);
+
+    // Sort order() by a column
+    void sort(Column col, bool bAscending);
+
+    // All rows in sort order
+    const std::vector<size_t>& order() const { return rowOrder; }
+
+    // Memory used by the rows, not counting the string pool
+    size_t bytesUsed() const;
+
+protected:
+    // Number of interned texts per row
+    enum { NUM_POOLED = COL_OWNER - COL_TYPECODE + 1 };
+
+    const char* str(size_t row, Column col) const { return StringPool::get().str(text(row, col)); }
+
+    // Drop the registrations of erased rows from `regChars`
+    void compact();
+
+    // Numeric columns
+    std::vector<float>          headings;
+    std::vector<std::uint8_t>   turnLeft;
+    // Interned texts, NUM_POOLED per row
+    std::vector<StringPool::Handle> texts;
+    // Where each row's registration starts in `regChars`
+    std::vector<std::uint32_t>  regStart;
+    // All registrations, zero-terminated
+    std::string                 regChars;
+    // Characters in `regChars` of erased rows
+    size_t                      unusedChars = 0;
+    // Rows in sort order
+    std::vector<size_t>         rowOrder;
+};
+
+#endif /* SRC_TRAFFICSTORE_H_ */
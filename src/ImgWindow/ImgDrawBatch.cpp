@@ -0,0 +1,169 @@
+/*
+ * ImgDrawBatch.cpp
+ *
+ * Integration for dear imgui into X-Plane: Draw Command Batching
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgDrawBatch.h"
+
+#include <cmath>
+#include <cstring>
+
+/** dst = m * v with m a column-major 4x4 matrix */
+static void multMatrixVec4f(float dst[4], const float m[16], const float v[4])
+{
+    dst[0] = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + v[3] * m[12];
+    dst[1] = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + v[3] * m[13];
+    dst[2] = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + v[3] * m[14];
+    dst[3] = v[0] * m[3] + v[1] * m[7] + v[2] * m[11] + v[3] * m[15];
+}
+
+/** Boxel position to native viewport position */
+static void boxelToViewport(const float modelView[16], const float projection[16], const int viewport[4],
+                            float x, float y, float& outX, float& outY)
+{
+    const float boxelPos[4] = { x, y, 0.0f, 1.0f };
+    float eye[4], ndc[4];
+    multMatrixVec4f(eye, modelView, boxelPos);
+    multMatrixVec4f(ndc, projection, eye);
+    ndc[3] = 1.0f / ndc[3];
+    outX = (ndc[0] * ndc[3] * 0.5f + 0.5f) * viewport[2] + viewport[0];
+    outY = (ndc[1] * ndc[3] * 0.5f + 0.5f) * viewport[3] + viewport[1];
+}
+
+ImgClipTransform
+ImgClipTransform::fromView(const float modelView[16], const float projection[16],
+                           const int viewport[4], int left, int top)
+{
+    // ImGui (x,y) is boxel (left+x, top-y). Transform the ImGui origin and
+    // one step along either axis, the differences are the scale factors.
+    float x0, y0, x1, y1, x2, y2;
+    boxelToViewport(modelView, projection, viewport, float(left),        float(top),        x0, y0);
+    boxelToViewport(modelView, projection, viewport, float(left) + 1.0f, float(top),        x1, y1);
+    boxelToViewport(modelView, projection, viewport, float(left),        float(top) - 1.0f, x2, y2);
+
+    ImgClipTransform xform;
+    xform.scaleX = x1 - x0;
+    xform.scaleY = y2 - y0;
+    xform.offsX  = x0;
+    xform.offsY  = y0;
+    return xform;
+}
+
+ImgClipTransform
+ImgClipTransform::forTexture(int texWidth, int texHeight,
+                             float displayWidth, float displayHeight)
+{
+    // texture pixels count from the bottom, ImGui from the top
+    ImgClipTransform xform;
+    xform.scaleX = displayWidth  > 0.0f ? float(texWidth)   / displayWidth  : 1.0f;
+    xform.scaleY = displayHeight > 0.0f ? -float(texHeight) / displayHeight : -1.0f;
+    xform.offsX  = 0.0f;
+    xform.offsY  = float(texHeight);
+    return xform;
+}
+
+bool
+ImgClipTransform::toScissor(const ImVec4& clipRect, int outScissor[4]) const
+{
+    const float xa = offsX + scaleX * clipRect.x;
+    const float xb = offsX + scaleX * clipRect.z;
+    const float ya = offsY + scaleY * clipRect.y;
+    const float yb = offsY + scaleY * clipRect.w;
+    const int x1 = int(std::floor(xa < xb ? xa : xb));
+    const int x2 = int(std::floor(xa < xb ? xb : xa));
+    const int y1 = int(std::floor(ya < yb ? ya : yb));
+    const int y2 = int(std::floor(ya < yb ? yb : ya));
+    outScissor[0] = x1;
+    outScissor[1] = y1;
+    outScissor[2] = x2 - x1;
+    outScissor[3] = y2 - y1;
+    return outScissor[2] > 0 && outScissor[3] > 0;
+}
+
+void
+ImgDrawBatcher::build(const ImDrawData* draw_data, const ImgClipTransform& xform)
+{
+    mBatches.clear();
+    mLists.clear();
+    mStats = Stats();
+    if (!draw_data)
+        return;
+
+    mLists.reserve(size_t(draw_data->CmdListsCount));
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        List list;
+        list.firstBatch = int(mBatches.size());
+
+        Batch* prev = nullptr;              // last batch of this list, if it can be extended
+        for (const ImDrawCmd& cmd: cmd_list->CmdBuffer)
+        {
+            mStats.commands++;
+            if (cmd.UserCallback) {
+                Batch cb;
+                cb.callback = &cmd;
+                mBatches.push_back(cb);
+                prev = nullptr;             // never merge across callbacks
+                continue;
+            }
+
+            Batch b;
+            if (!xform.toScissor(cmd.ClipRect, b.scissor)) {
+                mStats.culled++;
+                continue;
+            }
+            b.texture   = cmd.TextureId;
+            b.vtxOffset = cmd.VtxOffset;
+            b.idxOffset = cmd.IdxOffset;
+            b.elemCount = cmd.ElemCount;
+
+            // Same texture, same scissor box, same vertices, and indices continuing the previous batch?
+            if (prev &&
+                prev->texture == b.texture &&
+                prev->vtxOffset == b.vtxOffset &&
+                prev->idxOffset + prev->elemCount == b.idxOffset &&
+                std::memcmp(prev->scissor, b.scissor, sizeof(b.scissor)) == 0)
+            {
+                prev->elemCount += b.elemCount;
+                continue;
+            }
+
+            mBatches.push_back(b);
+            prev = &mBatches.back();
+        }
+
+        list.numBatches = int(mBatches.size()) - list.firstBatch;
+        mLists.push_back(list);
+    }
+    mStats.batches = mBatches.size();
+}
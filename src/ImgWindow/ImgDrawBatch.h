@@ -0,0 +1,121 @@
+/*
+ * ImgDrawBatch.h
+ *
+ * Integration for dear imgui into X-Plane: Draw Command Batching
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGDRAWBATCH_H
+#define IMGDRAWBATCH_H
+
+#include <imgui.h>
+#include <vector>
+
+/** Affine transformation from ImGui coordinates to native (viewport) pixels
+ *
+ * Windows are drawn with orthographic projections and axis-aligned, so
+ * the whole chain ImGui -> boxels -> eye -> NDC -> viewport collapses into
+ * one scale and one offset per axis.  It is computed once per frame instead
+ * of running every clip rect corner through the matrices.
+ */
+struct ImgClipTransform {
+    float scaleX    = 1.0f;
+    float scaleY    = 1.0f;
+    float offsX     = 0.0f;
+    float offsY     = 0.0f;
+
+    /** From X-Plane's view matrices and the window's top/left corner in boxels
+     * @param modelView Modelview matrix, column major as returned by X-Plane
+     * @param projection Projection matrix, column major as returned by X-Plane
+     * @param viewport Viewport: x, y, width, height */
+    static ImgClipTransform fromView(const float modelView[16], const float projection[16],
+                                     const int viewport[4], int left, int top);
+
+    /** Into a texture of texWidth x texHeight pixels showing the entire ImGui display */
+    static ImgClipTransform forTexture(int texWidth, int texHeight,
+                                       float displayWidth, float displayHeight);
+
+    /** Transforms an ImGui clip rect into a glScissor box (x, y, width, height)
+     * @return false if the box is empty */
+    bool toScissor(const ImVec4& clipRect, int outScissor[4]) const;
+};
+
+/** Pre-pass over a frame's draw data, which prepares the actual draw calls
+ *
+ * All clip rects are transformed in one go. Consecutive commands using the same
+ * texture, the same (transformed) clip rect, and the same vertex offset with
+ * adjacent index ranges are merged into one draw call.  Commands with empty clip rects are dropped.
+ * The object is meant to be kept and reused so that its vectors don't need
+ * reallocating each frame.
+ */
+class ImgDrawBatcher {
+public:
+    /** One draw call (or user callback) */
+    struct Batch {
+        ImTextureID         texture     = nullptr;  ///< texture to bind
+        int                 scissor[4]  = {0,0,0,0};///< glScissor box: x, y, width, height
+        unsigned int        vtxOffset   = 0;        ///< first vertex within the list's vertex buffer, indices are relative to it
+        unsigned int        idxOffset   = 0;        ///< first index within the list's index buffer
+        unsigned int        elemCount   = 0;        ///< number of indices to draw
+        const ImDrawCmd*    callback    = nullptr;  ///< if set: command with UserCallback, nothing to draw
+    };
+
+    /** The batches of one ImDrawList */
+    struct List {
+        int                 firstBatch  = 0;        ///< index into batches()
+        int                 numBatches  = 0;        ///< number of batches of this list
+    };
+
+    /** Counters of the last build() */
+    struct Stats {
+        unsigned long       commands    = 0;        ///< ImDrawCmds in the draw data
+        unsigned long       batches     = 0;        ///< batches, ie. draw calls plus callbacks
+        unsigned long       culled      = 0;        ///< commands dropped for empty clip rect
+    };
+
+    /** Prepare the batches for draw_data */
+    void build(const ImDrawData* draw_data, const ImgClipTransform& xform);
+
+    /** Batches of all lists */
+    const std::vector<Batch>& batches() const { return mBatches; }
+
+    /** One entry per ImDrawList in the draw data */
+    const std::vector<List>& lists() const { return mLists; }
+
+    /** Counters of the last build() */
+    const Stats& getStats() const { return mStats; }
+
+private:
+    std::vector<Batch>  mBatches;
+    std::vector<List>   mLists;
+    Stats               mStats;
+};
+
+#endif // IMGDRAWBATCH_H
@@ -33,8 +33,176 @@
 */
 
 #include "ImgFontAtlas.h"
+#include "ImgGlyphCache.h"
+#include "ImgTextureUploader.h"
 #include <XPLMGraphics.h>
 
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// A private copy of stb_truetype for the distance fields: imgui_draw.cpp compiles its own as static
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable: 4505)     // unreferenced local function has been removed
+#elif defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-function"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <imstb_truetype.h>
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#elif defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#if IBM
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/** Bump whenever the layout of the cache file changes */
+constexpr std::uint32_t CACHE_VERSION = 1;
+constexpr char          CACHE_MAGIC[8] = { 'I', 'M', 'G', 'F', 'A', 'T', 'L', '\0' };
+
+/** Cache file header, all numbers in native byte order (the key covers the platform) */
+struct CacheHeader {
+    char            magic[8];
+    std::uint32_t   version;
+    std::uint32_t   headerSize;
+    std::uint64_t   key;
+    std::int32_t    texWidth, texHeight;
+    ImVec2          texUvScale;
+    ImVec2          texUvWhitePixel;
+    ImVec4          texUvLines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+    std::int32_t    packIdMouseCursors;
+    std::int32_t    packIdLines;
+    std::uint32_t   numFonts;
+    std::uint32_t   numCustomRects;
+    std::uint64_t   pixelsOffset;           ///< Alpha8 pixels, texWidth * texHeight bytes
+};
+
+/** Per font, followed by its glyphs */
+struct CacheFont {
+    float           fontSize, ascent, descent;
+    std::uint32_t   fallbackChar, ellipsisChar;
+    std::int32_t    metricsTotalSurface;
+    std::uint32_t   numGlyphs;
+};
+
+/** Per custom rect */
+struct CacheCustomRect {
+    std::uint16_t   width, height, x, y;
+    std::uint32_t   glyphID;
+    float           glyphAdvanceX;
+    ImVec2          glyphOffset;
+    std::int32_t    fontIdx;                ///< index into Fonts, -1 if none
+};
+
+/** FNV-1a, 64 bit */
+struct Hasher {
+    std::uint64_t h = 14695981039346656037ull;
+    void add (const void *data, size_t size)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+            h = (h ^ p[i]) * 1099511628211ull;
+    }
+    template <class T> void add (const T &v) { add(&v, sizeof(v)); }
+};
+
+/** Read-only memory mapping of a whole file */
+class MappedFile {
+public:
+    explicit MappedFile (const std::string &path)
+    {
+#if IBM
+        mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mFile == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+            return;
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMapping)
+            return;
+        mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+        if (mData)
+            mSize = size_t(size.QuadPart);
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                mData = p;
+                mSize = size_t(st.st_size);
+            }
+        }
+        close(fd);                          // the mapping stays valid
+#endif
+    }
+
+    ~MappedFile ()
+    {
+#if IBM
+        if (mData)      UnmapViewOfFile(mData);
+        if (mMapping)   CloseHandle(mMapping);
+        if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+#else
+        if (mData)      munmap(mData, mSize);
+#endif
+    }
+
+    MappedFile (const MappedFile &) = delete;
+    MappedFile &operator = (const MappedFile &) = delete;
+
+    const unsigned char *data () const { return static_cast<const unsigned char *>(mData); }
+    size_t size () const { return mSize; }
+
+private:
+    void    *mData = nullptr;
+    size_t  mSize  = 0;
+#if IBM
+    HANDLE  mFile    = INVALID_HANDLE_VALUE;
+    HANDLE  mMapping = nullptr;
+#endif
+};
+
+int fontIndex (const ImFontAtlas *atlas, const ImFont *font)
+{
+    for (int i = 0; i < atlas->Fonts.Size; i++)
+        if (atlas->Fonts[i] == font)
+            return i;
+    return -1;
+}
+
+bool inRanges (const ImWchar *ranges, unsigned int c)
+{
+    for (; ranges[0] && ranges[1]; ranges += 2)
+        if (c >= ranges[0] && c <= ranges[1])
+            return true;
+    return false;
+}
+
+}
+
 ImgFontAtlas::ImgFontAtlas():
     mOurAtlas(nullptr),
     mTextureBound(false),
@@ -45,10 +213,14 @@ ImgFontAtlas::ImgFontAtlas():
 
 ImgFontAtlas::~ImgFontAtlas()
 {
+    mGlyphCache.reset();
     if (mTextureBound) {
+        // The upload's progress function refers to us
+        ImgTextureUploader::get().cancel(mGLTextureNum);
         GLuint glTexNum = mGLTextureNum;
         glDeleteTextures(1, &glTexNum);
         mTextureBound = false;
+        mTextureBytes = 0;
     }
     delete mOurAtlas;
     mOurAtlas = nullptr;
@@ -104,23 +276,426 @@ ImFontAtlas * ImgFontAtlas::getAtlas()
 }
 
 void
-ImgFontAtlas::bindTexture()
+ImgFontAtlas::buildTexData()
+{
+    if (mTexDataBuilt)
+        return;
+
+    if (mSdfSpread > 0) {
+        // Leave room for the field on all sides of each glyph, see bakeDistanceField()
+        mOurAtlas->TexGlyphPadding = 2 * mSdfSpread;
+        mOurAtlas->Flags |= ImFontAtlasFlags_NoBakedLines;
+        for (ImFontConfig &cfg: mOurAtlas->ConfigData)
+            cfg.OversampleH = cfg.OversampleV = 1;
+    }
+
+    const std::uint64_t key = mCacheFile.empty() ? 0 : cacheKey();
+    mLoadedFromCache = !mCacheFile.empty() && loadCache(key);
+    if (!mLoadedFromCache) {
+        unsigned char *pixData = nullptr;
+        int width, height;
+        mOurAtlas->GetTexDataAsAlpha8(&pixData, &width, &height);
+        if (mSdfSpread > 0)
+            bakeDistanceField();
+        if (!mCacheFile.empty())
+            saveCache(key);
+    }
+    mTexDataBuilt = true;
+}
+
+void
+ImgFontAtlas::bindTexture(bool bIncremental)
 {
     if (mTextureBound)
         return;
 
-    XPLMGenerateTextureNumbers(&mGLTextureNum, 1);
+    buildTexData();
+    // The texture gets the pixels. Should anyone ask for them
+    // (GetTexData...) the atlas would simply be built again.
+    std::shared_ptr<const void> pixels(mOurAtlas->TexPixelsAlpha8,
+                                       [](const void *p) { IM_FREE(const_cast<void *>(p)); });
+    mOurAtlas->TexPixelsAlpha8 = nullptr;
+    uploadAlpha8(std::move(pixels), mOurAtlas->TexWidth, mOurAtlas->TexHeight, bIncremental);
+}
 
-    unsigned char *pixData = nullptr;
-    int width, height;
-    mOurAtlas->GetTexDataAsRGBA32(&pixData, &width, &height);
+void
+ImgFontAtlas::uploadAlpha8(std::shared_ptr<const void> pixels, int width, int height, bool bIncremental)
+{
+    GLint internalFormat = GL_ALPHA8;
+    GLenum format = GL_ALPHA;
+    if (mCompactTexture) {
+        mTextureBytes = size_t(width) * size_t(height);
+    } else {
+        // Expand to white with alpha, as ImFontAtlas::GetTexDataAsRGBA32() does
+        auto rgba = std::make_shared<std::vector<std::uint32_t>>(size_t(width) * size_t(height));
+        const unsigned char *alpha = static_cast<const unsigned char *>(pixels.get());
+        for (size_t i = 0; i < rgba->size(); i++)
+            (*rgba)[i] = IM_COL32(255, 255, 255, alpha[i]);
+        pixels = std::shared_ptr<const void>(rgba, rgba->data());
+        internalFormat = GL_RGBA;
+        format = GL_RGBA;
+        mTextureBytes = rgba->size() * 4;
+    }
 
-    XPLMBindTexture2d(mGLTextureNum, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixData);
+    XPLMGenerateTextureNumbers(&mGLTextureNum, 1);
+    if (bIncremental) {
+        mTextureReady = false;
+        ImgTextureUploader::get().upload(mGLTextureNum, internalFormat, width, height, format, std::move(pixels),
+                                         [this](float progress) { mTextureReady = progress >= 1.0f; });
+    } else {
+        XPLMBindTexture2d(mGLTextureNum, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels.get());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        mTextureReady = true;
+    }
 
     mOurAtlas->SetTexID((void *)((intptr_t)mGLTextureNum));
     mTextureBound = true;
+
+    // Only now are the pages for on-demand glyphs placed
+    if (mGlyphCache)
+        mGlyphCache->attachTexture(mGLTextureNum, mCompactTexture, mSdfSpread);
+}
+
+void
+ImgFontAtlas::bakeDistanceField()
+{
+    const int texWidth = mOurAtlas->TexWidth;
+    const int texHeight = mOurAtlas->TexHeight;
+    unsigned char *pixels = mOurAtlas->TexPixelsAlpha8;
+    if (!pixels)
+        return;
+
+    for (ImFont *font: mOurAtlas->Fonts) {
+        // With merged fonts each glyph comes from the first source
+        // that has it in its ranges, just like ImGui picks it
+        std::vector<bool> done(size_t(font->Glyphs.Size), false);
+        for (const ImFontConfig &cfg: mOurAtlas->ConfigData) {
+            if (cfg.DstFont != font || !cfg.FontData)
+                continue;
+            const unsigned char *data = static_cast<const unsigned char *>(cfg.FontData);
+            const int offset = stbtt_GetFontOffsetForIndex(data, cfg.FontNo);
+            stbtt_fontinfo info;
+            if (offset < 0 || !stbtt_InitFont(&info, data, offset))
+                continue;
+            const float scale = cfg.SizePixels > 0.0f ? stbtt_ScaleForPixelHeight(&info, cfg.SizePixels) :
+                                                        stbtt_ScaleForMappingEmToPixels(&info, -cfg.SizePixels);
+            const ImWchar *ranges = cfg.GlyphRanges ? cfg.GlyphRanges : mOurAtlas->GetGlyphRangesDefault();
+
+            for (int i = 0; i < font->Glyphs.Size; i++) {
+                ImFontGlyph &g = font->Glyphs[i];
+                if (done[size_t(i)] || !g.Visible || !inRanges(ranges, g.Codepoint))
+                    continue;
+                const int glyph = stbtt_FindGlyphIndex(&info, int(g.Codepoint));
+                if (!glyph)
+                    continue;
+                done[size_t(i)] = true;
+
+                // ImGui put the coverage at the top/left of a rect
+                // 2 * spread larger than the glyph (TexGlyphPadding)
+                int x0, y0, x1, y1;
+                stbtt_GetGlyphBitmapBox(&info, glyph, scale, scale, &x0, &y0, &x1, &y1);
+                const int x = int(g.U0 * float(texWidth) + 0.5f);
+                const int y = int(g.V0 * float(texHeight) + 0.5f);
+                if (int(g.U1 * float(texWidth) + 0.5f) - x != x1 - x0 ||
+                    int(g.V1 * float(texHeight) + 0.5f) - y != y1 - y0)
+                    continue;                   // not baked the way we expect
+
+                int w = 0, h = 0, xoff = 0, yoff = 0;
+                unsigned char *sdf = stbtt_GetGlyphSDF(&info, scale, glyph, mSdfSpread, 128,
+                                                       128.0f / float(mSdfSpread), &w, &h, &xoff, &yoff);
+                if (!sdf)
+                    continue;
+                if (x + w <= texWidth && y + h <= texHeight) {
+                    for (int row = 0; row < h; row++)
+                        std::memcpy(pixels + size_t(y + row) * size_t(texWidth) + size_t(x),
+                                    sdf + size_t(row) * size_t(w), size_t(w));
+                    // The quad grows by the spread on all sides, the outline stays put
+                    g.X0 -= float(mSdfSpread);
+                    g.Y0 -= float(mSdfSpread);
+                    g.X1 += float(mSdfSpread);
+                    g.Y1 += float(mSdfSpread);
+                    g.U1 = float(x + w) / float(texWidth);
+                    g.V1 = float(y + h) / float(texHeight);
+                }
+                stbtt_FreeSDF(sdf, nullptr);
+            }
+        }
+    }
+}
+
+void
+ImgFontAtlas::setCompactTexture(bool bCompact)
+{
+    mCompactTexture = bCompact;
+}
+
+void
+ImgFontAtlas::setDistanceField(int spread)
+{
+    if (!mTexDataBuilt)
+        mSdfSpread = spread > 0 ? spread : 0;
+}
+
+void
+ImgFontAtlas::setFontScale(float scale)
+{
+    mFontScale = scale;
+    for (ImFont *font: mOurAtlas->Fonts)
+        font->Scale = scale;
+}
+
+size_t
+ImgFontAtlas::getTextureBytes() const
+{
+    return mTextureBound ? mTextureBytes : 0;
+}
+
+void
+ImgFontAtlas::setCacheFile(const std::string &path)
+{
+    mCacheFile = path;
+}
+
+bool
+ImgFontAtlas::wasLoadedFromCache() const
+{
+    return mLoadedFromCache;
+}
+
+void
+ImgFontAtlas::enableGlyphCache(int pageSize, int numPages, ImFont *font)
+{
+    if (!mGlyphCache && !mTextureBound)
+        mGlyphCache.reset(new ImgGlyphCache(mOurAtlas, font, pageSize, numPages));
+}
+
+bool
+ImgFontAtlas::addGlyphSource(const std::string &ttfFile, int fontNo)
+{
+    return mGlyphCache && mGlyphCache->addSource(ttfFile, fontNo);
+}
+
+ImgGlyphCache *
+ImgFontAtlas::getGlyphCache()
+{
+    return mGlyphCache.get();
+}
+
+std::uint64_t
+ImgFontAtlas::cacheKey() const
+{
+    Hasher h;
+    h.add(CACHE_VERSION);
+    h.add(std::int32_t(IMGUI_VERSION_NUM));
+    h.add(std::uint32_t(sizeof(ImFontGlyph)));
+    h.add(std::uint32_t(sizeof(ImWchar)));
+    h.add(std::uint32_t(sizeof(void *)));
+    h.add(mOurAtlas->Flags);
+    h.add(mOurAtlas->TexDesiredWidth);
+    h.add(mOurAtlas->TexGlyphPadding);
+    h.add(mSdfSpread);
+
+    for (const ImFontConfig &cfg: mOurAtlas->ConfigData) {
+        h.add(cfg.FontData, size_t(cfg.FontDataSize));
+        h.add(cfg.FontNo);
+        h.add(cfg.SizePixels);
+        h.add(cfg.OversampleH);
+        h.add(cfg.OversampleV);
+        h.add(cfg.PixelSnapH);
+        h.add(cfg.GlyphExtraSpacing);
+        h.add(cfg.GlyphOffset);
+        for (const ImWchar *r = cfg.GlyphRanges; r && *r; r++)
+            h.add(*r);
+        h.add(ImWchar(0));
+        h.add(cfg.GlyphMinAdvanceX);
+        h.add(cfg.GlyphMaxAdvanceX);
+        h.add(cfg.MergeMode);
+        h.add(cfg.RasterizerFlags);
+        h.add(cfg.RasterizerMultiply);
+        h.add(cfg.EllipsisChar);
+        h.add(fontIndex(mOurAtlas, cfg.DstFont));
+    }
+
+    for (const ImFontAtlasCustomRect &r: mOurAtlas->CustomRects) {
+        h.add(r.Width);
+        h.add(r.Height);
+        h.add(r.GlyphID);
+        h.add(r.GlyphAdvanceX);
+        h.add(r.GlyphOffset);
+        h.add(fontIndex(mOurAtlas, r.Font));
+    }
+    return h.h;
+}
+
+bool
+ImgFontAtlas::loadCache(std::uint64_t key)
+{
+    MappedFile file(mCacheFile);
+    if (file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader hdr;
+    std::memcpy(&hdr, file.data(), sizeof(hdr));
+    if (std::memcmp(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        hdr.version != CACHE_VERSION || hdr.headerSize != sizeof(CacheHeader) ||
+        hdr.key != key ||
+        hdr.numFonts != std::uint32_t(mOurAtlas->Fonts.Size) ||
+        hdr.texWidth <= 0 || hdr.texHeight <= 0 ||
+        hdr.pixelsOffset > file.size() ||
+        file.size() - hdr.pixelsOffset < std::uint64_t(hdr.texWidth) * std::uint64_t(hdr.texHeight))
+        return false;
+
+    // Validate the whole table section before touching the atlas
+    size_t pos = sizeof(CacheHeader);
+    for (std::uint32_t f = 0; f < hdr.numFonts; f++) {
+        if (pos + sizeof(CacheFont) > hdr.pixelsOffset)
+            return false;
+        CacheFont cf;
+        std::memcpy(&cf, file.data() + pos, sizeof(cf));
+        pos += sizeof(CacheFont) + size_t(cf.numGlyphs) * sizeof(ImFontGlyph);
+    }
+    if (pos + size_t(hdr.numCustomRects) * sizeof(CacheCustomRect) > hdr.pixelsOffset)
+        return false;
+
+    // Atlas-level data
+    ImFontAtlas &atlas = *mOurAtlas;
+    atlas.TexWidth          = hdr.texWidth;
+    atlas.TexHeight         = hdr.texHeight;
+    atlas.TexUvScale        = hdr.texUvScale;
+    atlas.TexUvWhitePixel   = hdr.texUvWhitePixel;
+    std::memcpy(atlas.TexUvLines, hdr.texUvLines, sizeof(atlas.TexUvLines));
+    atlas.PackIdMouseCursors = hdr.packIdMouseCursors;
+    atlas.PackIdLines       = hdr.packIdLines;
+
+    // Fonts, as ImFontAtlasBuildSetupFont() and ImFontAtlasBuildFinish() would have left them
+    pos = sizeof(CacheHeader);
+    for (int f = 0; f < atlas.Fonts.Size; f++) {
+        ImFont *font = atlas.Fonts[f];
+        CacheFont cf;
+        std::memcpy(&cf, file.data() + pos, sizeof(cf));
+        pos += sizeof(cf);
+
+        font->ClearOutputData();
+        font->ContainerAtlas    = &atlas;
+        font->ConfigData        = nullptr;
+        font->ConfigDataCount   = 0;
+        for (const ImFontConfig &cfg: atlas.ConfigData)
+            if (cfg.DstFont == font) {
+                if (!font->ConfigData)
+                    font->ConfigData = &cfg;
+                font->ConfigDataCount++;
+            }
+        font->FontSize          = cf.fontSize;
+        font->Ascent            = cf.ascent;
+        font->Descent           = cf.descent;
+        font->FallbackChar      = ImWchar(cf.fallbackChar);
+        font->EllipsisChar      = ImWchar(cf.ellipsisChar);
+        font->MetricsTotalSurface = cf.metricsTotalSurface;
+        font->Glyphs.resize(int(cf.numGlyphs));
+        if (cf.numGlyphs)
+            std::memcpy(font->Glyphs.Data, file.data() + pos, size_t(cf.numGlyphs) * sizeof(ImFontGlyph));
+        pos += size_t(cf.numGlyphs) * sizeof(ImFontGlyph);
+        font->BuildLookupTable();
+    }
+
+    // Custom rects (incl. the default ones for mouse cursors and lines)
+    atlas.CustomRects.resize(int(hdr.numCustomRects));
+    for (int i = 0; i < atlas.CustomRects.Size; i++) {
+        CacheCustomRect cr;
+        std::memcpy(&cr, file.data() + pos, sizeof(cr));
+        pos += sizeof(cr);
+        ImFontAtlasCustomRect &r = atlas.CustomRects[i];
+        r.Width         = cr.width;
+        r.Height        = cr.height;
+        r.X             = cr.x;
+        r.Y             = cr.y;
+        r.GlyphID       = cr.glyphID;
+        r.GlyphAdvanceX = cr.glyphAdvanceX;
+        r.GlyphOffset   = cr.glyphOffset;
+        r.Font          = cr.fontIdx >= 0 && cr.fontIdx < atlas.Fonts.Size ? atlas.Fonts[cr.fontIdx] : nullptr;
+    }
+
+    // Pixels are copied out of the mapping, bindTexture() may well be called
+    // after the file is closed again (and on another thread)
+    const size_t numPixels = size_t(hdr.texWidth) * size_t(hdr.texHeight);
+    atlas.TexPixelsAlpha8 = static_cast<unsigned char *>(IM_ALLOC(numPixels));
+    std::memcpy(atlas.TexPixelsAlpha8, file.data() + hdr.pixelsOffset, numPixels);
+    return true;
+}
+
+void
+ImgFontAtlas::saveCache(std::uint64_t key) const
+{
+    const ImFontAtlas &atlas = *mOurAtlas;
+    if (!atlas.TexPixelsAlpha8)
+        return;
+
+    CacheHeader hdr {};
+    std::memcpy(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    hdr.version             = CACHE_VERSION;
+    hdr.headerSize          = sizeof(CacheHeader);
+    hdr.key                 = key;
+    hdr.texWidth            = atlas.TexWidth;
+    hdr.texHeight           = atlas.TexHeight;
+    hdr.texUvScale          = atlas.TexUvScale;
+    hdr.texUvWhitePixel     = atlas.TexUvWhitePixel;
+    std::memcpy(hdr.texUvLines, atlas.TexUvLines, sizeof(hdr.texUvLines));
+    hdr.packIdMouseCursors  = atlas.PackIdMouseCursors;
+    hdr.packIdLines         = atlas.PackIdLines;
+    hdr.numFonts            = std::uint32_t(atlas.Fonts.Size);
+    hdr.numCustomRects      = std::uint32_t(atlas.CustomRects.Size);
+
+    std::vector<unsigned char> tables;
+    for (const ImFont *font: atlas.Fonts) {
+        CacheFont cf {};
+        cf.fontSize             = font->FontSize;
+        cf.ascent               = font->Ascent;
+        cf.descent              = font->Descent;
+        cf.fallbackChar         = font->FallbackChar;
+        cf.ellipsisChar         = font->EllipsisChar;
+        cf.metricsTotalSurface  = font->MetricsTotalSurface;
+        cf.numGlyphs            = std::uint32_t(font->Glyphs.Size);
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(&cf);
+        tables.insert(tables.end(), p, p + sizeof(cf));
+        p = reinterpret_cast<const unsigned char *>(font->Glyphs.Data);
+        tables.insert(tables.end(), p, p + size_t(font->Glyphs.size_in_bytes()));
+    }
+    for (const ImFontAtlasCustomRect &r: atlas.CustomRects) {
+        CacheCustomRect cr {};
+        cr.width            = r.Width;
+        cr.height           = r.Height;
+        cr.x                = r.X;
+        cr.y                = r.Y;
+        cr.glyphID          = r.GlyphID;
+        cr.glyphAdvanceX    = r.GlyphAdvanceX;
+        cr.glyphOffset      = r.GlyphOffset;
+        cr.fontIdx          = fontIndex(&atlas, r.Font);
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(&cr);
+        tables.insert(tables.end(), p, p + sizeof(cr));
+    }
+    // Pixels start 16-byte aligned
+    tables.resize((sizeof(CacheHeader) + tables.size() + 15) / 16 * 16 - sizeof(CacheHeader), 0);
+    hdr.pixelsOffset = sizeof(CacheHeader) + tables.size();
+
+    // Write to a temporary file first so that a concurrent reader never sees half a file
+    const std::string tmpFile = mCacheFile + ".tmp";
+    std::FILE *f = std::fopen(tmpFile.c_str(), "wb");
+    if (!f)
+        return;
+    const size_t numPixels = size_t(atlas.TexWidth) * size_t(atlas.TexHeight);
+    const bool bOK =
+        std::fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+        std::fwrite(tables.data(), 1, tables.size(), f) == tables.size() &&
+        std::fwrite(atlas.TexPixelsAlpha8, 1, numPixels, f) == numPixels;
+    if (std::fclose(f) != 0 || !bOK) {
+        std::remove(tmpFile.c_str());
+        return;
+    }
+    std::remove(mCacheFile.c_str());            // Windows' rename doesn't replace
+    std::rename(tmpFile.c_str(), mCacheFile.c_str());
 }
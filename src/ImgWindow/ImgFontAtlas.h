@@ -37,6 +37,11 @@
 
 #include "SystemGL.h"
 #include <imgui.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class ImgGlyphCache;
 
 /** Construct an empty font atlas we can use later
  *
@@ -75,17 +80,119 @@ public:
                                                  const ImFontConfig *font_cfg = NULL,
                                                  const unsigned short *glyph_ranges = NULL);              // 'compressed_font_data_base85' still owned by caller. Compress with binary_to_compressed_c.cpp with -base85 parameter.
 
+    /** buildTexData rasterizes the fonts, or reads them from the cache file.
+     *
+     * No OpenGL involved, so it may run on a worker thread as long as no
+     * other thread uses this atlas. bindTexture() calls it if not done yet.
+     */
+    virtual void buildTexData();
+
     /** bindTexture creates and binds the font texture to OpenGL, ready for use.
      *
      * This should be called after all fonts are loaded, before any rendering occurs!
+     * @param bIncremental Upload the pixels over the next frames with
+     *        ImgTextureUploader instead of right away. Don't draw with the
+     *        atlas before isTextureReady().
      */
-    virtual void bindTexture();
+    void bindTexture(bool bIncremental = false);
+
+    /** Are all pixels in the texture? */
+    bool isTextureReady() const { return mTextureBound && mTextureReady; }
 
     ImFontAtlas *getAtlas();
+
+    /** Keep the baked atlas in a cache file
+     *
+     * bindTexture() then first tries to read glyphs, metrics and pixels from
+     * that file instead of rasterizing the fonts. The file is only used if it
+     * was written for exactly the same font data, sizes, ranges and ImFontConfig
+     * settings (see cacheKey()), otherwise the atlas is built as usual and the
+     * file rewritten. Set before calling bindTexture(), empty to disable.
+     */
+    void setCacheFile(const std::string &path);
+
+    /** Did bindTexture() take the atlas from the cache file? */
+    bool wasLoadedFromCache() const;
+
+    /** Upload the atlas as single-channel GL_ALPHA8 texture instead of RGBA
+     *
+     * The atlas only holds coverage, so this needs a quarter of the VRAM.
+     * With the GL_MODULATE texture environment (which ImgRenderState sets)
+     * an alpha texture yields vertex color times coverage, exactly like the
+     * white RGBA texture. Set before calling bindTexture().
+     */
+    void setCompactTexture(bool bCompact);
+
+    /** Bake signed distance fields instead of coverage
+     *
+     * Each texel then holds the distance to the glyph outline, up to `spread`
+     * pixels either side. ImgRenderState finds the outline anew at whatever
+     * size the text is drawn, so one baked size stays crisp from small table
+     * text to large readouts (see setFontScale()), where coverage would have
+     * to be baked once per size. Fonts are baked without oversampling and
+     * baked lines. Needs shader support (OGL_HasShaders()).
+     * Set before building, 0 (the default) for a coverage atlas.
+     * @note Not supported by ImgFreeTypeFontAtlas.
+     */
+    void setDistanceField(int spread);
+
+    /** Distance field spread in pixels, 0 for a coverage atlas */
+    int getDistanceField() const { return mSdfSpread; }
+
+    /** Draw all fonts at `scale` times the size they were baked at
+     *
+     * Sets ImFont::Scale, so with a distance field atlas the font size can
+     * change without building a new atlas. Call after adding the fonts.
+     * Windows rebuild their interface when this changes. */
+    void setFontScale(float scale);
+
+    /** Current scale of all fonts, 1 unless changed by setFontScale() */
+    float getFontScale() const { return mFontScale; }
+
+    /** Texture memory used by the atlas in bytes (0 before bindTexture()) */
+    size_t getTextureBytes() const;
+
+    /** Rasterize glyphs missing in `font` when they are first needed
+     *
+     * Reserves `numPages` pages of `pageSize` x `pageSize` pixels in the atlas,
+     * which ImgGlyphCache fills with glyphs as text is requested, so large
+     * character sets needn't be baked up front. Call after adding the fonts,
+     * before bindTexture().
+     * @param font Font to extend, `nullptr` for the default font
+     */
+    void enableGlyphCache(int pageSize = 256, int numPages = 4, ImFont *font = nullptr);
+
+    /** Add a fallback font file for glyphs the font itself doesn't have
+     * @return `false` if the glyph cache isn't enabled or the file can't be used */
+    bool addGlyphSource(const std::string &ttfFile, int fontNo = 0);
+
+    /** The glyph cache, `nullptr` unless enabled */
+    ImgGlyphCache *getGlyphCache();
 protected:
+    /** Hash over everything the baked atlas depends on */
+    std::uint64_t cacheKey() const;
+    /** Fill fonts, custom rects and pixels from the cache file
+     * @return `false` if there is no valid cache file for our key */
+    bool loadCache(std::uint64_t key);
+    /** Write the built atlas to the cache file */
+    void saveCache(std::uint64_t key) const;
+    /** Replace the coverage of all glyphs ImGui has just baked with distance fields */
+    void bakeDistanceField();
+    /** Create the texture from 8 bit alpha data, now or over the next frames */
+    void uploadAlpha8(std::shared_ptr<const void> pixels, int width, int height, bool bIncremental);
+
     ImFontAtlas *mOurAtlas;
     bool        mTextureBound;
+    bool        mTextureReady = false;
+    bool        mTexDataBuilt = false;
     int         mGLTextureNum;
+    std::string mCacheFile;
+    bool        mLoadedFromCache = false;
+    bool        mCompactTexture = false;
+    size_t      mTextureBytes = 0;
+    int         mSdfSpread = 0;
+    float       mFontScale = 1.0f;
+    std::unique_ptr<ImgGlyphCache> mGlyphCache;
 };
 
 #endif //IMGFONTATLAS_H
@@ -0,0 +1,131 @@
+/*
+ * ImgFontAtlasBuilder.cpp
+ *
+ * Integration for dear imgui into X-Plane: Background Font Atlas Builds
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgFontAtlasBuilder.h"
+#include "ImgProfiler.h"
+
+#include <exception>
+
+ImgFontAtlasBuilder::~ImgFontAtlasBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mPending = nullptr;
+        bStop = true;
+    }
+    mWakeCond.notify_one();
+    if (mThread.joinable())
+        mThread.join();
+}
+
+void
+ImgFontAtlasBuilder::Start(Factory factory)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mPending = std::move(factory);
+        // An older result is outdated now
+        mResult.reset();
+        mError.clear();
+    }
+    if (!mThread.joinable())
+        mThread = std::thread(&ImgFontAtlasBuilder::buildLoop, this);
+    mWakeCond.notify_one();
+}
+
+std::shared_ptr<ImgFontAtlas>
+ImgFontAtlasBuilder::TakeResult(std::string &error)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    error.swap(mError);
+    mError.clear();
+    return std::move(mResult);
+}
+
+bool
+ImgFontAtlasBuilder::IsBusy() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mPending || bRunning || mResult || !mError.empty();
+}
+
+std::unique_lock<std::mutex>
+ImgFontAtlasBuilder::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    mIdleCond.wait(lock, [this] { return !bRunning; });
+    return lock;
+}
+
+void
+ImgFontAtlasBuilder::buildLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    for (;;) {
+        mWakeCond.wait(lock, [this] { return bStop || bool(mPending); });
+        if (bStop)
+            break;
+        Factory factory = std::move(mPending);
+        mPending = nullptr;
+        bRunning = true;
+        lock.unlock();
+
+        std::shared_ptr<ImgFontAtlas> atlas;
+        std::string error;
+        try {
+            IMG_PROFILE_ZONE("ImgFontAtlasBuilder::build");
+            atlas = factory();
+            if (atlas)
+                atlas->buildTexData();
+        } catch (const std::exception &e) {
+            // ImGui's assertions throw, e.g. for a missing font file
+            atlas.reset();
+            error = e.what();
+        }
+
+        lock.lock();
+        bRunning = false;
+        // Only hand it out if no newer request came in meanwhile
+        if (!mPending && !bStop) {
+            mResult = std::move(atlas);
+            mError = std::move(error);
+        } else {
+            // Unused atlases are destroyed here, they own no GL objects yet
+            lock.unlock();
+            atlas.reset();
+            lock.lock();
+        }
+        mIdleCond.notify_all();
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * ImgFontAtlasBuilder.h
+ *
+ * Integration for dear imgui into X-Plane: Background Font Atlas Builds
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGFONTATLASBUILDER_H
+#define IMGFONTATLASBUILDER_H
+
+#include "ImgFontAtlas.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/** ImgFontAtlasBuilder creates and rasterizes font atlases on a worker thread
+ *
+ * The factory passed to Start() sets up a new atlas just like it is done at
+ * startup. It runs on the worker thread together with
+ * ImgFontAtlas::buildTexData(), so neither may call XPLM or OpenGL. The main
+ * thread picks up the finished atlas with TakeResult() and creates its
+ * texture with ImgFontAtlas::bindTexture().
+ *
+ * ImGui's allocations on the worker count in the main thread's current
+ * context (only the metrics' allocation counter, which may then be off a
+ * bit), so a context must not be destroyed while a build runs, see WaitIdle().
+ *
+ * Starting again while a build is running replaces the pending request, so
+ * quick successive changes (like dragging a font size slider) lead to at
+ * most one more build.
+ */
+class ImgFontAtlasBuilder {
+public:
+    typedef std::function<std::shared_ptr<ImgFontAtlas>()> Factory;
+
+    ImgFontAtlasBuilder() = default;
+    /** Stops the worker thread, waiting for a build in progress */
+    ~ImgFontAtlasBuilder();
+
+    ImgFontAtlasBuilder(const ImgFontAtlasBuilder &) = delete;
+    ImgFontAtlasBuilder &operator=(const ImgFontAtlasBuilder &) = delete;
+
+    /** Request a new atlas made by `factory` */
+    void Start(Factory factory);
+
+    /** The finished atlas, if there is one, which is then handed over
+     * @param[out] error What went wrong, if the last build failed
+     * @return `nullptr` if no new atlas is ready */
+    std::shared_ptr<ImgFontAtlas> TakeResult(std::string &error);
+
+    /** Is a build requested, running, or waiting to be taken? */
+    bool IsBusy() const;
+
+    /** Wait for a build in progress to finish
+     * @return Lock that keeps the next build from starting while held */
+    std::unique_lock<std::mutex> WaitIdle();
+
+private:
+    void buildLoop();
+
+    std::thread                     mThread;
+    mutable std::mutex              mLock;
+    std::condition_variable         mWakeCond;
+    std::condition_variable         mIdleCond;     ///< a build finished
+    Factory                         mPending;       ///< next build to do
+    bool                            bRunning = false;
+    bool                            bStop = false;
+    std::shared_ptr<ImgFontAtlas>   mResult;        ///< finished, not yet taken
+    std::string                     mError;         ///< of the last build, not yet taken
+};
+
+#endif //IMGFONTATLASBUILDER_H
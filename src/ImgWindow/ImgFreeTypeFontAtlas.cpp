@@ -38,26 +38,18 @@
 #include <XPLMGraphics.h>
 
 void
-ImgFreeTypeFontAtlas::bindTexture()
+ImgFreeTypeFontAtlas::buildTexData()
 {
-    if (mTextureBound)
+    if (mTexDataBuilt)
         return;
 
-    XPLMGenerateTextureNumbers(&mGLTextureNum, 1);
-
+    // FreeType places glyphs differently than stb_truetype would, so no distance fields
+    mSdfSpread = 0;
     unsigned char *pixData = nullptr;
     int width, height;
     ImGuiFreeType::BuildFontAtlas(mOurAtlas, mGlobalFlags);
-    mOurAtlas->GetTexDataAsRGBA32(&pixData, &width, &height);
-
-    XPLMBindTexture2d(mGLTextureNum, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixData);
-
-    mOurAtlas->SetTexID(reinterpret_cast<void *>(static_cast<intptr_t>(mGLTextureNum)));
-    mTextureBound = true;
+    mOurAtlas->GetTexDataAsAlpha8(&pixData, &width, &height);
+    mTexDataBuilt = true;
 }
 
 ImgFreeTypeFontAtlas::ImgFreeTypeFontAtlas(unsigned int globalFlags):
@@ -42,7 +42,7 @@ public:
     explicit ImgFreeTypeFontAtlas(unsigned int globalFlags = 0);
     virtual ~ImgFreeTypeFontAtlas();
 
-    void bindTexture() override;
+    void buildTexData() override;
 protected:
     unsigned int mGlobalFlags;
 };
@@ -0,0 +1,467 @@
+/*
+ * ImgGlyphCache.cpp
+ *
+ * Integration for dear imgui into X-Plane: On-Demand Glyph Cache
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgGlyphCache.h"
+#include "ImgProfiler.h"
+#include "SystemGL.h"
+
+#include <XPLMGraphics.h>
+#include <imgui_internal.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+// A private copy of stb_truetype: imgui_draw.cpp compiles its own as static
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable: 4505)     // unreferenced local function has been removed
+#elif defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-function"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <imstb_truetype.h>
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#elif defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+/** A font file glyphs are taken from */
+struct ImgGlyphCache::Source {
+    ImFontConfig                cfg;        ///< size, oversampling and spacing as for baking
+    std::vector<unsigned char>  fileData;   ///< contents of fallback files (own sources use cfg.FontData)
+    stbtt_fontinfo              info;
+    float                       scale   = 0.0f;
+    bool                        bValid  = false;
+
+    /** Open the font in `data` with the settings in `cfg` */
+    void init (const unsigned char *data)
+    {
+        const int offset = stbtt_GetFontOffsetForIndex(data, cfg.FontNo);
+        bValid = offset >= 0 && stbtt_InitFont(&info, data, offset);
+        if (bValid)
+            scale = cfg.SizePixels > 0.0f ? stbtt_ScaleForPixelHeight(&info, cfg.SizePixels) :
+                                            stbtt_ScaleForMappingEmToPixels(&info, -cfg.SizePixels);
+    }
+};
+
+/** A reserved area of the atlas, filled shelf by shelf */
+struct ImgGlyphCache::Page {
+    struct Shelf {
+        int y, height, usedWidth;
+    };
+
+    int                         x = 0, y = 0;       ///< position in the atlas texture
+    std::vector<unsigned char>  pixels;             ///< coverage, page size squared
+    std::vector<Shelf>          shelves;
+    int                         usedHeight = 0;
+    std::vector<ImWchar>        glyphs;             ///< codepoints stored here
+    unsigned                    lastUsed = 0;       ///< LRU frame of the last request
+    int dirtyX0 = INT_MAX, dirtyY0 = INT_MAX, dirtyX1 = 0, dirtyY1 = 0;
+
+    bool isDirty () const { return dirtyX0 < dirtyX1; }
+
+    void markDirty (int x0, int y0, int x1, int y1)
+    {
+        dirtyX0 = std::min(dirtyX0, x0);
+        dirtyY0 = std::min(dirtyY0, y0);
+        dirtyX1 = std::max(dirtyX1, x1);
+        dirtyY1 = std::max(dirtyY1, y1);
+    }
+
+    void clearDirty ()
+    {
+        dirtyX0 = dirtyY0 = INT_MAX;
+        dirtyX1 = dirtyY1 = 0;
+    }
+
+    /** Place a `w` x `h` rect on the best fitting shelf, or open a new one
+     * of at least `shelfHeight` */
+    bool fit (int w, int h, int size, int shelfHeight, int &outX, int &outY)
+    {
+        Shelf *best = nullptr;
+        for (Shelf &s: shelves)
+            if (s.height >= h && s.usedWidth + w <= size &&
+                (!best || s.height < best->height))
+                best = &s;
+        if (!best) {
+            const int newHeight = std::max(h, shelfHeight);
+            if (w > size || usedHeight + newHeight > size)
+                return false;
+            shelves.push_back({usedHeight, newHeight, 0});
+            usedHeight += newHeight;
+            best = &shelves.back();
+        }
+        outX = best->usedWidth;
+        outY = best->y;
+        best->usedWidth += w;
+        return true;
+    }
+};
+
+ImgGlyphCache::ImgGlyphCache(ImFontAtlas *atlas, ImFont *font, int pageSize, int numPages):
+    mAtlas(atlas),
+    mFont(font),
+    mPageSize(pageSize)
+{
+    // Page numbers must fit into a glyph's state byte
+    numPages = std::max(1, std::min(numPages, int(UINT8_MAX - GLYPH_PAGE0 + 1)));
+    for (int i = 0; i < numPages; i++)
+        mRectIds.push_back(mAtlas->AddCustomRectRegular(pageSize, pageSize));
+    mGlyphState.assign(size_t(IM_UNICODE_CODEPOINT_MAX) + 1, GLYPH_UNKNOWN);
+}
+
+ImgGlyphCache::~ImgGlyphCache() = default;
+
+bool
+ImgGlyphCache::addSource(const std::string &ttfFile, int fontNo)
+{
+    std::FILE *f = std::fopen(ttfFile.c_str(), "rb");
+    if (!f)
+        return false;
+    std::unique_ptr<Source> src(new Source());
+    unsigned char buf[16384];
+    for (size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0; )
+        src->fileData.insert(src->fileData.end(), buf, buf + n);
+    std::fclose(f);
+
+    // Settings are copied from the font once the atlas is built
+    src->cfg.FontNo = fontNo;
+    src->init(src->fileData.data());
+    if (!src->bValid)
+        return false;
+    mSources.push_back(std::move(src));
+    if (mTexNum)
+        attachTexture(mTexNum, mCompact, mSdfSpread);
+    return true;
+}
+
+void
+ImgGlyphCache::attachTexture(int texNum, bool bCompact, int sdfSpread)
+{
+    if (!mFont && mAtlas->Fonts.Size > 0)
+        mFont = mAtlas->Fonts[0];
+    if (!mFont)
+        return;
+    mTexNum = texNum;
+    mCompact = bCompact;
+    mSdfSpread = sdfSpread;
+
+    // The font's own files come first, with exactly the settings they were baked with
+    std::vector<std::unique_ptr<Source>> sources;
+    const ImFontConfig *mainCfg = nullptr;
+    for (const ImFontConfig &cfg: mAtlas->ConfigData) {
+        if (cfg.DstFont != mFont || !cfg.FontData)
+            continue;
+        if (!mainCfg)
+            mainCfg = &cfg;
+        std::unique_ptr<Source> src(new Source());
+        src->cfg = cfg;
+        src->init(static_cast<const unsigned char *>(cfg.FontData));
+        sources.push_back(std::move(src));
+    }
+    // then the fallback files, sized like the main font
+    for (std::unique_ptr<Source> &src: mSources) {
+        if (!src->fileData.empty()) {
+            const int fontNo = src->cfg.FontNo;
+            if (mainCfg)
+                src->cfg = *mainCfg;
+            else
+                src->cfg.SizePixels = mFont->FontSize;
+            src->cfg.FontData       = src->fileData.data();
+            src->cfg.FontDataSize   = int(src->fileData.size());
+            src->cfg.FontNo         = fontNo;
+            src->cfg.GlyphOffset    = ImVec2(0.0f, 0.0f);
+            src->init(src->fileData.data());
+            sources.push_back(std::move(src));
+        }
+    }
+    mSources = std::move(sources);
+
+    // Locate the pages the atlas has packed for us
+    if (mPages.empty()) {
+        for (int id: mRectIds) {
+            const ImFontAtlasCustomRect *r = mAtlas->GetCustomRectByIndex(id);
+            if (!r || !r->IsPacked())
+                continue;
+            std::unique_ptr<Page> page(new Page());
+            page->x = r->X;
+            page->y = r->Y;
+            page->pixels.assign(size_t(mPageSize) * size_t(mPageSize), 0);
+            mPages.push_back(std::move(page));
+        }
+    }
+}
+
+void
+ImgGlyphCache::request(const char *text, const char *text_end)
+{
+    if (!mTexNum || !text)
+        return;
+    if (!text_end)
+        text_end = text + std::strlen(text);
+
+    bool bAdded = false;
+    while (text < text_end) {
+        unsigned int c = 0;
+        text += ImTextCharFromUtf8(&c, text, text_end);
+        if (c == 0)
+            break;
+        if (c < 0x20 || c >= mGlyphState.size())
+            continue;
+
+        std::uint8_t &state = mGlyphState[c];
+        if (state >= GLYPH_PAGE0) {
+            mPages[state - GLYPH_PAGE0]->lastUsed = mFrame;
+            continue;
+        }
+        if (state != GLYPH_UNKNOWN)
+            continue;
+        if (mFont->FindGlyphNoFallback(ImWchar(c))) {
+            state = GLYPH_FIXED;                // baked into the atlas
+            continue;
+        }
+        bAdded |= addGlyph(c);
+    }
+
+    // New glyphs become visible to ImGui only with a new lookup table
+    if (bAdded)
+        mFont->BuildLookupTable();
+}
+
+bool
+ImgGlyphCache::addGlyph(unsigned int c)
+{
+    IMG_PROFILE_ZONE("ImgGlyphCache::addGlyph");
+    for (const std::unique_ptr<Source> &src: mSources) {
+        if (!src->bValid)
+            continue;
+        const int glyph = stbtt_FindGlyphIndex(&src->info, int(c));
+        if (!glyph)
+            continue;
+
+        // Same metrics as ImFontAtlasBuildWithStbTruetype() bakes them
+        const ImFontConfig &cfg = src->cfg;
+        const int oh = cfg.OversampleH, ov = cfg.OversampleV;
+        int x0, y0, x1, y1, advance, lsb;
+        stbtt_GetGlyphBitmapBoxSubpixel(&src->info, glyph, src->scale * oh, src->scale * ov,
+                                        0.0f, 0.0f, &x0, &y0, &x1, &y1);
+        stbtt_GetGlyphHMetrics(&src->info, glyph, &advance, &lsb);
+        const float offX = cfg.GlyphOffset.x;
+        const float offY = cfg.GlyphOffset.y + IM_ROUND(mFont->Ascent);
+
+        auto add = [&](float qx0, float qy0, float qx1, float qy1,
+                       float u0, float v0, float u1, float v1)
+        {
+            mFont->AddGlyph(&cfg, ImWchar(c), qx0 + offX, qy0 + offY, qx1 + offX, qy1 + offY,
+                            u0, v0, u1, v1, float(advance) * src->scale);
+            // BuildLookupTable() expects its TAB glyph to stay the last one
+            ImVector<ImFontGlyph> &glyphs = mFont->Glyphs;
+            if (glyphs.Size >= 2 && glyphs[glyphs.Size - 2].Codepoint == '\t')
+                ImSwap(glyphs[glyphs.Size - 2], glyphs[glyphs.Size - 1]);
+        };
+
+        // Blanks need no pixels and can stay for good
+        if (x1 <= x0 || y1 <= y0) {
+            add(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+            mGlyphState[c] = GLYPH_FIXED;
+            return true;
+        }
+
+        // A distance field atlas has no oversampling, its fields bring their own margin
+        unsigned char *sdf = nullptr;
+        int w = x1 - x0 + oh - 1;
+        int h = y1 - y0 + ov - 1;
+        int pad = mAtlas->TexGlyphPadding;
+        if (mSdfSpread > 0) {
+            sdf = stbtt_GetGlyphSDF(&src->info, src->scale, glyph, mSdfSpread, 128,
+                                    128.0f / float(mSdfSpread), &w, &h, &x0, &y0);
+            if (!sdf)
+                break;
+            pad = 0;
+        }
+        int cellX = 0, cellY = 0;
+        const int p = allocate(w + pad, h + pad, cellX, cellY);
+        if (p < 0) {
+            stbtt_FreeSDF(sdf, nullptr);
+            if (w + pad > mPageSize || h + pad > mPageSize) {
+                mGlyphState[c] = GLYPH_ABSENT;  // won't ever fit
+                mStats.glyphsMissing++;
+            } else
+                mStats.glyphsDropped++;         // try again next frame
+            return false;
+        }
+
+        // Pages are cleared when emptied, so the padding is already zero
+        Page &page = *mPages[size_t(p)];
+        const int gx = cellX + pad, gy = cellY + pad;
+        float subX = 0.0f, subY = 0.0f;
+        if (sdf) {
+            for (int row = 0; row < h; row++)
+                std::memcpy(&page.pixels[size_t(gy + row) * size_t(mPageSize) + size_t(gx)],
+                            sdf + size_t(row) * size_t(w), size_t(w));
+            stbtt_FreeSDF(sdf, nullptr);
+        } else
+            stbtt_MakeGlyphBitmapSubpixelPrefilter(&src->info, &page.pixels[size_t(gy) * size_t(mPageSize) + size_t(gx)],
+                                                   w, h, mPageSize, src->scale * oh, src->scale * ov,
+                                                   0.0f, 0.0f, oh, ov, &subX, &subY, glyph);
+        page.markDirty(cellX, cellY, gx + w, gy + h);
+
+        const ImVec2 &uv = mAtlas->TexUvScale;
+        add(float(x0) / oh + subX, float(y0) / ov + subY,
+            float(x0 + w) / oh + subX, float(y0 + h) / ov + subY,
+            float(page.x + gx) * uv.x, float(page.y + gy) * uv.y,
+            float(page.x + gx + w) * uv.x, float(page.y + gy + h) * uv.y);
+        page.glyphs.push_back(ImWchar(c));
+        page.lastUsed = mFrame;
+        mGlyphState[c] = std::uint8_t(GLYPH_PAGE0 + p);
+        mStats.glyphsAdded++;
+        return true;
+    }
+
+    mGlyphState[c] = GLYPH_ABSENT;
+    mStats.glyphsMissing++;
+    return false;
+}
+
+int
+ImgGlyphCache::allocate(int w, int h, int &x, int &y)
+{
+    // Most glyphs are about as high as the font, so shelves start out that high
+    const int shelfHeight = int(mFont->FontSize + 0.99f) + mAtlas->TexGlyphPadding;
+    for (size_t p = 0; p < mPages.size(); p++)
+        if (mPages[p]->fit(w, h, mPageSize, shelfHeight, x, y))
+            return int(p);
+
+    // Make room in the least recently used page the current frame doesn't need
+    int lru = -1;
+    for (size_t p = 0; p < mPages.size(); p++)
+        if (mPages[p]->lastUsed != mFrame &&
+            (lru < 0 || mPages[p]->lastUsed < mPages[size_t(lru)]->lastUsed))
+            lru = int(p);
+    if (lru < 0)
+        return -1;
+    evict(lru);
+    return mPages[size_t(lru)]->fit(w, h, mPageSize, shelfHeight, x, y) ? lru : -1;
+}
+
+void
+ImgGlyphCache::evict(int p)
+{
+    IMG_PROFILE_ZONE("ImgGlyphCache::evict");
+    Page &page = *mPages[size_t(p)];
+    const std::uint8_t pageState = std::uint8_t(GLYPH_PAGE0 + p);
+
+    // Remove the page's glyphs from the font, keeping the order of all others
+    ImVector<ImFontGlyph> &glyphs = mFont->Glyphs;
+    int n = 0;
+    for (int i = 0; i < glyphs.Size; i++) {
+        const unsigned int c = glyphs[i].Codepoint;
+        if (c < mGlyphState.size() && mGlyphState[c] == pageState)
+            continue;
+        glyphs[n++] = glyphs[i];
+    }
+    glyphs.resize(n);
+    for (ImWchar c: page.glyphs)
+        mGlyphState[c] = GLYPH_UNKNOWN;
+    mFont->BuildLookupTable();
+
+    // Clear all of it, so no stale pixels bleed into the padding of new glyphs
+    std::fill(page.pixels.begin(), page.pixels.end(), 0);
+    page.shelves.clear();
+    page.usedHeight = 0;
+    page.glyphs.clear();
+    page.markDirty(0, 0, mPageSize, mPageSize);
+
+    mGeneration++;
+    mStats.evictions++;
+}
+
+void
+ImgGlyphCache::flush()
+{
+    if (!mTexNum)
+        return;
+
+    bool bBound = false;
+    std::vector<std::uint32_t> rgba;
+    for (const std::unique_ptr<Page> &page: mPages) {
+        if (!page->isDirty())
+            continue;
+        IMG_PROFILE_ZONE("ImgGlyphCache::flush");
+        if (!bBound) {
+            XPLMBindTexture2d(mTexNum, 0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            bBound = true;
+        }
+
+        const int w = page->dirtyX1 - page->dirtyX0;
+        const int h = page->dirtyY1 - page->dirtyY0;
+        const unsigned char *src = &page->pixels[size_t(page->dirtyY0) * size_t(mPageSize) + size_t(page->dirtyX0)];
+        if (mCompact) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, mPageSize);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, page->x + page->dirtyX0, page->y + page->dirtyY0, w, h,
+                            GL_ALPHA, GL_UNSIGNED_BYTE, src);
+            mStats.bytesUploaded += size_t(w) * size_t(h);
+        } else {
+            // Expand to white with alpha, like the rest of the RGBA atlas
+            rgba.resize(size_t(w) * size_t(h));
+            for (int row = 0; row < h; row++)
+                for (int col = 0; col < w; col++)
+                    rgba[size_t(row) * size_t(w) + size_t(col)] =
+                        IM_COL32(255, 255, 255, src[size_t(row) * size_t(mPageSize) + size_t(col)]);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, page->x + page->dirtyX0, page->y + page->dirtyY0, w, h,
+                            GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+            mStats.bytesUploaded += rgba.size() * 4;
+        }
+        page->clearDirty();
+    }
+    if (bBound) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Glyphs requested from now on belong to the next frame
+    mFrame++;
+}
@@ -0,0 +1,143 @@
+/*
+ * ImgGlyphCache.h
+ *
+ * Integration for dear imgui into X-Plane: On-Demand Glyph Cache
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGGLYPHCACHE_H
+#define IMGGLYPHCACHE_H
+
+#include <imgui.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** ImgGlyphCache adds glyphs to a font when they are first needed
+ *
+ * Baking complete Cyrillic, Greek or CJK ranges makes the atlas huge and
+ * slow to build. Instead, a few fixed-size pages are reserved in the atlas
+ * as custom rects. Text that may contain such characters is passed to
+ * request() before it is drawn. Missing glyphs are then rasterized with
+ * stb_truetype, exactly as ImGui would have baked them, packed into a page
+ * and added to the font. flush() uploads just the changed part of each
+ * page with glTexSubImage2D.
+ *
+ * The pages live inside the atlas texture, so text keeps its single
+ * texture and draw batching is unaffected. When all pages are full, the
+ * least recently used page that isn't needed by the frame being built is
+ * emptied and its glyphs are removed from the font. This increases
+ * getGeneration(). Windows that re-render old draw data (retained mode)
+ * must then rebuild, because their vertices may point into the reused page.
+ *
+ * Glyphs come from the font's own source files first, regardless of the
+ * glyph ranges they were added with, then from fallback files added with
+ * addSource().
+ */
+class ImgGlyphCache {
+public:
+    /** Reserve `numPages` pages of `pageSize` x `pageSize` pixels in `atlas`
+     *
+     * Must be done before the atlas is built.
+     * @param font Font to extend, `nullptr` for the atlas' default font */
+    ImgGlyphCache(ImFontAtlas *atlas, ImFont *font, int pageSize, int numPages);
+    ~ImgGlyphCache();
+
+    ImgGlyphCache(const ImgGlyphCache &) = delete;
+    ImgGlyphCache &operator=(const ImgGlyphCache &) = delete;
+
+    /** Add a fallback font file, searched for glyphs the font's own sources lack
+     * @return `false` if the file can't be read or isn't a TrueType font */
+    bool addSource(const std::string &ttfFile, int fontNo = 0);
+
+    /** Start serving glyphs once the atlas is built and its texture created
+     * @param texNum The atlas texture
+     * @param bCompact Is the texture GL_ALPHA8 (otherwise white RGBA)?
+     * @param sdfSpread Distance field spread of the atlas, 0 for coverage */
+    void attachTexture(int texNum, bool bCompact, int sdfSpread = 0);
+
+    /** Make sure the font has glyphs for all characters in `text`
+     *
+     * Call while building the interface, before the text is measured or drawn.
+     * Cheap for characters that are already there. */
+    void request(const char *text, const char *text_end = nullptr);
+
+    /** Upload all page regions changed since the last call
+     *
+     * Needs a current GL context and ends the LRU frame: pages requested so far
+     * may be evicted again after this call. */
+    void flush();
+
+    /** Changes whenever glyphs were removed from the font */
+    unsigned getGeneration() const { return mGeneration; }
+
+    /** Counters since creation */
+    struct Stats {
+        unsigned glyphsAdded    = 0;    ///< glyphs rasterized into pages
+        unsigned glyphsMissing  = 0;    ///< codepoints none of the sources has
+        unsigned glyphsDropped  = 0;    ///< requests that found no page to evict (shown as fallback glyph)
+        unsigned evictions      = 0;    ///< pages emptied to make room
+        size_t   bytesUploaded  = 0;    ///< texture data sent by flush()
+    };
+    const Stats &getStats() const { return mStats; }
+
+protected:
+    struct Source;
+    struct Page;
+
+    /** Rasterize `c` into a page and add it to the font
+     * @return `false` if there was no room for it this frame */
+    bool addGlyph(unsigned int c);
+    /** Find room for a `w` x `h` rect, evicting a page if necessary
+     * @return page index or -1 */
+    int allocate(int w, int h, int &x, int &y);
+    /** Empty a page and remove its glyphs from the font */
+    void evict(int page);
+
+    /** Per-codepoint state in mGlyphState: unknown, known, or in page n */
+    enum : std::uint8_t { GLYPH_UNKNOWN = 0, GLYPH_FIXED, GLYPH_ABSENT, GLYPH_PAGE0 };
+
+    ImFontAtlas *mAtlas;
+    ImFont      *mFont;
+    int         mPageSize;
+    int         mTexNum = 0;
+    bool        mCompact = false;
+    int         mSdfSpread = 0;
+    unsigned    mFrame = 1;
+    unsigned    mGeneration = 0;
+    Stats       mStats;
+    std::vector<int>                        mRectIds;
+    std::vector<std::unique_ptr<Source>>    mSources;
+    std::vector<std::unique_ptr<Page>>      mPages;
+    std::vector<std::uint8_t>               mGlyphState;
+};
+
+#endif //IMGGLYPHCACHE_H
@@ -0,0 +1,166 @@
+/*
+ * ImgGpuTimer.cpp
+ *
+ * Integration for dear imgui into X-Plane: GPU Timing of Window Draws
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgGpuTimer.h"
+#include "XOGLUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool
+ImgGpuTimer::isAvailable()
+{
+    static const bool bAvailable = OGL_UtilsInit() && OGL_HasTimerQuery();
+    return bAvailable;
+}
+
+ImgGpuTimer::~ImgGpuTimer()
+{
+    if (mQueriesCreated) {
+        for (Pending& p: mPending)
+            glDeleteQueries(2, p.queries);
+    }
+}
+
+void
+ImgGpuTimer::begin(int frame)
+{
+    poll();
+    mCurrent = -1;
+
+    if (!mQueriesCreated) {
+        for (Pending& p: mPending)
+            glGenQueries(2, p.queries);
+        mQueriesCreated = true;
+    }
+
+    // All slots still waiting for the GPU? Then don't measure this frame.
+    Pending& p = mPending[mNext];
+    if (p.bActive)
+        return;
+
+    glQueryCounter(p.queries[0], GL_TIMESTAMP);
+    p.frame = frame;
+    mCurrent = mNext;
+}
+
+void
+ImgGpuTimer::end()
+{
+    if (mCurrent < 0)
+        return;
+    Pending& p = mPending[mCurrent];
+    glQueryCounter(p.queries[1], GL_TIMESTAMP);
+    p.bActive = true;
+    mNext = (mCurrent + 1) % QUERIES_IN_FLIGHT;
+    mCurrent = -1;
+}
+
+void
+ImgGpuTimer::poll()
+{
+    // oldest measurement first, which is the one at mNext
+    for (int i = 0; i < QUERIES_IN_FLIGHT; i++) {
+        Pending& p = mPending[(mNext + i) % QUERIES_IN_FLIGHT];
+        if (!p.bActive)
+            continue;
+
+        // Results come in order, so if this one isn't there, later ones aren't either
+        GLint available = 0;
+        glGetQueryObjectiv(p.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 tBegin = 0, tEnd = 0;
+        glGetQueryObjectui64v(p.queries[0], GL_QUERY_RESULT, &tBegin);
+        glGetQueryObjectui64v(p.queries[1], GL_QUERY_RESULT, &tEnd);
+        p.bActive = false;
+
+        const Sample s = { p.frame, tEnd > tBegin ? float(double(tEnd - tBegin) / 1.0e6) : 0.0f };
+        if (mSamples.size() < MAX_SAMPLES)
+            mSamples.push_back(s);
+        else {
+            mSamples[mHead] = s;
+            mHead = (mHead + 1) % MAX_SAMPLES;
+        }
+    }
+}
+
+ImgGpuTimer::Stats
+ImgGpuTimer::getStats() const
+{
+    Stats stats;
+    if (mSamples.empty())
+        return stats;
+
+    std::vector<float> ms;
+    ms.reserve(mSamples.size());
+    double sum = 0.0;
+    for (const Sample& s: mSamples) {
+        ms.push_back(s.ms);
+        sum += s.ms;
+    }
+    std::sort(ms.begin(), ms.end());
+
+    stats.samples = ms.size();
+    stats.minMs   = ms.front();
+    stats.avgMs   = float(sum / double(ms.size()));
+    // nearest-rank percentile
+    const size_t rank = size_t(std::ceil(0.99 * double(ms.size())));
+    stats.p99Ms   = ms[rank > 0 ? rank - 1 : 0];
+    return stats;
+}
+
+void
+ImgGpuTimer::writeCSV(std::ostream& out, const std::string& label) const
+{
+    // CSV quoting: double any quote in the label
+    std::string quoted;
+    for (char c: label) {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    for (size_t i = 0; i < mSamples.size(); i++) {
+        const Sample& s = mSamples[(mHead + i) % mSamples.size()];
+        out << '"' << quoted << "\"," << s.frame << ',' << s.ms << '\n';
+    }
+}
+
+void
+ImgGpuTimer::clear()
+{
+    mSamples.clear();
+    mHead = 0;
+}
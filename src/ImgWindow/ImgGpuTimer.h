@@ -0,0 +1,121 @@
+/*
+ * ImgGpuTimer.h
+ *
+ * Integration for dear imgui into X-Plane: GPU Timing of Window Draws
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGGPUTIMER_H
+#define IMGGPUTIMER_H
+
+#include "SystemGL.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** ImgGpuTimer measures the GPU time spent between begin() and end().
+ *
+ * Both points are marked with GL timestamp queries.  Results are only read
+ * once the GPU reports them available, typically a few frames later, so
+ * measuring never stalls the pipeline.  If all queries are still in flight
+ * the frame simply isn't measured.  The last MAX_SAMPLES results are kept
+ * in a ring buffer.
+ *
+ * Timestamp queries (ARB_timer_query) are not available in the legacy
+ * context on Mac, check isAvailable() before creating a timer.
+ */
+class ImgGpuTimer {
+public:
+    /** Number of samples kept */
+    static constexpr size_t MAX_SAMPLES         = 512;
+    /** Number of measurements which may be waiting for results */
+    static constexpr int    QUERIES_IN_FLIGHT   = 6;
+
+    /** Statistics over the samples in the ring buffer */
+    struct Stats {
+        size_t  samples = 0;        ///< number of samples the values are based on
+        float   minMs   = 0.0f;     ///< minimum GPU time in milliseconds
+        float   avgMs   = 0.0f;     ///< average GPU time in milliseconds
+        float   p99Ms   = 0.0f;     ///< 99th percentile of GPU time in milliseconds
+    };
+
+    /** Does the driver support timestamp queries? */
+    static bool isAvailable();
+
+    ImgGpuTimer() {}
+    ~ImgGpuTimer();
+
+    /** ImgGpuTimer objects own GL queries, they must not be copied */
+    ImgGpuTimer (const ImgGpuTimer&) = delete;
+    ImgGpuTimer& operator = (const ImgGpuTimer&) = delete;
+
+    /** Start measuring, also collects results of earlier measurements
+     * @param frame Frame number to record with the sample */
+    void begin(int frame);
+
+    /** Stop measuring */
+    void end();
+
+    /** min/avg/p99 over all samples */
+    Stats getStats() const;
+
+    /** Write all samples, oldest first, as CSV lines `"label",frame,gpu_ms` */
+    void writeCSV(std::ostream& out, const std::string& label) const;
+
+    /** Drop all samples */
+    void clear();
+
+private:
+    /** One measurement waiting for its results */
+    struct Pending {
+        GLuint  queries[2]  = {0, 0};   ///< timestamps at begin() and end()
+        int     frame       = 0;        ///< frame number passed to begin()
+        bool    bActive     = false;    ///< waiting for results?
+    };
+
+    /** One result */
+    struct Sample {
+        int     frame;
+        float   ms;
+    };
+
+    /** Read all available results */
+    void poll();
+
+    Pending             mPending[QUERIES_IN_FLIGHT];
+    bool                mQueriesCreated = false;
+    int                 mNext           = 0;    ///< slot to use for the next measurement
+    int                 mCurrent        = -1;   ///< slot measuring right now, -1 if none
+    std::vector<Sample> mSamples;               ///< ring buffer of results
+    size_t              mHead           = 0;    ///< next position to write in mSamples once full
+};
+
+#endif // IMGGPUTIMER_H
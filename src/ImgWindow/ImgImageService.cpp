@@ -0,0 +1,565 @@
+/*
+ * ImgImageService.cpp
+ *
+ * Integration for dear imgui into X-Plane: Asynchronous Image Loading
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgImageService.h"
+#include "ImgProfiler.h"
+#include "ImgTextureData.h"
+#include "ImgTextureUploader.h"
+#include "SystemGL.h"
+
+#include <XPLMGraphics.h>
+#include <XPLMProcessing.h>
+#include <XPLMUtilities.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#define STB_IMAGE_IMPLEMENTATION
+// Workers decode in parallel, each needs its own stbi_failure_reason()
+#define STBI_THREAD_LOCAL thread_local
+#include "stb_image.h"
+
+/** Decoding threads, they mostly wait for the disk and inflate JPEGs */
+constexpr unsigned MAX_WORKERS = 2;
+
+/** FNV-1a, 64 bit */
+static std::uint64_t hash(const void *data, size_t size)
+{
+    std::uint64_t h = 14695981039346656037ull;
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+/** Read a whole file */
+static bool readFile(const std::string &path, std::vector<unsigned char> &out)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    bool bOK = std::fseek(f, 0, SEEK_END) == 0;
+    const long size = bOK ? std::ftell(f) : -1;
+    bOK = size >= 0 && std::fseek(f, 0, SEEK_SET) == 0;
+    if (bOK) {
+        out.resize(size_t(size));
+        bOK = std::fread(out.data(), 1, out.size(), f) == out.size();
+    }
+    std::fclose(f);
+    return bOK;
+}
+
+/** One requested image */
+struct ImgImageService::Image {
+    std::string     path;
+    State           state = IMG_LOADING;
+    int             width = 0;          ///< 0 until the header was read
+    int             height = 0;
+    std::shared_ptr<ImgTextureData> data;   ///< all levels, loaded but not uploaded yet
+    int             texNum = 0;
+    size_t          bytes = 0;          ///< of the texture
+    float           progress = 0.0f;    ///< part uploaded
+    unsigned        refs = 0;           ///< request() minus release()
+    int             lastDrawn = 0;      ///< cycle number
+    bool            bEvicted = false;   ///< texture deleted, not loading again yet
+    std::string     error;
+};
+
+ImgImageService&
+ImgImageService::get()
+{
+    static ImgImageService theService;
+    return theService;
+}
+
+ImgImageService::~ImgImageService()
+{
+    // Textures can't be deleted this late anymore, but the threads must end
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        bStop = true;
+    }
+    mWakeCond.notify_all();
+    for (std::thread &t: mWorkers)
+        t.join();
+}
+
+void
+ImgImageService::setTextureCache(const std::string &pathPrefix, bool bCompress)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mCachePrefix = pathPrefix;
+    bCompressTextures = bCompress;
+}
+
+std::string
+ImgImageService::cacheFile(const std::string &path) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mCachePrefix.empty())
+        return std::string();
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)hash(path.data(), path.size()));
+    return mCachePrefix + name;
+}
+
+void
+ImgImageService::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mBudget = bytes;
+}
+
+size_t
+ImgImageService::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mBudget;
+}
+
+ImgImageService::Handle
+ImgImageService::request(const std::string &path)
+{
+    Handle h = 0;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.requests++;
+        for (size_t i = 0; i < mImages.size() && !h; i++) {
+            Image &img = *mImages[i];
+            if (img.path != path)
+                continue;
+            h = Handle(i + 1);
+            img.refs++;
+            if (!reloadIfEvicted(h, img)) {
+                mStats.hits++;
+                return h;
+            }
+        }
+
+        if (!h) {
+            mImages.emplace_back(new Image);
+            mImages.back()->path = path;
+            mImages.back()->refs = 1;
+            h = Handle(mImages.size());
+            mDecodeQueue.push_back(h);
+            mStats.misses++;
+        }
+    }
+    startWorkers();
+    mWakeCond.notify_one();
+    return h;
+}
+
+void
+ImgImageService::release(Handle h)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    Image *img = find(h);
+    if (img && img->refs > 0)
+        img->refs--;
+}
+
+bool
+ImgImageService::reloadIfEvicted(Handle h, Image &img)
+{
+    if (!img.bEvicted)
+        return false;
+    img.bEvicted = false;
+    mDecodeQueue.push_back(h);
+    mStats.misses++;
+    return true;
+}
+
+ImgImageService::Image *
+ImgImageService::find(Handle h) const
+{
+    return h > 0 && size_t(h) <= mImages.size() ? mImages[size_t(h) - 1].get() : nullptr;
+}
+
+ImgImageService::State
+ImgImageService::getState(Handle h) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const Image *img = find(h);
+    return img ? img->state : IMG_NONE;
+}
+
+bool
+ImgImageService::getTexture(Handle h, int &texNum, ImVec2 &size) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const Image *img = find(h);
+    if (!img || img->state != IMG_READY)
+        return false;
+    texNum = img->texNum;
+    size = ImVec2(float(img->width), float(img->height));
+    return true;
+}
+
+bool
+ImgImageService::getSize(Handle h, ImVec2 &size) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const Image *img = find(h);
+    if (!img || img->width <= 0 || img->height <= 0)
+        return false;
+    size = ImVec2(float(img->width), float(img->height));
+    return true;
+}
+
+float
+ImgImageService::getProgress(Handle h) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const Image *img = find(h);
+    return img ? img->progress : 0.0f;
+}
+
+std::string
+ImgImageService::getError(Handle h) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const Image *img = find(h);
+    return img ? img->error : std::string();
+}
+
+void
+ImgImageService::image(Handle h, const ImVec2 &size)
+{
+    // Drawn now, and needed again if evicted
+    bool bReload = false;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (Image *img = find(h)) {
+            img->lastDrawn = mUploadCycle;
+            bReload = reloadIfEvicted(h, *img);
+        }
+    }
+    if (bReload)
+        mWakeCond.notify_one();
+
+    int texNum = 0;
+    ImVec2 imgSize;
+    if (getTexture(h, texNum, imgSize)) {
+        ImGui::Image((void*)(intptr_t)texNum, size.x > 0.0f && size.y > 0.0f ? size : imgSize);
+        return;
+    }
+
+    // Placeholder: a frame in the final size, or one fitting the label while even that is unknown
+    const bool bFailed = getState(h) == IMG_FAILED;
+    char label[32] = "Image not available";
+    if (!bFailed) {
+        const float progress = getProgress(h);
+        if (progress > 0.0f)
+            std::snprintf(label, sizeof(label), "Loading... %d%%", int(progress * 100.0f));
+        else
+            std::snprintf(label, sizeof(label), "Loading...");
+    }
+    const ImVec2 labelSize = ImGui::CalcTextSize(label);
+    if (!(size.x > 0.0f && size.y > 0.0f) && !getSize(h, imgSize)) {
+        const ImVec2 &padding = ImGui::GetStyle().FramePadding;
+        imgSize = ImVec2(labelSize.x + 2.0f * padding.x, ImGui::GetFrameHeight() * 4.0f);
+    }
+    const ImVec2 drawSize = size.x > 0.0f && size.y > 0.0f ? size : imgSize;
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(drawSize);
+    if (!ImGui::IsItemVisible())
+        return;
+
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    const ImVec2 end(pos.x + drawSize.x, pos.y + drawSize.y);
+    drawList->AddRectFilled(pos, end, ImGui::GetColorU32(ImGuiCol_FrameBg));
+    drawList->AddRect(pos, end, ImGui::GetColorU32(ImGuiCol_Border));
+    drawList->PushClipRect(pos, end, true);
+    drawList->AddText(ImVec2(pos.x + std::max(0.0f, (drawSize.x - labelSize.x) / 2.0f),
+                             pos.y + std::max(0.0f, (drawSize.y - labelSize.y) / 2.0f)),
+                      ImGui::GetColorU32(bFailed ? ImGuiCol_Text : ImGuiCol_TextDisabled), label);
+    drawList->PopClipRect();
+    if (bFailed && ImGui::IsItemHovered())
+        ImGui::SetTooltip("%s", getError(h).c_str());
+}
+
+void
+ImgImageService::markDrawn(int texNum)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const auto iter = mTextureImages.find(texNum);
+    if (iter != mTextureImages.end())
+        find(iter->second)->lastDrawn = mUploadCycle;
+}
+
+void
+ImgImageService::processUploads()
+{
+    // Once per frame, however many windows call
+    const int cycle = XPLMGetCycleNumber();
+    if (cycle == mUploadCycle)
+        return;
+    mUploadCycle = cycle;
+
+    IMG_PROFILE_ZONE("ImgImageService::processUploads");
+    std::lock_guard<std::mutex> lock(mLock);
+    while (!mUploadQueue.empty()) {
+        const Handle h = mUploadQueue.front();
+        mUploadQueue.pop_front();
+        Image *img = find(h);
+        if (img->state == IMG_FAILED) {
+            // Workers mustn't call XPLM, so failures are reported from here
+            mGeneration++;
+            XPLMDebugString(("ImgWindow: Couldn't load image " + img->path + ": " + img->error + "\n").c_str());
+            continue;
+        }
+
+        // The uploader sends the levels over the next frames, and frees them when done
+        XPLMGenerateTextureNumbers(&img->texNum, 1);
+        mTextureImages[img->texNum] = h;
+        img->bytes = img->data->getBytes();
+        img->lastDrawn = cycle;
+        img->progress = 0.0f;
+        mTextureBytes += img->bytes;
+        mStats.bytesUploaded += img->bytes;
+        ImgTextureUploader::get().upload(img->texNum, std::move(img->data),
+                                         [this, h](float progress) { uploadProgress(h, progress); });
+    }
+
+    if (mBudget > 0)
+        evict(cycle);
+}
+
+void
+ImgImageService::evict(int cycle)
+{
+    while (mTextureBytes > mBudget) {
+        // Unreferenced first, then the least recently drawn, but nothing drawn lately
+        Image *victim = nullptr;
+        for (const std::unique_ptr<Image> &img: mImages) {
+            if (img->state != IMG_READY || cycle - img->lastDrawn < EVICT_AFTER_FRAMES)
+                continue;
+            if (!victim ||
+                (img->refs == 0) > (victim->refs == 0) ||
+                ((img->refs == 0) == (victim->refs == 0) && img->lastDrawn < victim->lastDrawn))
+                victim = img.get();
+        }
+        if (!victim)
+            break;
+
+        GLuint tex = GLuint(victim->texNum);
+        glDeleteTextures(1, &tex);
+        mTextureImages.erase(victim->texNum);
+        mTextureBytes -= victim->bytes;
+        victim->texNum = 0;
+        victim->bytes = 0;
+        victim->progress = 0.0f;
+        victim->state = IMG_LOADING;
+        victim->bEvicted = true;
+        mStats.evictions++;
+        // Retained draw data may still refer to the texture
+        mGeneration++;
+    }
+}
+
+void
+ImgImageService::uploadProgress(Handle h, float progress)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    Image *img = find(h);
+    if (!img)
+        return;
+    img->progress = progress;
+    if (progress >= 1.0f) {
+        img->state = IMG_READY;
+        mStats.uploaded++;
+    }
+    // Also the placeholders' progress needs redrawing
+    mGeneration++;
+}
+
+unsigned
+ImgImageService::getGeneration() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mGeneration;
+}
+
+size_t
+ImgImageService::getTextureBytes() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mTextureBytes;
+}
+
+ImgImageService::Stats
+ImgImageService::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    Stats stats = mStats;
+    stats.bytesResident = mTextureBytes;
+    return stats;
+}
+
+void
+ImgImageService::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        bStop = true;
+        mDecodeQueue.clear();
+    }
+    mWakeCond.notify_all();
+    for (std::thread &t: mWorkers)
+        t.join();
+    mWorkers.clear();
+
+    for (const std::unique_ptr<Image> &img: mImages) {
+        if (img->texNum) {
+            ImgTextureUploader::get().cancel(img->texNum);
+            GLuint tex = GLuint(img->texNum);
+            glDeleteTextures(1, &tex);
+        }
+    }
+    mImages.clear();
+    mUploadQueue.clear();
+    mTextureImages.clear();
+    mTextureBytes = 0;
+    mUploadCycle = -1;
+    mGeneration++;
+    bStop = false;
+}
+
+void
+ImgImageService::startWorkers()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mWorkers.empty())
+        return;
+    const unsigned cores = std::thread::hardware_concurrency();
+    const unsigned n = std::max(1u, std::min(MAX_WORKERS, cores > 1 ? cores - 1 : 1));
+    for (unsigned i = 0; i < n; i++)
+        mWorkers.emplace_back(&ImgImageService::workerLoop, this);
+}
+
+void
+ImgImageService::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    for (;;) {
+        mWakeCond.wait(lock, [this] { return bStop || !mDecodeQueue.empty(); });
+        if (bStop)
+            break;
+        const Handle h = mDecodeQueue.front();
+        mDecodeQueue.pop_front();
+        // Images are only ever removed by shutdown(), which waits for us
+        Image &img = *find(h);
+        lock.unlock();
+
+        decode(img);
+
+        lock.lock();
+        if (img.state == IMG_FAILED)
+            mStats.failed++;
+        else
+            mStats.decoded++;
+        // processUploads() takes over, also to report failures
+        mUploadQueue.push_back(h);
+    }
+}
+
+void
+ImgImageService::decode(Image &img)
+{
+    IMG_PROFILE_ZONE("ImgImageService::decode");
+    const auto start = std::chrono::steady_clock::now();
+    const std::string texFile = cacheFile(img.path);
+    bool bCompressWanted;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        bCompressWanted = bCompressTextures;
+    }
+
+    std::vector<unsigned char> file;
+    std::shared_ptr<ImgTextureData> data;
+    const char *error = nullptr;
+    bool bCacheHit = false;
+    if (!readFile(img.path, file)) {
+        error = "can't read file";
+    } else {
+        // The cache file is only good for exactly these file contents
+        const std::uint64_t key = hash(file.data(), file.size());
+        if (!texFile.empty()) {
+            data = ImgTextureData::load(texFile, key);
+            if (data && data->isCompressed() != bCompressWanted)
+                data.reset();
+            bCacheHit = data != nullptr;
+        }
+
+        if (!data) {
+            // The header first, so placeholders get the right size early
+            int width = 0, height = 0, nComps = 0;
+            const int fileSize = int(std::min(file.size(), size_t(INT32_MAX)));
+            if (stbi_info_from_memory(file.data(), fileSize, &width, &height, &nComps)) {
+                std::lock_guard<std::mutex> lock(mLock);
+                img.width = width;
+                img.height = height;
+            }
+
+            unsigned char *pixels = stbi_load_from_memory(file.data(), fileSize, &width, &height, &nComps, 4);
+            if (pixels) {
+                data = ImgTextureData::fromRGBA(pixels, width, height, true, bCompressWanted);
+                stbi_image_free(pixels);
+                // If that fails, it's just slower next time
+                if (!texFile.empty())
+                    data->save(texFile, key);
+            } else {
+                error = stbi_failure_reason() ? stbi_failure_reason() : "unknown error";
+            }
+        }
+    }
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mStats.decodeMs += ms;
+    if (!data) {
+        img.error = error;
+        img.state = IMG_FAILED;
+        return;
+    }
+    if (bCacheHit)
+        mStats.cacheHits++;
+    else if (!texFile.empty())
+        mStats.cacheMisses++;
+    img.width = data->getWidth();
+    img.height = data->getHeight();
+    img.data = std::move(data);
+}
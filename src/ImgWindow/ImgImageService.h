@@ -0,0 +1,228 @@
+/*
+ * ImgImageService.h
+ *
+ * Integration for dear imgui into X-Plane: Asynchronous Image Loading
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGIMAGESERVICE_H
+#define IMGIMAGESERVICE_H
+
+#include <imgui.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** ImgImageService loads images into textures without stalling the sim
+ *
+ * request() returns a handle right away. Worker threads then read and decode
+ * the file with stb_image. The main thread hands decoded images over to
+ * ImgTextureUploader in processUploads(), called once per frame from the
+ * windows' draw callbacks, which spreads big images over several frames.
+ *
+ * Until then image() draws a placeholder, in the image's size as soon as the
+ * file's header is read, showing the upload's progress. Every image that
+ * progresses, gets ready, or fails increases getGeneration(), so windows in
+ * retained mode know they need to rebuild.
+ *
+ * The workers also derive the mip levels, compressed to S3TC if the GPU
+ * supports it (ImgTextureData). That result is kept in a texture cache file
+ * per image if setTextureCache() was called, so later loads of an unchanged
+ * image skip decoding and compressing and just read the file.
+ *
+ * Handles are reference counted: request() the same path again, e.g. from
+ * another window, returns the same handle with one more reference, and
+ * release() gives one up. Textures stay within a video memory budget: once
+ * above it, processUploads() deletes the textures not drawn for a while,
+ * least recently drawn first, and among them those nobody references
+ * anymore. An evicted image loads again, from the texture cache if there is
+ * one, as soon as it is drawn or requested again. Windows report what they
+ * draw with markDrawn().
+ *
+ * Entries, and so their handles, live until shutdown().
+ */
+class ImgImageService {
+public:
+    /** Textures drawn within this many frames are not evicted */
+    static constexpr int EVICT_AFTER_FRAMES = 60;
+
+    /** Identifies a requested image, 0 is none */
+    typedef int Handle;
+
+    enum State {
+        IMG_NONE = 0,                   ///< invalid handle
+        IMG_LOADING,                    ///< queued, being decoded, waiting for upload, or evicted
+        IMG_READY,                      ///< texture available
+        IMG_FAILED,                     ///< file missing or not decodable
+    };
+
+    /** Counters since start */
+    struct Stats {
+        unsigned    requests        = 0;    ///< calls to request()
+        unsigned    decoded         = 0;    ///< images decoded by the workers
+        unsigned    failed          = 0;    ///< images that couldn't be loaded
+        unsigned    uploaded        = 0;    ///< textures completely uploaded
+        size_t      bytesUploaded   = 0;    ///< texture data handed to ImgTextureUploader
+        unsigned    hits            = 0;    ///< requests for images already having a texture
+        unsigned    misses          = 0;    ///< requests and draws that had to load an image
+        unsigned    evictions       = 0;    ///< textures deleted to stay within the budget
+        size_t      bytesResident   = 0;    ///< video memory of all textures now
+        unsigned    cacheHits       = 0;    ///< images read from the texture cache
+        unsigned    cacheMisses     = 0;    ///< images decoded, compressed, and then cached
+        float       decodeMs        = 0.0f; ///< time the workers spent loading and compressing
+    };
+
+    /** The one instance shared by all windows */
+    static ImgImageService& get();
+
+    ImgImageService(const ImgImageService &) = delete;
+    ImgImageService &operator=(const ImgImageService &) = delete;
+
+    /** Keep derived textures in files starting with `pathPrefix`
+     *
+     * Set before the first request(). An empty prefix (the default) disables the cache.
+     * @param bCompress Compress textures to S3TC, see OGL_HasTextureCompression() */
+    void setTextureCache(const std::string &pathPrefix, bool bCompress);
+
+    /** Video memory the images' textures may use, 0 for no limit
+     *
+     * Images drawn in the last EVICT_AFTER_FRAMES frames are never evicted,
+     * so what is on screen may still exceed it. */
+    void setBudget(size_t bytes);
+
+    /** Video memory the images' textures may use */
+    size_t getBudget() const;
+
+    /** Start loading the image file at `path`, unless that happened before
+     *
+     * Adds a reference, give it up with release().
+     * @return Handle to draw the image with, never 0 */
+    Handle request(const std::string &path);
+
+    /** Give up a reference from request()
+     *
+     * Unreferenced textures are kept until the budget needs the space. */
+    void release(Handle h);
+
+    /** Current state of the image */
+    State getState(Handle h) const;
+
+    /** Texture and size of a loaded image
+     * @return `false` if the image isn't ready (yet) */
+    bool getTexture(Handle h, int &texNum, ImVec2 &size) const;
+
+    /** Size in pixels, known before the image is ready once its header was read
+     * @return `false` if it isn't known yet */
+    bool getSize(Handle h, ImVec2 &size) const;
+
+    /** Part of the texture uploaded so far, 0..1 */
+    float getProgress(Handle h) const;
+
+    /** Why the image failed to load */
+    std::string getError(Handle h) const;
+
+    /** Draw the image with ImGui::Image(), or a placeholder of the same size
+     *
+     * Loads an evicted image again.
+     * @param size Size to draw in, (0,0) for the image's own size */
+    void image(Handle h, const ImVec2 &size = ImVec2(0.0f, 0.0f));
+
+    /** Note that a texture was drawn in this frame
+     *
+     * Windows call this while rendering, also when replaying retained
+     * draw data, so images stay resident while visible. Other textures are
+     * ignored. */
+    void markDrawn(int texNum);
+
+    /** Create textures for decoded images and queue their upload, evict textures over the budget
+     *
+     * Needs a current GL context. Only the first call per X-Plane frame does
+     * anything, so every window's draw callback may call it. */
+    void processUploads();
+
+    /** Changes whenever an image got ready or failed */
+    unsigned getGeneration() const;
+
+    /** Video memory requested for the images' textures */
+    size_t getTextureBytes() const;
+
+    /** Current counters */
+    Stats getStats() const;
+
+    /** Stop the workers and delete all textures, invalidates all handles */
+    void shutdown();
+
+private:
+    ImgImageService() = default;
+    ~ImgImageService();
+
+    struct Image;
+
+    /** Start the worker threads if not running yet */
+    void startWorkers();
+    void workerLoop();
+    /** Read and decode one image on a worker thread, or get it from the cache */
+    void decode(Image &img);
+    /** The image's texture cache file, empty if there is no cache */
+    std::string cacheFile(const std::string &path) const;
+    /** Queue the image for loading again if it was evicted, lock held
+     * @return `true` if queued, wake a worker then */
+    bool reloadIfEvicted(Handle h, Image &img);
+    /** Delete least recently drawn textures until within the budget, lock held */
+    void evict(int cycle);
+    /** Called by ImgTextureUploader after each strip */
+    void uploadProgress(Handle h, float progress);
+    /** The image behind a handle, `nullptr` for invalid handles, lock held */
+    Image *find(Handle h) const;
+
+    mutable std::mutex                      mLock;
+    std::condition_variable                 mWakeCond;
+    std::vector<std::thread>                mWorkers;
+    bool                                    bStop = false;
+    std::vector<std::unique_ptr<Image>>     mImages;        ///< index is handle - 1
+    std::deque<Handle>                      mDecodeQueue;   ///< waiting for a worker
+    std::deque<Handle>                      mUploadQueue;   ///< decoded or failed, waiting for processUploads()
+    std::unordered_map<int, Handle>         mTextureImages; ///< texture number to image, for markDrawn()
+    int                                     mUploadCycle = -1;
+    unsigned                                mGeneration = 0;
+    size_t                                  mTextureBytes = 0;
+    size_t                                  mBudget = 256 * 1024 * 1024;
+    std::string                             mCachePrefix;
+    bool                                    bCompressTextures = false;
+    Stats                                   mStats;
+};
+
+#endif //IMGIMAGESERVICE_H
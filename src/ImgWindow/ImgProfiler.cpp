@@ -0,0 +1,187 @@
+/*
+ * ImgProfiler.cpp
+ *
+ * Integration for dear imgui into X-Plane: Scoped-Zone CPU Profiler
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+/** Ring buffer of one thread's zones
+ *
+ * Only the owning thread writes. Readers copy the entries below `written`;
+ * the oldest of them may be overwritten while being copied, which at worst
+ * garbles one zone of the oldest frame in the buffer. */
+struct ThreadBuffer {
+    std::array<ImgProfiler::Event, ImgProfiler::EVENTS_PER_THREAD> events;
+    std::atomic<std::uint64_t>  written {0};    ///< number of events ever written
+    std::uint16_t               depth   = 0;    ///< current nesting depth
+    std::uint16_t               thread  = 0;    ///< our thread number
+};
+
+/** All thread buffers ever created, they live until the plugin is unloaded
+ * as threads may end at any time */
+struct Registry {
+    std::mutex                                  lock;
+    std::vector<std::unique_ptr<ThreadBuffer>>  buffers;
+};
+
+Registry& registry ()
+{
+    static Registry reg;
+    return reg;
+}
+
+/** Frame counter and frame start times */
+std::atomic<std::uint32_t> gFrame {0};
+std::atomic<std::uint64_t> gFrameStart[ImgProfiler::FRAMES_KEPT];
+
+/** This thread's buffer, created with the first zone */
+ThreadBuffer& threadBuffer ()
+{
+    static thread_local ThreadBuffer* tlsBuffer = nullptr;
+    if (!tlsBuffer) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.lock);
+        reg.buffers.emplace_back(new ThreadBuffer());
+        tlsBuffer = reg.buffers.back().get();
+        tlsBuffer->thread = std::uint16_t(reg.buffers.size() - 1);
+    }
+    return *tlsBuffer;
+}
+
+}
+
+void
+ImgProfiler::newFrame ()
+{
+    const std::uint32_t frame = gFrame.load(std::memory_order_relaxed) + 1;
+    gFrameStart[frame % FRAMES_KEPT].store(now(), std::memory_order_relaxed);
+    gFrame.store(frame, std::memory_order_release);
+}
+
+std::uint32_t
+ImgProfiler::currentFrame ()
+{
+    return gFrame.load(std::memory_order_acquire);
+}
+
+std::uint64_t
+ImgProfiler::frameStart (std::uint32_t frame)
+{
+    const std::uint32_t cur = currentFrame();
+    if (frame > cur || cur - frame >= FRAMES_KEPT)
+        return 0;
+    return gFrameStart[frame % FRAMES_KEPT].load(std::memory_order_relaxed);
+}
+
+std::uint16_t
+ImgProfiler::enter ()
+{
+    return threadBuffer().depth++;
+}
+
+void
+ImgProfiler::leave (const char* name, std::uint64_t startNs, std::uint16_t depth)
+{
+    const std::uint64_t endNs = now();
+    ThreadBuffer& buf = threadBuffer();
+    buf.depth = depth;
+
+    const std::uint64_t n = buf.written.load(std::memory_order_relaxed);
+    Event& ev = buf.events[n % EVENTS_PER_THREAD];
+    ev.name     = name;
+    ev.startNs  = startNs;
+    ev.endNs    = endNs;
+    ev.frame    = gFrame.load(std::memory_order_relaxed);
+    ev.depth    = depth;
+    ev.thread   = buf.thread;
+    buf.written.store(n + 1, std::memory_order_release);
+}
+
+void
+ImgProfiler::collect (std::uint32_t firstFrame, std::uint32_t lastFrame, std::vector<Event>& out)
+{
+    out.clear();
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (const std::unique_ptr<ThreadBuffer>& buf: reg.buffers) {
+        const std::uint64_t n = buf->written.load(std::memory_order_acquire);
+        const std::uint64_t first = n > EVENTS_PER_THREAD ? n - EVENTS_PER_THREAD : 0;
+        for (std::uint64_t i = first; i < n; i++) {
+            const Event& ev = buf->events[i % EVENTS_PER_THREAD];
+            if (ev.frame >= firstFrame && ev.frame <= lastFrame)
+                out.push_back(ev);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const Event& a, const Event& b)
+              { return a.startNs < b.startNs || (a.startNs == b.startNs && a.depth < b.depth); });
+}
+
+std::uint64_t
+ImgProfiler::drain (std::vector<std::uint64_t>& cursors, std::vector<Event>& out)
+{
+    std::uint64_t lost = 0;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    cursors.resize(reg.buffers.size(), 0);
+    for (size_t b = 0; b < reg.buffers.size(); b++) {
+        const ThreadBuffer& buf = *reg.buffers[b];
+        std::uint64_t& cursor = cursors[b];
+        const std::uint64_t n = buf.written.load(std::memory_order_acquire);
+        if (n - cursor > EVENTS_PER_THREAD) {
+            lost += n - EVENTS_PER_THREAD - cursor;
+            cursor = n - EVENTS_PER_THREAD;
+        }
+        const size_t outStart = out.size();
+        for (std::uint64_t i = cursor; i < n; i++)
+            out.push_back(buf.events[i % EVENTS_PER_THREAD]);
+
+        // The writing thread may have lapped us while copying:
+        // drop whatever might have been overwritten in the meantime
+        const std::uint64_t n2 = buf.written.load(std::memory_order_acquire);
+        if (n2 - cursor > EVENTS_PER_THREAD) {
+            const std::uint64_t garbled = std::min(n2 - EVENTS_PER_THREAD - cursor, n - cursor);
+            out.erase(out.begin() + std::ptrdiff_t(outStart),
+                      out.begin() + std::ptrdiff_t(outStart + garbled));
+            lost += garbled;
+        }
+        cursor = n;
+    }
+    return lost;
+}
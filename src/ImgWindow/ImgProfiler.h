@@ -0,0 +1,144 @@
+/*
+ * ImgProfiler.h
+ *
+ * Integration for dear imgui into X-Plane: Scoped-Zone CPU Profiler
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGPROFILER_H
+#define IMGPROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/** Is the profiler compiled in? (set by the FLIGHTMAX_PROFILING option in CMakeLists.txt) */
+#ifndef FLIGHTMAX_PROFILING
+#define FLIGHTMAX_PROFILING 0
+#endif
+
+#define IMG_PROFILE_CONCAT2(a,b)    a##b
+#define IMG_PROFILE_CONCAT(a,b)     IMG_PROFILE_CONCAT2(a,b)
+
+#if FLIGHTMAX_PROFILING
+/** Measure the rest of the enclosing scope as zone `name`, which must be a string literal
+ *  (or otherwise live forever, only the pointer is recorded) */
+#define IMG_PROFILE_ZONE(name)      ImgProfiler::Zone IMG_PROFILE_CONCAT(imgProfileZone_, __LINE__) (name)
+/** Measure the rest of the enclosing function */
+#define IMG_PROFILE_FUNCTION()      IMG_PROFILE_ZONE(__func__)
+/** Mark the beginning of a new sim frame */
+#define IMG_PROFILE_NEW_FRAME()     ImgProfiler::newFrame()
+#else
+#define IMG_PROFILE_ZONE(name)      do {} while (0)
+#define IMG_PROFILE_FUNCTION()      do {} while (0)
+#define IMG_PROFILE_NEW_FRAME()     do {} while (0)
+#endif
+
+/** ImgProfiler collects timings of scoped zones.
+ *
+ * A zone is a named scope, measured from construction to destruction of
+ * an ImgProfiler::Zone object, usually declared via IMG_PROFILE_ZONE().
+ * Each thread writes its zones into a ring buffer of its own, so recording
+ * requires no locking.  Zones are tagged with the frame number of the last
+ * IMG_PROFILE_NEW_FRAME() call and with their nesting depth, which is all
+ * a flame chart needs.
+ *
+ * With FLIGHTMAX_PROFILING set to 0 all macros compile to nothing and
+ * the class records nothing.
+ */
+class ImgProfiler {
+public:
+    /** Number of zones kept per thread */
+    static constexpr size_t     EVENTS_PER_THREAD   = 16384;
+    /** Number of frames whose start time is kept */
+    static constexpr unsigned   FRAMES_KEPT         = 256;
+
+    /** One measured zone */
+    struct Event {
+        const char*     name    = nullptr;  ///< zone name as passed to the Zone object
+        std::uint64_t   startNs = 0;        ///< start, see now()
+        std::uint64_t   endNs   = 0;        ///< end, see now()
+        std::uint32_t   frame   = 0;        ///< frame number when the zone ended
+        std::uint16_t   depth   = 0;        ///< nesting level within the thread, 0 = outermost
+        std::uint16_t   thread  = 0;        ///< profiler's number of the recording thread, 0 = first thread seen
+    };
+
+    /** RAII zone: measures from construction to destruction */
+    class Zone {
+    public:
+        explicit Zone (const char* name) :
+        mName(name), mDepth(enter()), mStart(now()) {}
+        ~Zone () { leave(mName, mStart, mDepth); }
+
+        Zone (const Zone&) = delete;
+        Zone& operator = (const Zone&) = delete;
+    private:
+        const char*     mName;
+        std::uint16_t   mDepth;
+        std::uint64_t   mStart;
+    };
+
+    /** Is the profiler compiled in? */
+    static constexpr bool isEnabled () { return FLIGHTMAX_PROFILING != 0; }
+
+    /** Monotonic clock in nanoseconds */
+    static std::uint64_t now ()
+    {
+        return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>
+                             (std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /** Start a new frame */
+    static void newFrame ();
+
+    /** Current frame number */
+    static std::uint32_t currentFrame ();
+
+    /** Start time of a frame (0 if not known (any longer)) */
+    static std::uint64_t frameStart (std::uint32_t frame);
+
+    /** Copy all zones of frames [firstFrame, lastFrame] from all threads, sorted by start time */
+    static void collect (std::uint32_t firstFrame, std::uint32_t lastFrame, std::vector<Event>& out);
+
+    /** Append all zones recorded since the last call to `out` (unsorted)
+     *
+     * `cursors` holds the read position per thread buffer and is to be kept
+     * by the caller between calls, start with an empty vector.
+     * @return Number of zones lost because they had been overwritten before being read */
+    static std::uint64_t drain (std::vector<std::uint64_t>& cursors, std::vector<Event>& out);
+
+private:
+    /** Zone starts: returns nesting depth */
+    static std::uint16_t enter ();
+    /** Zone ends: record it */
+    static void leave (const char* name, std::uint64_t startNs, std::uint16_t depth);
+};
+
+#endif // IMGPROFILER_H
@@ -0,0 +1,304 @@
+/*
+ * ImgRenderState.cpp
+ *
+ * Integration for dear imgui into X-Plane: Shared GL Render State
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgRenderState.h"
+#include "XOGLUtils.h"
+
+#include <XPLMDataAccess.h>
+#include <XPLMGraphics.h>
+#include <XPLMProcessing.h>
+#include <XPLMUtilities.h>
+
+#include <cstring>
+#include <string>
+
+static XPLMDataRef		gModelviewMatrixRef		= nullptr;
+static XPLMDataRef		gViewportRef			= nullptr;
+static XPLMDataRef		gProjectionMatrixRef	= nullptr;
+
+/** Fragment program for distance field text
+ *
+ * The atlas stores 0.5 on the glyph outline, rising inside and falling
+ * outside. fwidth() tells how much that changes from one screen pixel to
+ * the next, so the edge is smoothed over about one pixel at any scale.
+ * Vertex processing stays fixed function. */
+static const char *SDF_FRAGMENT_SHADER =
+    "#version 120\n"
+    "uniform sampler2D tex;\n"
+    "void main()\n"
+    "{\n"
+    "    float dist  = texture2D(tex, gl_TexCoord[0].st).a;\n"
+    "    float width = max(0.7 * fwidth(dist), 1.0 / 255.0);\n"
+    "    float alpha = smoothstep(0.5 - width, 0.5 + width, dist);\n"
+    "    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * alpha);\n"
+    "}\n";
+
+ImgRenderState&
+ImgRenderState::get()
+{
+    static ImgRenderState theState;
+    return theState;
+}
+
+void
+ImgRenderState::setEnabled(GLenum cap, GLboolean bCurrent, bool bWanted)
+{
+    if ((bCurrent == GL_TRUE) == bWanted) {
+        mStats.stateChangesAvoided++;
+        return;
+    }
+    if (bWanted)
+        glEnable(cap);
+    else
+        glDisable(cap);
+    mStats.stateChanges++;
+}
+
+void
+ImgRenderState::setClientState(GLenum array, GLboolean bCurrent, bool bWanted)
+{
+    if ((bCurrent == GL_TRUE) == bWanted) {
+        mStats.stateChangesAvoided++;
+        return;
+    }
+    if (bWanted)
+        glEnableClientState(array);
+    else
+        glDisableClientState(array);
+    mStats.stateChanges++;
+}
+
+void
+ImgRenderState::newPass()
+{
+    const int cycle = XPLMGetCycleNumber();
+    if (cycle != mPassCycle) {
+        mPassCycle      = cycle;
+        mMatricesValid  = false;
+        mStats.drawPasses++;
+    }
+}
+
+void
+ImgRenderState::beginWindow()
+{
+    mStats.windowsRendered++;
+    newPass();
+
+    // Record what X-Plane handed over. That's needed for each window:
+    // X-Plane draws window decorations and other plugins draw their windows
+    // in between, so nothing is known from the window before.
+    mBaseline.cullFace      = glIsEnabled(GL_CULL_FACE);
+    mBaseline.scissorTest   = glIsEnabled(GL_SCISSOR_TEST);
+    glGetIntegerv(GL_MATRIX_MODE, &mBaseline.matrixMode);
+    glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &mBaseline.texEnvMode);
+
+    // Array enables, pointers and buffer bindings go back as X-Plane had them
+    // with one pop, the server side state is restored individually instead of glPushAttrib
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    mStats.attribPushesAvoided++;
+
+    // 1TU + Alpha settings, no depth, no fog.
+    // (X-Plane caches this state itself, so we always hand it over.)
+    XPLMSetGraphicsState(0, 1, 0, 1, 1, 0, 0);
+    setEnabled(GL_CULL_FACE, mBaseline.cullFace, false);
+    setEnabled(GL_SCISSOR_TEST, mBaseline.scissorTest, true);
+    setClientState(GL_VERTEX_ARRAY, glIsEnabled(GL_VERTEX_ARRAY), true);
+    setClientState(GL_TEXTURE_COORD_ARRAY, glIsEnabled(GL_TEXTURE_COORD_ARRAY), true);
+    setClientState(GL_COLOR_ARRAY, glIsEnabled(GL_COLOR_ARRAY), true);
+    setClientState(GL_NORMAL_ARRAY, glIsEnabled(GL_NORMAL_ARRAY), false);
+    // vertex color times texture, which also makes alpha-only textures (compact font atlas) work
+    if (mBaseline.texEnvMode != GL_MODULATE) {
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        mStats.stateChanges++;
+    }
+
+    // X-Plane may have bound anything since the last window
+    mBoundTexture = -1;
+    mSdfTexture = -1;
+}
+
+void
+ImgRenderState::endWindow()
+{
+    // undo only what beginWindow() actually changed
+    setEnabled(GL_CULL_FACE, GL_FALSE, mBaseline.cullFace == GL_TRUE);
+    setEnabled(GL_SCISSOR_TEST, GL_TRUE, mBaseline.scissorTest == GL_TRUE);
+    glPopClientAttrib();
+    if (mBaseline.texEnvMode != GL_MODULATE)
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, mBaseline.texEnvMode);
+    // rendering switches to the projection matrix
+    if (mBaseline.matrixMode != GL_PROJECTION)
+        glMatrixMode(static_cast<GLenum>(mBaseline.matrixMode));
+    useDistanceField(false);
+    mBoundTexture = -1;
+    mSdfTexture = -1;
+}
+
+void
+ImgRenderState::beginCacheQuad()
+{
+    mStats.windowsRendered++;
+    newPass();
+
+    // 1TU + Alpha, blending premultiplied colors, X-Plane's blend function goes back afterwards
+    XPLMSetGraphicsState(0, 1, 0, 1, 1, 0, 0);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &mBaseline.blendSrcRGB);
+    glGetIntegerv(GL_BLEND_DST_RGB, &mBaseline.blendDstRGB);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &mBaseline.blendSrcAlpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &mBaseline.blendDstAlpha);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    mStats.stateChanges++;
+
+    // X-Plane may have bound anything since the last window
+    mBoundTexture = -1;
+    mSdfTexture = -1;
+}
+
+void
+ImgRenderState::endCacheQuad()
+{
+    // (render caches need render-to-texture support, which includes glBlendFuncSeparate)
+    glBlendFuncSeparate(static_cast<GLenum>(mBaseline.blendSrcRGB), static_cast<GLenum>(mBaseline.blendDstRGB),
+                        static_cast<GLenum>(mBaseline.blendSrcAlpha), static_cast<GLenum>(mBaseline.blendDstAlpha));
+    mStats.stateChanges++;
+    mBoundTexture = -1;
+}
+
+void
+ImgRenderState::getViewMatrices(bool bSharedView, float outModelView[16], float outProjection[16], int outViewport[4])
+{
+    newPass();
+    if (bSharedView && mMatricesValid) {
+        mStats.matrixFetchesAvoided++;
+    } else {
+        if (!gModelviewMatrixRef) {
+            gModelviewMatrixRef = XPLMFindDataRef("sim/graphics/view/modelview_matrix");
+            gViewportRef = XPLMFindDataRef("sim/graphics/view/viewport");
+            gProjectionMatrixRef = XPLMFindDataRef("sim/graphics/view/projection_matrix");
+        }
+        // Get the current modelview matrix, viewport, and projection matrix from X-Plane
+        XPLMGetDatavf(gModelviewMatrixRef, mModelView, 0, 16);
+        XPLMGetDatavf(gProjectionMatrixRef, mProjection, 0, 16);
+        XPLMGetDatavi(gViewportRef, mViewport, 0, 4);
+        mMatricesValid = bSharedView;
+        mStats.matrixFetches++;
+    }
+    std::memcpy(outModelView, mModelView, sizeof(mModelView));
+    std::memcpy(outProjection, mProjection, sizeof(mProjection));
+    std::memcpy(outViewport, mViewport, sizeof(mViewport));
+}
+
+void
+ImgRenderState::bindTexture(int inTexNum)
+{
+    useDistanceField(inTexNum == mSdfTexture);
+    if (inTexNum == mBoundTexture) {
+        mStats.textureBindsAvoided++;
+        return;
+    }
+    XPLMBindTexture2d(inTexNum, 0);
+    mBoundTexture = inTexNum;
+    mStats.textureBinds++;
+}
+
+void
+ImgRenderState::setDistanceFieldTexture(int inTexNum)
+{
+    mSdfTexture = inTexNum;
+    if (mBoundTexture >= 0)
+        useDistanceField(mBoundTexture == mSdfTexture);
+}
+
+void
+ImgRenderState::useDistanceField(bool bWanted)
+{
+    if (bWanted == mSdfActive)
+        return;
+    if (bWanted && !mSdfProgram && !createDistanceFieldProgram())
+        return;
+    // X-Plane hands over the fixed function pipeline, so that's what we go back to
+    glUseProgram(bWanted ? mSdfProgram : 0);
+    mSdfActive = bWanted;
+    mStats.programSwitches++;
+}
+
+bool
+ImgRenderState::createDistanceFieldProgram()
+{
+    if (mSdfFailed)
+        return false;
+    mSdfFailed = true;                          // unless we get through
+    if (!OGL_HasShaders())
+        return false;
+
+    GLint ok = GL_FALSE;
+    char log[512] = "";
+    const GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(shader, 1, &SDF_FRAGMENT_SHADER, nullptr);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        glDeleteShader(shader);
+        XPLMDebugString((std::string("ImgWindow: Distance field shader failed to compile: ") + log + "\n").c_str());
+        return false;
+    }
+
+    mSdfProgram = glCreateProgram();
+    glAttachShader(mSdfProgram, shader);
+    glLinkProgram(mSdfProgram);
+    glDeleteShader(shader);                     // goes with the program
+    glGetProgramiv(mSdfProgram, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(mSdfProgram);
+        mSdfProgram = 0;
+        XPLMDebugString("ImgWindow: Distance field shader failed to link\n");
+        return false;
+    }
+    // the sampler uniform defaults to texture unit 0, where our textures go
+    mSdfFailed = false;
+    return true;
+}
+
+void
+ImgRenderState::releaseGL()
+{
+    if (mSdfProgram) {
+        glDeleteProgram(mSdfProgram);
+        mSdfProgram = 0;
+    }
+    mSdfActive = false;
+    mSdfFailed = false;
+}
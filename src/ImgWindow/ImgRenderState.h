@@ -0,0 +1,160 @@
+/*
+ * ImgRenderState.h
+ *
+ * Integration for dear imgui into X-Plane: Shared GL Render State
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGRENDERSTATE_H
+#define IMGRENDERSTATE_H
+
+#include "SystemGL.h"
+
+/** ImgRenderState tracks the GL state ImgWindow rendering needs across all
+ * windows drawn during one X-Plane draw pass.
+ *
+ * Instead of blindly saving and restoring all GL attributes around each
+ * window, the few enables ImgWindow touches are read when a window begins
+ * (X-Plane and other plugins draw in between our windows, so that's needed
+ * each time).  The window then only changes what actually differs and
+ * restores exactly that afterwards, only the client vertex arrays are
+ * pushed and popped as a whole.  Texture binds are cached within a window,
+ * the view matrices read from X-Plane's datarefs within a draw pass.
+ *
+ * Windows outside the sim's main view (popped out or in VR) have their own
+ * view, so for them the matrices are not shared.
+ */
+class ImgRenderState {
+public:
+    /** Counters of state changes done vs. avoided */
+    struct Stats {
+        unsigned long   windowsRendered     = 0;    ///< number of beginWindow() calls
+        unsigned long   drawPasses          = 0;    ///< number of distinct draw passes seen
+        unsigned long   attribPushesAvoided = 0;    ///< glPushAttrib/glPopAttrib calls no longer done
+        unsigned long   stateChanges        = 0;    ///< enable/disable calls actually done
+        unsigned long   stateChangesAvoided = 0;    ///< enable/disable calls skipped because the state was already right
+        unsigned long   textureBinds        = 0;    ///< XPLMBindTexture2d calls done
+        unsigned long   textureBindsAvoided = 0;    ///< XPLMBindTexture2d calls skipped, texture already bound
+        unsigned long   programSwitches     = 0;    ///< glUseProgram calls for distance field text
+        unsigned long   matrixFetches       = 0;    ///< view matrices read from datarefs
+        unsigned long   matrixFetchesAvoided= 0;    ///< view matrices taken from cache
+
+        /** Sum of all avoided state changes */
+        unsigned long totalAvoided () const
+        { return attribPushesAvoided + stateChangesAvoided + textureBindsAvoided + matrixFetchesAvoided; }
+    };
+
+    /** The one instance shared by all windows */
+    static ImgRenderState& get();
+
+    /** Set up the state for rendering one window's ImGui draw data */
+    void beginWindow();
+
+    /** Restore the state X-Plane had handed to us before beginWindow() */
+    void endWindow();
+
+    /** Set up the state for drawing a window's render cache as one textured
+     * quad, the cache texture holds colors premultiplied by alpha */
+    void beginCacheQuad();
+
+    /** Restore the state X-Plane had handed to us before beginCacheQuad() */
+    void endCacheQuad();
+
+    /** Get the view matrices and viewport, read from X-Plane only once per
+     * draw pass for windows in the shared view
+     * @param bSharedView Is the window inside the sim's main view? */
+    void getViewMatrices(bool bSharedView, float outModelView[16], float outProjection[16], int outViewport[4]);
+
+    /** Bind a texture to unit 0 unless it is bound already */
+    void bindTexture(int inTexNum);
+
+    /** Forget about the bound texture, e.g. after someone else bound one */
+    void invalidateTexture() { mBoundTexture = -1; }
+
+    /** Treat `inTexNum` as signed distance field font atlas
+     *
+     * While it is bound, a fragment program finds the glyph outlines in it
+     * and anti-aliases them over one screen pixel, whatever the scale.
+     * Set after beginWindow(), -1 (the default) if the window has none.
+     * Without shader support the texture is drawn like any other. */
+    void setDistanceFieldTexture(int inTexNum);
+
+    /** Free the GL objects we created, once no window is left */
+    void releaseGL();
+
+    /** Current counters */
+    const Stats& getStats() const { return mStats; }
+
+    /** Reset all counters to zero */
+    void resetStats() { mStats = Stats(); }
+
+private:
+    ImgRenderState() = default;
+
+    /** The state X-Plane handed over before the current window */
+    struct Baseline {
+        GLboolean   cullFace        = GL_FALSE;
+        GLboolean   scissorTest     = GL_FALSE;
+        GLint       matrixMode      = GL_MODELVIEW;
+        GLint       texEnvMode      = GL_MODULATE;
+        GLint       blendSrcRGB     = GL_SRC_ALPHA;     ///< only read by beginCacheQuad()
+        GLint       blendDstRGB     = GL_ONE_MINUS_SRC_ALPHA;
+        GLint       blendSrcAlpha   = GL_SRC_ALPHA;
+        GLint       blendDstAlpha   = GL_ONE_MINUS_SRC_ALPHA;
+    };
+
+    /** Forget the matrices if X-Plane started a new draw pass */
+    void newPass();
+
+    /** Set capability `cap` to `bWanted` if it isn't already */
+    void setEnabled(GLenum cap, GLboolean bCurrent, bool bWanted);
+    void setClientState(GLenum array, GLboolean bCurrent, bool bWanted);
+
+    /** Switch the distance field program on or off if it isn't already */
+    void useDistanceField(bool bWanted);
+    /** Compile and link the distance field program on first use */
+    bool createDistanceFieldProgram();
+
+    Stats       mStats;
+    Baseline    mBaseline;
+    int         mPassCycle      = -1;       ///< X-Plane cycle of the current draw pass
+    bool        mMatricesValid  = false;    ///< cached matrices valid for the shared view in this pass?
+    int         mBoundTexture   = -1;       ///< texture bound by us, -1 if unknown
+    int         mSdfTexture     = -1;       ///< distance field atlas of the current window, -1 if none
+    bool        mSdfActive      = false;    ///< distance field program in use?
+    bool        mSdfFailed      = false;    ///< program couldn't be created, don't try again
+    GLuint      mSdfProgram     = 0;
+
+    float       mModelView[16];
+    float       mProjection[16];
+    int         mViewport[4];
+};
+
+#endif // IMGRENDERSTATE_H
@@ -0,0 +1,346 @@
+/*
+ * ImgTextureData.cpp
+ *
+ * Integration for dear imgui into X-Plane: Mipmapped and Compressed Texture Data
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgTextureData.h"
+#include "XOGLUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+/** Bump whenever the layout of the cache file or the encoding changes */
+constexpr std::uint32_t CACHE_VERSION = 1;
+constexpr char          CACHE_MAGIC[8] = { 'I', 'M', 'G', 'T', 'E', 'X', 'C', '\0' };
+
+/** Cache file header, all numbers in native byte order, followed by the levels and their data */
+struct CacheHeader {
+    char            magic[8];
+    std::uint32_t   version;
+    std::uint32_t   headerSize;
+    std::uint64_t   key;
+    std::int32_t    internalFormat;
+    std::uint32_t   numLevels;
+    std::uint64_t   dataBytes;
+};
+
+/** Per level */
+struct CacheLevel {
+    std::int32_t    width, height;
+    std::uint64_t   offset, bytes;
+};
+
+/** Size of a level in S3TC blocks */
+size_t blockBytes (int width, int height, GLint internalFormat)
+{
+    const size_t blocks = size_t((width + 3) / 4) * size_t((height + 3) / 4);
+    return blocks * (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16);
+}
+
+/** Half the size, averaging 2x2 texels, colors weighted by their alpha */
+void downsample (const unsigned char *src, int width, int height, unsigned char *dst, int dstWidth, int dstHeight)
+{
+    for (int y = 0; y < dstHeight; y++) {
+        const int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < dstWidth; x++) {
+            const int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            const unsigned char *p[4] = {
+                src + (size_t(y0) * size_t(width) + size_t(x0)) * 4, src + (size_t(y0) * size_t(width) + size_t(x1)) * 4,
+                src + (size_t(y1) * size_t(width) + size_t(x0)) * 4, src + (size_t(y1) * size_t(width) + size_t(x1)) * 4,
+            };
+            unsigned sumA = 0, sumC[3] = { 0, 0, 0 }, plainC[3] = { 0, 0, 0 };
+            for (const unsigned char *t: p) {
+                sumA += t[3];
+                for (int c = 0; c < 3; c++) {
+                    sumC[c]   += unsigned(t[c]) * t[3];
+                    plainC[c] += t[c];
+                }
+            }
+            unsigned char *d = dst + (size_t(y) * size_t(dstWidth) + size_t(x)) * 4;
+            for (int c = 0; c < 3; c++)
+                d[c] = (unsigned char)(sumA ? (sumC[c] + sumA / 2) / sumA : (plainC[c] + 2) / 4);
+            d[3] = (unsigned char)((sumA + 2) / 4);
+        }
+    }
+}
+
+unsigned to565 (const int c[3])
+{
+    return unsigned((c[0] * 31 + 127) / 255) << 11 | unsigned((c[1] * 63 + 127) / 255) << 5 | unsigned((c[2] * 31 + 127) / 255);
+}
+
+void from565 (unsigned v, int c[3])
+{
+    const int r = int(v >> 11) & 31, g = int(v >> 5) & 63, b = int(v) & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+/** Color part of a BC1/BC3 block: the two endpoints span the block's
+ * bounding box, along the diagonal the colors actually vary on */
+void encodeColorBlock (const unsigned char block[64], unsigned char out[8])
+{
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], int(block[4 * i + c]));
+            hi[c] = std::max(hi[c], int(block[4 * i + c]));
+        }
+
+    // Channels falling while the widest one rises swap their ends
+    int widest = 0;
+    for (int c = 1; c < 3; c++)
+        if (hi[c] - lo[c] > hi[widest] - lo[widest])
+            widest = c;
+    for (int c = 0; c < 3; c++) {
+        if (c == widest)
+            continue;
+        long cov = 0;
+        for (int i = 0; i < 16; i++)
+            cov += long(2 * block[4 * i + widest] - lo[widest] - hi[widest]) * long(2 * block[4 * i + c] - lo[c] - hi[c]);
+        if (cov < 0)
+            std::swap(lo[c], hi[c]);
+    }
+
+    // Inset by 1/16 of the range, the interpolated colors are closer to the bulk of the texels
+    for (int c = 0; c < 3; c++) {
+        const int inset = (hi[c] - lo[c]) / 16;
+        hi[c] -= inset;
+        lo[c] += inset;
+    }
+
+    unsigned c0 = to565(hi), c1 = to565(lo);
+    if (c0 < c1)
+        std::swap(c0, c1);                      // c0 > c1 selects the four color mode
+    int palette[4][3];
+    from565(c0, palette[0]);
+    from565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+
+    std::uint32_t indices = 0;
+    if (c0 != c1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestErr = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int err = 0;
+                for (int c = 0; c < 3; c++) {
+                    const int d = int(block[4 * i + c]) - palette[p][c];
+                    err += d * d;
+                }
+                if (err < bestErr) {
+                    bestErr = err;
+                    best = p;
+                }
+            }
+            indices |= std::uint32_t(best) << (2 * i);
+        }
+    }
+    out[0] = (unsigned char)(c0 & 0xff);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xff);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int b = 0; b < 4; b++)
+        out[4 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+/** Alpha part of a BC3 block: eight steps between the block's extremes */
+void encodeAlphaBlock (const unsigned char block[64], unsigned char out[8])
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = std::min(lo, int(block[4 * i + 3]));
+        hi = std::max(hi, int(block[4 * i + 3]));
+    }
+    int palette[8] = { hi, lo };
+    for (int p = 1; p < 7; p++)
+        palette[p + 1] = ((7 - p) * hi + p * lo + 3) / 7;
+
+    std::uint64_t indices = 0;
+    if (hi != lo) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestErr = 256;
+            for (int p = 0; p < 8; p++) {
+                const int err = std::abs(int(block[4 * i + 3]) - palette[p]);
+                if (err < bestErr) {
+                    bestErr = err;
+                    best = p;
+                }
+            }
+            indices |= std::uint64_t(best) << (3 * i);
+        }
+    }
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+/** Compress one level, edge blocks repeat the last row/column */
+void compressLevel (const unsigned char *rgba, int width, int height, bool bAlpha, unsigned char *out)
+{
+    unsigned char block[64];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            for (int i = 0; i < 16; i++) {
+                const int x = std::min(bx + (i & 3), width - 1);
+                const int y = std::min(by + (i >> 2), height - 1);
+                std::memcpy(block + 4 * i, rgba + (size_t(y) * size_t(width) + size_t(x)) * 4, 4);
+            }
+            if (bAlpha) {
+                encodeAlphaBlock(block, out);
+                out += 8;
+            }
+            encodeColorBlock(block, out);
+            out += 8;
+        }
+    }
+}
+
+}
+
+std::shared_ptr<ImgTextureData>
+ImgTextureData::fromRGBA(const unsigned char *rgba, int width, int height, bool bMipmaps, bool bCompress)
+{
+    std::shared_ptr<ImgTextureData> tex = std::make_shared<ImgTextureData>();
+    if (!rgba || width <= 0 || height <= 0)
+        return tex;
+
+    bool bAlpha = false;
+    for (size_t i = 0, n = size_t(width) * size_t(height); i < n && !bAlpha; i++)
+        bAlpha = rgba[4 * i + 3] != 255;
+    tex->mInternalFormat = !bCompress ? GL_RGBA :
+                           bAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    // Level by level, each one made from the previous one
+    std::vector<unsigned char> level(rgba, rgba + size_t(width) * size_t(height) * 4), next;
+    int w = width, h = height;
+    for (;;) {
+        Level lvl;
+        lvl.width   = w;
+        lvl.height  = h;
+        lvl.offset  = tex->mData.size();
+        lvl.bytes   = bCompress ? blockBytes(w, h, tex->mInternalFormat) : level.size();
+        tex->mData.resize(lvl.offset + lvl.bytes);
+        if (bCompress)
+            compressLevel(level.data(), w, h, bAlpha, tex->mData.data() + lvl.offset);
+        else
+            std::memcpy(tex->mData.data() + lvl.offset, level.data(), lvl.bytes);
+        tex->mLevels.push_back(lvl);
+
+        if (!bMipmaps || (w == 1 && h == 1))
+            break;
+        const int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+        next.resize(size_t(nw) * size_t(nh) * 4);
+        downsample(level.data(), w, h, next.data(), nw, nh);
+        level.swap(next);
+        w = nw;
+        h = nh;
+    }
+    return tex;
+}
+
+std::shared_ptr<ImgTextureData>
+ImgTextureData::load(const std::string &path, std::uint64_t key)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        return nullptr;
+
+    std::shared_ptr<ImgTextureData> tex;
+    CacheHeader hdr;
+    if (std::fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+        std::memcmp(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+        hdr.version == CACHE_VERSION && hdr.headerSize == sizeof(CacheHeader) &&
+        hdr.key == key && hdr.numLevels > 0 && hdr.numLevels <= 32)
+    {
+        std::vector<CacheLevel> levels(hdr.numLevels);
+        bool bOK = std::fread(levels.data(), sizeof(CacheLevel), levels.size(), f) == levels.size();
+        for (const CacheLevel &cl: levels)
+            bOK = bOK && cl.width > 0 && cl.height > 0 && cl.offset + cl.bytes <= hdr.dataBytes;
+        if (bOK) {
+            tex = std::make_shared<ImgTextureData>();
+            tex->mInternalFormat = GLint(hdr.internalFormat);
+            for (const CacheLevel &cl: levels) {
+                Level lvl;
+                lvl.width   = cl.width;
+                lvl.height  = cl.height;
+                lvl.offset  = size_t(cl.offset);
+                lvl.bytes   = size_t(cl.bytes);
+                tex->mLevels.push_back(lvl);
+            }
+            tex->mData.resize(size_t(hdr.dataBytes));
+            if (std::fread(tex->mData.data(), 1, tex->mData.size(), f) != tex->mData.size())
+                tex.reset();
+        }
+    }
+    std::fclose(f);
+    return tex;
+}
+
+bool
+ImgTextureData::save(const std::string &path, std::uint64_t key) const
+{
+    CacheHeader hdr {};
+    std::memcpy(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    hdr.version         = CACHE_VERSION;
+    hdr.headerSize      = sizeof(CacheHeader);
+    hdr.key             = key;
+    hdr.internalFormat  = std::int32_t(mInternalFormat);
+    hdr.numLevels       = std::uint32_t(mLevels.size());
+    hdr.dataBytes       = mData.size();
+    std::vector<CacheLevel> levels;
+    for (const Level &lvl: mLevels)
+        levels.push_back({ lvl.width, lvl.height, lvl.offset, lvl.bytes });
+
+    // Write to a temporary file first so that a concurrent reader never sees half a file
+    const std::string tmpFile = path + ".tmp";
+    std::FILE *f = std::fopen(tmpFile.c_str(), "wb");
+    if (!f)
+        return false;
+    const bool bOK =
+        std::fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+        std::fwrite(levels.data(), sizeof(CacheLevel), levels.size(), f) == levels.size() &&
+        std::fwrite(mData.data(), 1, mData.size(), f) == mData.size();
+    if (std::fclose(f) != 0 || !bOK) {
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+    std::remove(path.c_str());                  // Windows' rename doesn't replace
+    return std::rename(tmpFile.c_str(), path.c_str()) == 0;
+}
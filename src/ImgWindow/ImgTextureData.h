@@ -0,0 +1,104 @@
+/*
+ * ImgTextureData.h
+ *
+ * Integration for dear imgui into X-Plane: Mipmapped and Compressed Texture Data
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGTEXTUREDATA_H
+#define IMGTEXTUREDATA_H
+
+#include "SystemGL.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** ImgTextureData holds all mip levels of a texture, ready for upload
+ *
+ * fromRGBA() derives the mip chain from decoded pixels by averaging 2x2
+ * texels per level, and can compress all levels to S3TC blocks: BC1
+ * (DXT1, half a byte per texel) for opaque images, BC3 (DXT5, one byte
+ * per texel) if there is alpha. Together with the mip levels that is
+ * about a sixth or a third of the uncompressed RGBA image, and scaled-down
+ * images no longer alias.
+ *
+ * Deriving the data takes a while for large images, so save() keeps it in
+ * a cache file and load() reads it back, as long as the key matches. No
+ * OpenGL involved, so all of this may run on a worker thread.
+ */
+class ImgTextureData {
+public:
+    /** One mip level within data() */
+    struct Level {
+        int     width   = 0;
+        int     height  = 0;
+        size_t  offset  = 0;
+        size_t  bytes   = 0;
+    };
+
+    /** Mip chain of the `width` x `height` RGBA pixels `rgba`
+     * @param bMipmaps Derive all mip levels down to 1x1, otherwise just level 0
+     * @param bCompress Compress to BC1 or BC3 */
+    static std::shared_ptr<ImgTextureData> fromRGBA(const unsigned char *rgba, int width, int height,
+                                                    bool bMipmaps, bool bCompress);
+
+    /** Read a cache file written by save()
+     * @return `nullptr` if there is none for `key` */
+    static std::shared_ptr<ImgTextureData> load(const std::string &path, std::uint64_t key);
+
+    /** Write to a cache file, identified by `key` (e.g. a hash over the source file) */
+    bool save(const std::string &path, std::uint64_t key) const;
+
+    /** GL_RGBA, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT */
+    GLint getInternalFormat() const { return mInternalFormat; }
+
+    /** Is it S3TC compressed? */
+    bool isCompressed() const { return mInternalFormat != GL_RGBA; }
+
+    const std::vector<Level> &getLevels() const { return mLevels; }
+
+    /** Pixels or blocks of all levels */
+    const unsigned char *data() const { return mData.data(); }
+
+    /** Size of all levels */
+    size_t getBytes() const { return mData.size(); }
+
+    int getWidth() const { return mLevels.empty() ? 0 : mLevels[0].width; }
+    int getHeight() const { return mLevels.empty() ? 0 : mLevels[0].height; }
+
+private:
+    GLint                       mInternalFormat = GL_RGBA;
+    std::vector<Level>          mLevels;
+    std::vector<unsigned char>  mData;
+};
+
+#endif //IMGTEXTUREDATA_H
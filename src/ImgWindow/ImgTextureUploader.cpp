@@ -0,0 +1,225 @@
+/*
+ * ImgTextureUploader.cpp
+ *
+ * Integration for dear imgui into X-Plane: Incremental Texture Uploads
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgTextureUploader.h"
+#include "ImgTextureData.h"
+#include "ImgProfiler.h"
+#include "XOGLUtils.h"
+
+#include <XPLMGraphics.h>
+#include <XPLMProcessing.h>
+
+#include <algorithm>
+
+ImgTextureUploader&
+ImgTextureUploader::get()
+{
+    static ImgTextureUploader theUploader;
+    return theUploader;
+}
+
+void
+ImgTextureUploader::upload(int texNum, GLint internalFormat, int width, int height, GLenum format,
+                           std::shared_ptr<const void> pixels, ProgressFunc onProgress)
+{
+    // A texture gets new pixels: the old ones needn't go up anymore
+    cancel(texNum);
+
+    Job job;
+    job.texNum          = texNum;
+    job.internalFormat  = internalFormat;
+    job.format          = format;
+    JobLevel lvl;
+    lvl.width           = width;
+    lvl.height          = height;
+    lvl.unitBytes       = size_t(width) * (format == GL_ALPHA ? 1 : 4);
+    lvl.numUnits        = height;
+    job.levels.push_back(lvl);
+    job.totalBytes      = lvl.unitBytes * size_t(height);
+    job.pixels          = std::move(pixels);
+    job.onProgress      = std::move(onProgress);
+    mJobs.push_back(std::move(job));
+    mStats.jobs++;
+}
+
+void
+ImgTextureUploader::upload(int texNum, std::shared_ptr<const ImgTextureData> data, ProgressFunc onProgress)
+{
+    cancel(texNum);
+
+    Job job;
+    job.texNum          = texNum;
+    job.internalFormat  = data->getInternalFormat();
+    job.format          = GL_RGBA;
+    job.bCompressed     = data->isCompressed();
+    for (const ImgTextureData::Level &dataLvl: data->getLevels()) {
+        JobLevel lvl;
+        lvl.width       = dataLvl.width;
+        lvl.height      = dataLvl.height;
+        lvl.offset      = dataLvl.offset;
+        lvl.numUnits    = job.bCompressed ? (dataLvl.height + 3) / 4 : dataLvl.height;
+        lvl.unitBytes   = dataLvl.bytes / size_t(lvl.numUnits);
+        job.levels.push_back(lvl);
+        job.totalBytes += dataLvl.bytes;
+    }
+    // Shares ownership of `data`, points to its pixels
+    const unsigned char *pixels = data->data();
+    job.pixels          = std::shared_ptr<const void>(std::move(data), pixels);
+    job.onProgress      = std::move(onProgress);
+    mJobs.push_back(std::move(job));
+    mStats.jobs++;
+}
+
+void
+ImgTextureUploader::cancel(int texNum)
+{
+    mJobs.erase(std::remove_if(mJobs.begin(), mJobs.end(),
+                               [texNum](const Job &job) { return job.texNum == texNum; }),
+                mJobs.end());
+}
+
+void
+ImgTextureUploader::processFrame()
+{
+    // Once per frame, however many windows call
+    const int cycle = XPLMGetCycleNumber();
+    if (cycle == mCycle || mJobs.empty())
+        return;
+    mCycle = cycle;
+
+    IMG_PROFILE_ZONE("ImgTextureUploader::processFrame");
+    if (!mInitialised) {
+        OGL_UtilsInit();
+        mUsePBO = OGL_HasPixelBufferObjects();
+        if (mUsePBO)
+            glGenBuffers(1, &mPBO);
+        mInitialised = true;
+    }
+
+    size_t sent = 0;
+    while (!mJobs.empty()) {
+        Job &job = mJobs.front();
+        if (!job.bAllocated)
+            allocate(job);
+
+        // As many rows as the budget allows, but always one per frame
+        const JobLevel &lvl = job.levels[job.level];
+        const size_t left = mBudget > sent ? mBudget - sent : 0;
+        int units = int(std::min(left / lvl.unitBytes, size_t(lvl.numUnits - job.nextUnit)));
+        if (units == 0 && sent > 0)
+            break;
+        units = std::max(units, 1);
+        sendStrip(job, job.nextUnit, units);
+        job.nextUnit += units;
+        job.sentBytes += size_t(units) * lvl.unitBytes;
+        sent += size_t(units) * lvl.unitBytes;
+        if (job.nextUnit >= lvl.numUnits) {
+            job.level++;
+            job.nextUnit = 0;
+        }
+
+        // The callback may queue or cancel jobs, so first take this one off the queue if done
+        ProgressFunc onProgress = job.onProgress;
+        const bool bDone = job.level >= job.levels.size();
+        const float progress = bDone ? 1.0f : float(job.sentBytes) / float(job.totalBytes);
+        if (bDone)
+            mJobs.pop_front();
+        if (onProgress)
+            onProgress(progress);
+    }
+
+    mStats.framesBusy++;
+    mStats.bytesUploaded += sent;
+    mStats.maxFrameBytes = std::max(mStats.maxFrameBytes, sent);
+}
+
+void
+ImgTextureUploader::allocate(Job &job)
+{
+    // Storage only, cheap compared to filling it
+    const GLint numLevels = GLint(job.levels.size());
+    XPLMBindTexture2d(job.texNum, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    for (GLint i = 0; i < numLevels; i++)
+        glTexImage2D(GL_TEXTURE_2D, i, job.internalFormat, job.levels[size_t(i)].width, job.levels[size_t(i)].height, 0,
+                     job.format, GL_UNSIGNED_BYTE, nullptr);
+    job.bAllocated = true;
+}
+
+void
+ImgTextureUploader::sendStrip(Job &job, int unit, int numUnits)
+{
+    const JobLevel &lvl = job.levels[job.level];
+    const GLint level = GLint(job.level);
+    const size_t bytes = size_t(numUnits) * lvl.unitBytes;
+    const unsigned char *src = static_cast<const unsigned char *>(job.pixels.get()) +
+                               lvl.offset + size_t(unit) * lvl.unitBytes;
+    // Compressed units are 4 rows high, the last one may be cut off by the level's edge
+    const int rowsPerUnit = job.bCompressed ? 4 : 1;
+    const int row = unit * rowsPerUnit;
+    const int numRows = std::min(numUnits * rowsPerUnit, lvl.height - row);
+
+    XPLMBindTexture2d(job.texNum, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (mUsePBO) {
+        // Fresh storage for each strip, so this never waits for the GPU to finish reading the last one
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(bytes), src, GL_STREAM_DRAW);
+        src = nullptr;
+        mStats.stripsViaPBO++;
+    }
+    if (job.bCompressed)
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, row, lvl.width, numRows, GLenum(job.internalFormat),
+                                  static_cast<GLsizei>(bytes), src);
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, row, lvl.width, numRows, job.format, GL_UNSIGNED_BYTE, src);
+    // X-Plane doesn't expect a pixel buffer bound
+    if (mUsePBO)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    mStats.strips++;
+}
+
+void
+ImgTextureUploader::releaseGL()
+{
+    if (mPBO)
+        glDeleteBuffers(1, &mPBO);
+    mPBO = 0;
+    mInitialised = false;
+    mCycle = -1;
+}
@@ -0,0 +1,173 @@
+/*
+ * ImgTextureUploader.h
+ *
+ * Integration for dear imgui into X-Plane: Incremental Texture Uploads
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGTEXTUREUPLOADER_H
+#define IMGTEXTUREUPLOADER_H
+
+#include "SystemGL.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ImgTextureData;
+
+/** ImgTextureUploader spreads large texture uploads over several frames
+ *
+ * A single glTexImage2D of a big image stalls the driver for the whole
+ * copy, in one frame. Instead, upload() queues the pixels and
+ * processFrame() sends them in strips of rows with glTexSubImage2D, no
+ * more than the byte budget per frame. Each strip goes through a pixel
+ * buffer object, which is orphaned for every strip, so the driver can copy
+ * the data to the GPU while the GPU may still read the previous one.
+ * Without pixel buffer objects the strips are sent from client memory.
+ * Mipmapped and S3TC compressed textures (ImgTextureData) go up level by
+ * level, compressed ones in strips of whole 4x4 blocks.
+ *
+ * After each strip, the job's progress function is called with the part
+ * done so far, 1.0 once the texture is complete. Its owner uses that to
+ * update placeholders and knows when to start drawing the texture.
+ *
+ * Main thread only, all calls need a current GL context.
+ */
+class ImgTextureUploader {
+public:
+    /** Gets the part done, 0..1, called on the main thread */
+    typedef std::function<void(float progress)> ProgressFunc;
+
+    /** Counters since start */
+    struct Stats {
+        unsigned    jobs            = 0;    ///< textures queued
+        unsigned    strips          = 0;    ///< glTexSubImage2D/glCompressedTexSubImage2D calls
+        unsigned    stripsViaPBO    = 0;    ///< ...of which sourced from a pixel buffer object
+        unsigned    framesBusy      = 0;    ///< frames that had something to upload
+        size_t      bytesUploaded   = 0;    ///< pixel data sent
+        size_t      maxFrameBytes   = 0;    ///< most bytes sent in one frame
+    };
+
+    /** The one instance shared by all windows */
+    static ImgTextureUploader& get();
+
+    ImgTextureUploader(const ImgTextureUploader &) = delete;
+    ImgTextureUploader &operator=(const ImgTextureUploader &) = delete;
+
+    /** Queue pixels for the texture `texNum`
+     *
+     * The texture's storage is created with the first strip, with linear filtering.
+     * @param internalFormat e.g. GL_RGBA or GL_ALPHA8
+     * @param format Format of `pixels`, GL_RGBA or GL_ALPHA, unsigned bytes, rows not padded
+     * @param pixels Kept until the upload is done or cancelled
+     * @param onProgress Called after each strip, may be empty */
+    void upload(int texNum, GLint internalFormat, int width, int height, GLenum format,
+                std::shared_ptr<const void> pixels, ProgressFunc onProgress);
+
+    /** Queue all levels of `data` for the texture `texNum`
+     *
+     * With more than one level, the texture gets trilinear filtering.
+     * Compressed data needs OGL_HasTextureCompression().
+     * @param data Kept until the upload is done or cancelled
+     * @param onProgress Called after each strip, may be empty */
+    void upload(int texNum, std::shared_ptr<const ImgTextureData> data, ProgressFunc onProgress);
+
+    /** Drop any pending upload to `texNum`, e.g. before deleting the texture
+     *
+     * Its progress function isn't called anymore. */
+    void cancel(int texNum);
+
+    /** Send strips of the queued textures, at most the budget
+     *
+     * Only the first call per X-Plane frame does anything, so every window's
+     * draw callback may call it. Each frame sends at least one row, even if
+     * that exceeds the budget. */
+    void processFrame();
+
+    /** Limit pixel data sent per frame */
+    void setBudget(size_t bytesPerFrame) { mBudget = bytesPerFrame; }
+
+    /** Pixel data sent per frame at most */
+    size_t getBudget() const { return mBudget; }
+
+    /** Anything left to upload? */
+    bool isBusy() const { return !mJobs.empty(); }
+
+    /** Current counters */
+    const Stats &getStats() const { return mStats; }
+
+    /** Delete our buffer object, pending uploads go on with a new one */
+    void releaseGL();
+
+private:
+    ImgTextureUploader() = default;
+
+    /** A mip level is sent in units of rows, or rows of blocks if compressed */
+    struct JobLevel {
+        int         width = 0;
+        int         height = 0;
+        size_t      offset = 0;             ///< into the job's pixels
+        size_t      unitBytes = 0;          ///< size of a row or a row of blocks
+        int         numUnits = 0;
+    };
+
+    struct Job {
+        int                         texNum = 0;
+        GLint                       internalFormat = GL_RGBA;
+        GLenum                      format = GL_RGBA;
+        bool                        bCompressed = false;
+        std::vector<JobLevel>       levels;
+        std::shared_ptr<const void> pixels;
+        ProgressFunc                onProgress;
+        size_t                      totalBytes = 0;
+        size_t                      sentBytes = 0;
+        size_t                      level = 0;      ///< level being sent
+        int                         nextUnit = 0;   ///< first unit of it not yet sent
+        bool                        bAllocated = false;
+    };
+
+    /** Create the storage of all levels */
+    void allocate(Job &job);
+
+    /** Send units [unit, unit+numUnits) of the current level of `job` */
+    void sendStrip(Job &job, int unit, int numUnits);
+
+    std::deque<Job>     mJobs;
+    size_t              mBudget = 4 * 1024 * 1024;
+    int                 mCycle = -1;
+    bool                mInitialised = false;
+    bool                mUsePBO = false;
+    GLuint              mPBO = 0;
+    Stats               mStats;
+};
+
+#endif //IMGTEXTUREUPLOADER_H
@@ -0,0 +1,175 @@
+/*
+ * ImgTraceWriter.cpp
+ *
+ * Integration for dear imgui into X-Plane: Chrome Trace Export
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImgTraceWriter.h"
+
+#include <chrono>
+
+namespace {
+
+/** Append `s` to `out` as JSON string content */
+void jsonEscape (std::string& out, const char* s)
+{
+    for (; s && *s; ++s) {
+        const unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += char(c);
+        }
+        else if (c < 0x20)
+            out += ' ';
+        else
+            out += char(c);
+    }
+}
+
+}
+
+bool
+ImgTraceWriter::Start (const std::string& fileName)
+{
+    if (!ImgProfiler::isEnabled())
+        return false;
+    Stop();
+
+    mFile = std::fopen(fileName.c_str(), "w");
+    if (!mFile)
+        return false;
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", mFile);
+
+    // Skip everything recorded before now
+    mCursors.clear();
+    mEvents.clear();
+    ImgProfiler::drain(mCursors, mEvents);
+    mEvents.clear();
+    mThreadNamed.clear();
+    mStartNs    = ImgProfiler::now();
+    mNextFrame  = ImgProfiler::currentFrame() + 1;
+    mFirstEvent = true;
+    mNumWritten = 0;
+    mNumLost    = 0;
+    mStopRequested = false;
+
+    mThread = std::thread(&ImgTraceWriter::writerLoop, this);
+    return true;
+}
+
+void
+ImgTraceWriter::Stop ()
+{
+    if (!mThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(mWakeLock);
+        mStopRequested = true;
+    }
+    mWakeCond.notify_all();
+    mThread.join();
+
+    // The thread has written everything up to its end, close the JSON
+    std::fputs("\n]}\n", mFile);
+    std::fclose(mFile);
+    mFile = nullptr;
+}
+
+void
+ImgTraceWriter::writerLoop ()
+{
+    std::unique_lock<std::mutex> lock(mWakeLock);
+    while (!mStopRequested) {
+        mWakeCond.wait_for(lock, std::chrono::milliseconds(unsigned(WRITE_INTERVAL_MS)));
+        lock.unlock();
+        writePending();
+        lock.lock();
+    }
+}
+
+void
+ImgTraceWriter::writePending ()
+{
+    char buf[128];
+    std::string json;
+
+    // Frame markers
+    const std::uint32_t curFrame = ImgProfiler::currentFrame();
+    for (; mNextFrame <= curFrame; mNextFrame++) {
+        const std::uint64_t fs = ImgProfiler::frameStart(mNextFrame);
+        if (fs < mStartNs)                      // unknown (any longer) or before we started
+            continue;
+        std::snprintf(buf, sizeof(buf),
+                      "{\"name\":\"Frame %u\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                      mNextFrame, double(fs - mStartNs) / 1000.0);
+        writeEvent(buf);
+    }
+
+    // Zones as "complete" events
+    mEvents.clear();
+    mNumLost += ImgProfiler::drain(mCursors, mEvents);
+    for (const ImgProfiler::Event& ev: mEvents) {
+        if (ev.startNs < mStartNs)              // started before we did
+            continue;
+
+        // Name the thread the first time we see it
+        if (ev.thread >= mThreadNamed.size())
+            mThreadNamed.resize(ev.thread + 1, false);
+        if (!mThreadNamed[ev.thread]) {
+            std::snprintf(buf, sizeof(buf),
+                          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+                          unsigned(ev.thread), unsigned(ev.thread));
+            writeEvent(buf);
+            mThreadNamed[ev.thread] = true;
+        }
+
+        json = "{\"name\":\"";
+        jsonEscape(json, ev.name);
+        std::snprintf(buf, sizeof(buf),
+                      "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%u}}",
+                      double(ev.startNs - mStartNs) / 1000.0,
+                      double(ev.endNs - ev.startNs) / 1000.0,
+                      unsigned(ev.thread), ev.frame);
+        json += buf;
+        writeEvent(json.c_str());
+        mNumWritten++;
+    }
+    std::fflush(mFile);
+}
+
+void
+ImgTraceWriter::writeEvent (const char* json)
+{
+    if (!mFirstEvent)
+        std::fputs(",\n", mFile);
+    std::fputs(json, mFile);
+    mFirstEvent = false;
+}
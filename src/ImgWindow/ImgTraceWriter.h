@@ -0,0 +1,108 @@
+/*
+ * ImgTraceWriter.h
+ *
+ * Integration for dear imgui into X-Plane: Chrome Trace Export
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMGTRACEWRITER_H
+#define IMGTRACEWRITER_H
+
+#include "ImgProfiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** ImgTraceWriter streams ImgProfiler zones to a trace file
+ *
+ * The file is in Chrome's trace-event JSON format, which both
+ * chrome://tracing and ui.perfetto.dev open. A background thread drains
+ * the profiler's per-thread buffers every WRITE_INTERVAL_MS, so recording
+ * adds no work to the threads being profiled beyond the zones themselves
+ * and long sessions are limited by disk space only.
+ *
+ * Frame starts are written as instant events, so a hitch shows up as
+ * a wide gap between two frame markers.
+ */
+class ImgTraceWriter {
+public:
+    /** How often the background thread writes new zones to the file */
+    static constexpr unsigned WRITE_INTERVAL_MS = 100;
+
+    ImgTraceWriter () = default;
+    ~ImgTraceWriter () { Stop(); }
+
+    ImgTraceWriter (const ImgTraceWriter&) = delete;
+    ImgTraceWriter& operator = (const ImgTraceWriter&) = delete;
+
+    /** Start recording to `fileName`, which is overwritten
+     * @return `false` if the file cannot be created or the profiler isn't compiled in */
+    bool Start (const std::string& fileName);
+
+    /** Stop recording, write remaining zones and close the file */
+    void Stop ();
+
+    /** Currently recording? */
+    bool IsRecording () const { return mThread.joinable(); }
+
+    /** Number of zones written by the current/last recording */
+    std::uint64_t GetNumWritten () const { return mNumWritten; }
+    /** Number of zones lost because the writer couldn't keep up */
+    std::uint64_t GetNumLost () const { return mNumLost; }
+
+private:
+    /** Background thread: write new zones until stopped */
+    void writerLoop ();
+    /** Drain the profiler and write everything new */
+    void writePending ();
+    /** Write one event object, handles the comma separation */
+    void writeEvent (const char* json);
+
+    std::FILE*                  mFile = nullptr;
+    std::thread                 mThread;
+    std::mutex                  mWakeLock;
+    std::condition_variable     mWakeCond;          ///< wakes the writer thread early when stopping
+    bool                        mStopRequested = false; ///< guarded by mWakeLock
+    std::vector<std::uint64_t>  mCursors;           ///< read positions into the profiler's thread buffers
+    std::vector<ImgProfiler::Event> mEvents;        ///< scratch buffer for draining
+    std::vector<bool>           mThreadNamed;       ///< thread name metadata written?
+    std::uint64_t               mStartNs = 0;       ///< time 0 of the trace
+    std::uint32_t               mNextFrame = 0;     ///< next frame marker to write
+    bool                        mFirstEvent = true;
+    std::atomic<std::uint64_t>  mNumWritten {0};
+    std::atomic<std::uint64_t>  mNumLost {0};
+};
+
+#endif // IMGTRACEWRITER_H
@@ -33,10 +33,20 @@
 */
 
 #include "ImgWindow.h"
+#include "ImgDrawBatch.h"
+#include "ImgGlyphCache.h"
+#include "ImgImageService.h"
+#include "ImgProfiler.h"
+#include "ImgRenderState.h"
+#include "ImgTextureUploader.h"
+#include "XOGLUtils.h"
 
 #include <XPLMDataAccess.h>
 #include <XPLMDisplay.h>
 #include <XPLMGraphics.h>
+#include <XPLMUtilities.h>
+
+#include <cstring>
 
 // size of "frame" around a resizable window, by which its size can be changed
 constexpr int WND_RESIZE_LEFT_WIDTH     = 15;
@@ -44,13 +54,195 @@ constexpr int WND_RESIZE_TOP_WIDTH      =  5;
 constexpr int WND_RESIZE_RIGHT_WIDTH    = 15;
 constexpr int WND_RESIZE_BOTTOM_WIDTH   = 15;
 
+// retained mode: how long to keep rebuilding after the last input, so ImGui can settle hover/active states
+constexpr float RETAINED_SETTLE_TIME    = 0.5f;
+
 static XPLMDataRef		gVrEnabledRef			= nullptr;
-static XPLMDataRef		gModelviewMatrixRef		= nullptr;
-static XPLMDataRef		gViewportRef			= nullptr;
-static XPLMDataRef		gProjectionMatrixRef	= nullptr;
 static XPLMDataRef		gFrameRatePeriodRef     = nullptr;
 
 std::shared_ptr<ImgFontAtlas> ImgWindow::sFontAtlas;
+bool ImgWindow::sUseBufferObjects = true;
+int ImgWindow::sNumWindows = 0;
+std::unique_ptr<ImgFontAtlasBuilder> ImgWindow::sFontAtlasBuilder;
+std::shared_ptr<ImgFontAtlas> ImgWindow::sUploadingFontAtlas;
+size_t ImgWindow::sRenderCacheBytes = 0;
+
+/** A pair of vertex/index buffer objects used as streaming ring buffers.
+ *
+ * All windows render in the same GL context, so one instance is shared by
+ * all of them.  Each RenderImGui() call appends its draw data behind the
+ * data of the previous call.  Only when the remaining space doesn't suffice
+ * any longer the buffers are orphaned, ie. the driver hands out fresh storage
+ * while the GPU may still be reading the old one.  This way we never write
+ * into a range the GPU may be using and can map the buffers unsynchronized
+ * (if ARB_map_buffer_range is available).
+ */
+class ImgStreamBuffers {
+public:
+    /** Copies draw_data's vertices and indices into the buffers
+     *
+     * Leaves both buffers bound on success.
+     * @param[out] outVtxBase Byte offset of the first list's vertices
+     * @param[out] outIdxBase Byte offset of the first list's indices
+     * @return false if buffer objects cannot be used, nothing stays bound then
+     */
+    bool upload(const ImDrawData *draw_data, size_t &outVtxBase, size_t &outIdxBase);
+
+    /** Binds both buffers again, e.g. after a draw callback bound others */
+    void bind() const;
+
+    /** Unbinds both buffers, to leave the state like X-Plane expects it */
+    static void unbind();
+
+    /** Deletes the buffer objects */
+    void release();
+
+    /** Bytes allocated in both buffers */
+    size_t allocatedBytes() const { return mVtx.capacity + mIdx.capacity; }
+
+private:
+    struct Ring {
+        GLenum      target      = 0;
+        GLuint      buffer      = 0;
+        size_t      capacity    = 0;        ///< allocated bytes
+        size_t      head        = 0;        ///< next free byte
+
+        /** Makes sure there's room for `bytes` bytes, returns their offset */
+        size_t reserve(size_t bytes);
+    };
+
+    bool        mInitialised    = false;
+    bool        mAvailable      = false;
+    bool        mMapRange       = false;
+    Ring        mVtx;
+    Ring        mIdx;
+
+    /** Writes `bytes` at `offset` of the currently bound buffer */
+    bool write(Ring &ring, size_t offset, size_t bytes, const ImDrawData *draw_data, bool bVertices);
+};
+
+/** Alignment of each window's data in the stream buffers */
+constexpr size_t STREAM_BUFFER_ALIGN    = 64;
+/** Minimum size of a stream buffer */
+constexpr size_t STREAM_BUFFER_MIN_SIZE = 256 * 1024;
+
+static ImgStreamBuffers gStreamBuffers;
+
+size_t
+ImgStreamBuffers::Ring::reserve(size_t bytes)
+{
+    bytes = (bytes + STREAM_BUFFER_ALIGN - 1) & ~(STREAM_BUFFER_ALIGN - 1);
+    glBindBuffer(target, buffer);
+    if (bytes > capacity) {
+        // grow to the next power of two, this also orphans the old storage
+        size_t newCap = capacity ? capacity : STREAM_BUFFER_MIN_SIZE;
+        while (newCap < bytes)
+            newCap *= 2;
+        capacity = newCap;
+        glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr, GL_STREAM_DRAW);
+        head = 0;
+    } else if (head + bytes > capacity) {
+        // wrap around: orphan the storage the GPU may still be reading from
+        glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr, GL_STREAM_DRAW);
+        head = 0;
+    }
+    const size_t offset = head;
+    head += bytes;
+    return offset;
+}
+
+bool
+ImgStreamBuffers::write(Ring &ring, size_t offset, size_t bytes, const ImDrawData *draw_data, bool bVertices)
+{
+#if !APL
+    if (mMapRange) {
+        // we never write into a range in use since the last orphaning, so no need to synchronize
+        auto *dst = static_cast<char *>(glMapBufferRange(ring.target,
+                                                         static_cast<GLintptr>(offset),
+                                                         static_cast<GLsizeiptr>(bytes),
+                                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        if (dst) {
+            for (int n = 0; n < draw_data->CmdListsCount; n++) {
+                const ImDrawList *cmd_list = draw_data->CmdLists[n];
+                const size_t sz = bVertices ?
+                    cmd_list->VtxBuffer.size_in_bytes() : cmd_list->IdxBuffer.size_in_bytes();
+                std::memcpy(dst, bVertices ? (const void *)cmd_list->VtxBuffer.Data : (const void *)cmd_list->IdxBuffer.Data, sz);
+                dst += sz;
+            }
+            if (glUnmapBuffer(ring.target) == GL_TRUE)
+                return true;
+        }
+        // mapping failed: don't try again, glBufferSubData below will do
+        mMapRange = false;
+    }
+#endif
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        const ImDrawList *cmd_list = draw_data->CmdLists[n];
+        const size_t sz = bVertices ?
+            cmd_list->VtxBuffer.size_in_bytes() : cmd_list->IdxBuffer.size_in_bytes();
+        glBufferSubData(ring.target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(sz),
+                        bVertices ? (const void *)cmd_list->VtxBuffer.Data : (const void *)cmd_list->IdxBuffer.Data);
+        offset += sz;
+    }
+    return true;
+}
+
+bool
+ImgStreamBuffers::upload(const ImDrawData *draw_data, size_t &outVtxBase, size_t &outIdxBase)
+{
+    if (!mInitialised) {
+        // first use: find out what the driver supports
+        OGL_UtilsInit();
+        mAvailable = OGL_HasBufferObjects();
+        mMapRange  = OGL_HasMapBufferRange();
+        if (mAvailable) {
+            GLuint buffers[2] = { 0, 0 };
+            glGenBuffers(2, buffers);
+            mVtx.target = GL_ARRAY_BUFFER;
+            mVtx.buffer = buffers[0];
+            mIdx.target = GL_ELEMENT_ARRAY_BUFFER;
+            mIdx.buffer = buffers[1];
+        }
+        mInitialised = true;
+    }
+    if (!mAvailable)
+        return false;
+
+    const size_t vtxBytes = static_cast<size_t>(draw_data->TotalVtxCount) * sizeof(ImDrawVert);
+    const size_t idxBytes = static_cast<size_t>(draw_data->TotalIdxCount) * sizeof(ImDrawIdx);
+
+    outVtxBase = mVtx.reserve(vtxBytes);
+    if (vtxBytes > 0)
+        write(mVtx, outVtxBase, vtxBytes, draw_data, true);
+    outIdxBase = mIdx.reserve(idxBytes);
+    if (idxBytes > 0)
+        write(mIdx, outIdxBase, idxBytes, draw_data, false);
+    return true;
+}
+
+void
+ImgStreamBuffers::bind() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, mVtx.buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIdx.buffer);
+}
+
+void
+ImgStreamBuffers::unbind()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void
+ImgStreamBuffers::release()
+{
+    if (mAvailable) {
+        GLuint buffers[2] = { mVtx.buffer, mIdx.buffer };
+        glDeleteBuffers(2, buffers);
+    }
+    *this = ImgStreamBuffers();
+}
 
 ImgWindow::ImgWindow(
 	int left,
@@ -64,6 +256,7 @@ ImgWindow::ImgWindow(
 	mPreferredLayer(layer),
     bHandleWndResize(xplm_WindowDecorationSelfDecoratedResizable == decoration)
 {
+    ++sNumWindows;
     ImFontAtlas *iFontAtlas = nullptr;
     if (mFontAtlas) {
         mFontAtlas->bindTexture();
@@ -76,9 +269,6 @@ ImgWindow::ImgWindow(
 	static bool first_init=false;
 	if (!first_init) {
 		gVrEnabledRef = XPLMFindDataRef("sim/graphics/VR/enabled");
-		gModelviewMatrixRef = XPLMFindDataRef("sim/graphics/view/modelview_matrix");
-		gViewportRef = XPLMFindDataRef("sim/graphics/view/viewport");
-		gProjectionMatrixRef = XPLMFindDataRef("sim/graphics/view/projection_matrix");
         gFrameRatePeriodRef = XPLMFindDataRef("sim/operation/misc/frame_rate_period");
 		first_init=true;
 	}
@@ -87,6 +277,8 @@ ImgWindow::ImgWindow(
 	// we render ourselves, we don't use the DrawListsFunc
 	io.RenderDrawListsFn = nullptr;
 #endif
+	// RenderImGui() honors ImDrawCmd::VtxOffset, so meshes can exceed 64k vertices even with 16-bit indices
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
 	// set up the Keymap
 	io.KeyMap[ImGuiKey_Tab] = XPLM_VK_TAB;
 	io.KeyMap[ImGuiKey_LeftArrow] = XPLM_VK_LEFT;
@@ -182,8 +374,23 @@ ImgWindow::~ImgWindow()
 	    // if we didn't have an explicit font atlas, destroy the texture.
         glDeleteTextures(1, &mFontTexture);
     }
-	ImGui::DestroyContext(mImGuiContext);
+	{
+	    // a running atlas build counts its allocations in whatever context is current
+	    std::unique_lock<std::mutex> idle;
+	    if (sFontAtlasBuilder)
+	        idle = sFontAtlasBuilder->WaitIdle();
+	    ImGui::DestroyContext(mImGuiContext);
+	}
 	XPLMDestroyWindow(mWindowID);
+
+	releaseCache();
+
+	// the last window to go also frees the shared stream buffers and shader
+	if (--sNumWindows == 0) {
+	    gStreamBuffers.release();
+	    ImgRenderState::get().releaseGL();
+	    ImgTextureUploader::get().releaseGL();
+	}
 }
 
 void
@@ -212,10 +419,9 @@ ImgWindow::SetWindowResizingLimits (int minW, int minH, int maxW, int maxH)
 void
 ImgWindow::updateMatrices()
 {
-	// Get the current modelview matrix, viewport, and projection matrix from X-Plane
-	XPLMGetDatavf(gModelviewMatrixRef, mModelView, 0, 16);
-	XPLMGetDatavf(gProjectionMatrixRef, mProjection, 0, 16);
-	XPLMGetDatavi(gViewportRef, mViewport, 0, 4);
+	// Get the current modelview matrix, viewport, and projection matrix from X-Plane,
+	// for windows in the main view only once per draw pass
+	ImgRenderState::get().getViewMatrices(IsInsideSim(), mModelView, mProjection, mViewport);
 }
 
 static void multMatrixVec4f(GLfloat dst[4], const GLfloat m[16], const GLfloat v[4])
@@ -242,6 +448,9 @@ ImgWindow::boxelsToNative(int x, int y, int &outX, int &outY)
 	outY = static_cast<int>((ndc[1] * 0.5f + 0.5f) * mViewport[3] + mViewport[1]);
 }
 
+/** Draw call preparation, shared by all windows to reuse its buffers */
+static ImgDrawBatcher gDrawBatcher;
+
 /*
  * NB:  This is a modified version of the imGui OpenGL2 renderer - however, because
  *     we need to play nice with the X-Plane GL state management, we cannot use
@@ -251,75 +460,124 @@ ImgWindow::boxelsToNative(int x, int y, int &outX, int &outY)
 void
 ImgWindow::RenderImGui(ImDrawData *draw_data)
 {
+	IMG_PROFILE_ZONE("ImgWindow::RenderImGui");
 	// Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
 	ImGuiIO& io = ImGui::GetIO();
     if (io.DisplayFramebufferScale.x != 1.0 ||
         io.DisplayFramebufferScale.y != 1.0)
         draw_data->ScaleClipRects(io.DisplayFramebufferScale);
 
-    updateMatrices();
-
 	// We are using the OpenGL fixed pipeline because messing with the
 	// shader-state in X-Plane is not very well documented, but using the fixed
 	// function pipeline is.
 
-	// 1TU + Alpha settings, no depth, no fog.
-	XPLMSetGraphicsState(0, 1, 0, 1, 1, 0, 0);
-	glPushClientAttrib(GL_CLIENT_ALL_ATTRIB_BITS);
-	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT);
-	glDisable(GL_CULL_FACE);
-	glEnable(GL_SCISSOR_TEST);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-	glEnable(GL_TEXTURE_2D);
+	// 1TU + Alpha settings, no depth, no fog, vertex/texture/color arrays.
+	// The render state shared by all windows only changes what isn't set
+	// already and restores just that afterwards.
+    // Glyphs added while building the interface go to the atlas texture first
+    if (ImgGlyphCache *glyphCache = mFontAtlas ? mFontAtlas->getGlyphCache() : nullptr)
+        glyphCache->flush();
+
+    ImgRenderState& renderState = ImgRenderState::get();
+    renderState.beginWindow();
+	if (mFontAtlas && mFontAtlas->getDistanceField() > 0)
+		renderState.setDistanceFieldTexture(int(mFontTexture));
 
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
-	glScalef(1.0f, -1.0f, 1.0f);
-	glTranslatef(static_cast<GLfloat>(mLeft), static_cast<GLfloat>(-mTop), 0.0f);
+	if (bRenderingToCache) {
+		// The cache texture covers exactly the ImGui display, y pointing down
+		glLoadIdentity();
+		glOrtho(0.0, static_cast<GLdouble>(mRight - mLeft), static_cast<GLdouble>(mTop - mBottom), 0.0, -1.0, 1.0);
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadIdentity();
+	} else {
+		updateMatrices();
+		glScalef(1.0f, -1.0f, 1.0f);
+		glTranslatef(static_cast<GLfloat>(mLeft), static_cast<GLfloat>(-mTop), 0.0f);
+	}
+
+	// Pre-pass: transform all clip rects with one affine ImGui -> native transformation
+	// and merge commands sharing texture and clip rect into one draw call
+	const ImgClipTransform xform = bRenderingToCache ?
+		ImgClipTransform::forTexture(mCacheWidth, mCacheHeight, float(mRight - mLeft), float(mTop - mBottom)) :
+		ImgClipTransform::fromView(mModelView, mProjection, mViewport, mLeft, mTop);
+	gDrawBatcher.build(draw_data, xform);
+	const std::vector<ImgDrawBatcher::Batch>& batches = gDrawBatcher.batches();
+
+	// Stream all vertices/indices into buffer objects in one go, if possible.
+	// Otherwise the pointers below refer to client memory as before,
+	// which the driver then has to copy with each glDrawElements call.
+	size_t vtxBase = 0, idxBase = 0;
+	const bool bBuffers = sUseBufferObjects && gStreamBuffers.upload(draw_data, vtxBase, idxBase);
 
 	// Render command lists
+	const int* lastScissor = nullptr;
+	ImTextureID lastTexture = nullptr;
 	for (int n = 0; n < draw_data->CmdListsCount; n++)
 	{
 		const ImDrawList* cmd_list = draw_data->CmdLists[n];
-		const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
-		const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
-		glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + IM_OFFSETOF(ImDrawVert, pos)));
-		glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + IM_OFFSETOF(ImDrawVert, uv)));
-		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (const GLvoid*)((const char*)vtx_buffer + IM_OFFSETOF(ImDrawVert, col)));
-
-		for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+		const char* vtx_buffer = bBuffers ?
+			reinterpret_cast<const char*>(vtxBase) : reinterpret_cast<const char*>(cmd_list->VtxBuffer.Data);
+		const char* idx_buffer = bBuffers ?
+			reinterpret_cast<const char*>(idxBase) : reinterpret_cast<const char*>(cmd_list->IdxBuffer.Data);
+		vtxBase += cmd_list->VtxBuffer.size_in_bytes();
+		idxBase += cmd_list->IdxBuffer.size_in_bytes();
+		unsigned int vtxOffset = UINT_MAX;          // vertex pointers not yet set for this list
+
+		const ImgDrawBatcher::List& list = gDrawBatcher.lists()[size_t(n)];
+		for (int b = list.firstBatch; b < list.firstBatch + list.numBatches; b++)
 		{
-			const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
-			if (pcmd->UserCallback)	{
-				pcmd->UserCallback(cmd_list, pcmd);
+			const ImgDrawBatcher::Batch& batch = batches[size_t(b)];
+			if (batch.callback)	{
+				batch.callback->UserCallback(cmd_list, batch.callback);
+				// The callback may have bound its own texture and buffers
+				renderState.invalidateTexture();
+				if (bBuffers)
+					gStreamBuffers.bind();
+				else
+					ImgStreamBuffers::unbind();
+				lastScissor = nullptr;
+				vtxOffset = UINT_MAX;
 			} else {
-			    XPLMBindTexture2d((int)(intptr_t)pcmd->TextureId, 0);
-
-				// Scissors work in viewport space - must translate the coordinates from ImGui -> Boxels, then Boxels -> Native.
-				//FIXME: it must be possible to apply the scale+transform manually to the projection matrix so we don't need to doublestep.
-				int bTop, bLeft, bRight, bBottom;
-				translateImguiToBoxel(pcmd->ClipRect.x, pcmd->ClipRect.y, bLeft, bTop);
-				translateImguiToBoxel(pcmd->ClipRect.z, pcmd->ClipRect.w, bRight, bBottom);
-				int nTop, nLeft, nRight, nBottom;
-				boxelsToNative(bLeft, bTop, nLeft, nTop);
-				boxelsToNative(bRight, bBottom, nRight, nBottom);
-				glScissor(nLeft, nBottom, nRight-nLeft, nTop-nBottom);
-				glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer);
+				// Large meshes are split into parts with their own vertex offset,
+				// the fixed function pipeline has no base vertex, so move the pointers
+				if (batch.vtxOffset != vtxOffset) {
+					vtxOffset = batch.vtxOffset;
+					const char* vtx = vtx_buffer + vtxOffset * sizeof(ImDrawVert);
+					glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)(vtx + IM_OFFSETOF(ImDrawVert, pos)));
+					glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)(vtx + IM_OFFSETOF(ImDrawVert, uv)));
+					glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (const GLvoid*)(vtx + IM_OFFSETOF(ImDrawVert, col)));
+				}
+			    renderState.bindTexture((int)(intptr_t)batch.texture);
+				// Images drawn, also from retained draw data, stay resident
+				if (batch.texture != lastTexture) {
+					ImgImageService::get().markDrawn((int)(intptr_t)batch.texture);
+					lastTexture = batch.texture;
+				}
+				// Scissor boxes are already in viewport space, only set if changed
+				if (!lastScissor || std::memcmp(lastScissor, batch.scissor, sizeof(batch.scissor)) != 0) {
+					glScissor(batch.scissor[0], batch.scissor[1], batch.scissor[2], batch.scissor[3]);
+					lastScissor = batch.scissor;
+				}
+				glDrawElements(GL_TRIANGLES, (GLsizei)batch.elemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+							   idx_buffer + batch.idxOffset * sizeof(ImDrawIdx));
 			}
-			idx_buffer += pcmd->ElemCount;
 		}
 	}
 
+	if (bBuffers)
+		ImgStreamBuffers::unbind();
+
+	if (bRenderingToCache) {
+		glMatrixMode(GL_MODELVIEW);
+		glPopMatrix();
+	}
 	glMatrixMode(GL_PROJECTION);
 	glPopMatrix();
 	// Restore modified state
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_COLOR_ARRAY);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glPopAttrib();
-	glPopClientAttrib();
+	renderState.endWindow();
 }
 
 void
@@ -350,6 +608,7 @@ ImgWindow::translateImguiToBoxel(float inX, float inY, int &outX, int &outY)
 void
 ImgWindow::updateImgui()
 {
+	IMG_PROFILE_ZONE("ImgWindow::updateImgui");
 	ImGui::SetCurrentContext(mImGuiContext);
 	auto &io = ImGui::GetIO();
 
@@ -364,6 +623,13 @@ ImgWindow::updateImgui()
     if (FrameRatePeriod > 0.0f) {
         io.DeltaTime = XPLMGetDataf(gFrameRatePeriodRef);
     }
+    // In retained or cached mode frames may have been skipped, so time passed since the last rebuild counts
+    const float now = XPLMGetElapsedTime();
+    if ((bRetainedMode || cacheRate > 0.0f) && lastBuildTime >= 0.0f && now > lastBuildTime) {
+        io.DeltaTime = now - lastBuildTime;
+    }
+    lastBuildTime = now;
+    bDirty = false;
 	io.DisplaySize = ImVec2(win_width, win_height);
 	// in boxels, we're always scale 1, 1.
 	io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
@@ -374,9 +640,19 @@ ImgWindow::updateImgui()
 
 	// and construct the window
 	ImGui::Begin(mWindowTitle.c_str(), nullptr, beforeBegin() | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse);
-	buildInterface();
+	{
+		IMG_PROFILE_ZONE("buildInterface");
+		buildInterface();
+	}
 	ImGui::End();
 
+	// The draw data refers to glyph cache pages and font sizes as they are now
+	if (ImgGlyphCache *glyphCache = mFontAtlas ? mFontAtlas->getGlyphCache() : nullptr)
+		glyphGeneration = glyphCache->getGeneration();
+	if (mFontAtlas)
+		builtFontScale = mFontAtlas->getFontScale();
+	imageGeneration = ImgImageService::get().getGeneration();
+
 	// finally, handle window focus.
 	int hasKeyboardFocus = XPLMHasKeyboardFocus(mWindowID);
 	if (io.WantTextInput && !hasKeyboardFocus) {
@@ -395,14 +671,41 @@ ImgWindow::updateImgui()
 void
 ImgWindow::DrawWindowCB(XPLMWindowID /* inWindowID */, void *inRefcon)
 {
+	IMG_PROFILE_ZONE("ImgWindow::DrawWindowCB");
 	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
 
-	thisWindow->updateImgui();
+	// Textures of images decoded in the background, strips of all pending uploads
+	ImgImageService::get().processUploads();
+	ImgTextureUploader::get().processFrame();
+
+	// A font atlas built in the background is swapped in before anything is drawn
+	swapInRebuiltFontAtlas();
+	if (thisWindow->mFontAtlas && sFontAtlas && thisWindow->mFontAtlas != sFontAtlas)
+		thisWindow->useFontAtlas();
+
+	if (thisWindow->mGpuTimer)
+		thisWindow->mGpuTimer->begin(XPLMGetCycleNumber());
+
+	if (thisWindow->cacheRate > 0.0f) {
+		// Render-to-texture mode: mostly just one quad with the cached texture
+		thisWindow->DrawCached();
+	} else {
+		// In retained mode idle frames just render the previous frame's draw data again
+		if (thisWindow->needsRebuild()) {
+			thisWindow->updateImgui();
+
+			ImGui::SetCurrentContext(thisWindow->mImGuiContext);
+			IMG_PROFILE_ZONE("ImGui::Render");
+			ImGui::Render();
+		} else {
+			ImGui::SetCurrentContext(thisWindow->mImGuiContext);
+		}
 
-	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
-	ImGui::Render();
+		thisWindow->RenderImGui(ImGui::GetDrawData());
+	}
 
-	thisWindow->RenderImGui(ImGui::GetDrawData());
+	if (thisWindow->mGpuTimer)
+		thisWindow->mGpuTimer->end();
     
     // Give subclasses a chance to do something after all rendering
     thisWindow->afterRendering();
@@ -425,8 +728,10 @@ ImgWindow::HandleMouseClickCB(XPLMWindowID /* inWindowID */, int x, int y, XPLMM
 int
 ImgWindow::HandleMouseClickGeneric(int x, int y, XPLMMouseStatus inMouse, int button)
 {
+	IMG_PROFILE_ZONE("ImgWindow::HandleMouseClick");
 	ImGui::SetCurrentContext(mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
+	noteInput();
 
     // Tell ImGui the mous position relative to the window
     translateToImguiSpace(x, y, io.MousePos.x, io.MousePos.y);
@@ -546,9 +851,11 @@ ImgWindow::HandleKeyFuncCB(
 	void *               inRefcon,
 	int                  blosingFocus)
 {
+	IMG_PROFILE_ZONE("ImgWindow::HandleKeyFuncCB");
 	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
 	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
+	thisWindow->noteInput();
 	if (io.WantCaptureKeyboard) {
         
         // Loosing focus? That's not exactly something ImGui allows us to do...
@@ -598,11 +905,15 @@ ImgWindow::HandleCursorFuncCB(
 	int                  y,
 	void *               inRefcon)
 {
+	IMG_PROFILE_ZONE("ImgWindow::HandleCursorFuncCB");
 	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
 	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
 	float outX, outY;
 	thisWindow->translateToImguiSpace(x, y, outX, outY);
+	// X-Plane keeps calling us while the mouse rests above the window, only movement counts as input
+	if (outX != io.MousePos.x || outY != io.MousePos.y)
+		thisWindow->noteInput();
 	io.MousePos = ImVec2(outX, outY);
 	//FIXME: Maybe we can support imgui's cursors a bit better?
 	return xplm_CursorDefault;
@@ -617,6 +928,7 @@ ImgWindow::HandleMouseWheelFuncCB(
 	int                  clicks,
 	void *               inRefcon)
 {
+	IMG_PROFILE_ZONE("ImgWindow::HandleMouseWheelFuncCB");
 	auto *thisWindow = reinterpret_cast<ImgWindow *>(inRefcon);
 	ImGui::SetCurrentContext(thisWindow->mImGuiContext);
 	ImGuiIO& io = ImGui::GetIO();
@@ -624,6 +936,7 @@ ImgWindow::HandleMouseWheelFuncCB(
 	float outX, outY;
 	thisWindow->translateToImguiSpace(x, y, outX, outY);
 	io.MousePos = ImVec2(outX, outY);
+	thisWindow->noteInput();
 	switch (wheel) {
 	case 0:
 		io.MouseWheel += static_cast<float>(clicks);
@@ -651,6 +964,348 @@ ImgWindow::SetWindowTitle(const std::string &title)
 {
 	mWindowTitle = title;
 	XPLMSetWindowTitle(mWindowID, mWindowTitle.c_str());
+	Invalidate();
+}
+
+void
+ImgWindow::SetRetainedMode (bool bRetained)
+{
+    bRetainedMode = bRetained;
+    Invalidate();
+}
+
+void
+ImgWindow::SetFontScale (float scale)
+{
+    ImGui::SetCurrentContext(mImGuiContext);
+    ImGui::GetIO().FontGlobalScale = scale;
+    Invalidate();
+}
+
+float
+ImgWindow::GetFontScale () const
+{
+    ImGui::SetCurrentContext(mImGuiContext);
+    return ImGui::GetIO().FontGlobalScale;
+}
+
+bool
+ImgWindow::needsRebuild()
+{
+    // without retained mode, or without anything rendered yet, we always build
+    if (!bRetainedMode || mFirstRender || bDirty)
+        return true;
+
+    ImGui::SetCurrentContext(mImGuiContext);
+    if (!ImGui::GetDrawData())
+        return true;
+    
+    // glyphs evicted from the cache, which the old draw data might still show?
+    if (ImgGlyphCache *glyphCache = mFontAtlas ? mFontAtlas->getGlyphCache() : nullptr)
+        if (glyphCache->getGeneration() != glyphGeneration)
+            return true;
+
+    // images got ready, which the old draw data shows placeholders for?
+    if (ImgImageService::get().getGeneration() != imageGeneration)
+        return true;
+
+    // fonts drawn at another size now?
+    if (mFontAtlas && mFontAtlas->getFontScale() != builtFontScale)
+        return true;
+
+    // geometry changed?
+    int left, top, right, bottom;
+    XPLMGetWindowGeometry(mWindowID, &left, &top, &right, &bottom);
+    if (left != mLeft || top != mTop || right != mRight || bottom != mBottom)
+        return true;
+
+    // recent input, ie. ImGui might still be settling hover/active states?
+    const float now = XPLMGetElapsedTime();
+    if (lastInputTime >= 0.0f && now - lastInputTime < RETAINED_SETTLE_TIME)
+        return true;
+
+    // mouse button held down or text input active (blinking cursor)?
+    const ImGuiIO& io = ImGui::GetIO();
+    if (io.WantTextInput)
+        return true;
+    for (bool bDown: io.MouseDown)
+        if (bDown)
+            return true;
+
+    // animated content due for an update?
+    if (animationRate > 0.0f && now - lastBuildTime >= 1.0f / animationRate)
+        return true;
+
+    // idle frame
+    return false;
+}
+
+void
+ImgWindow::noteInput()
+{
+    lastInputTime = XPLMGetElapsedTime();
+    bDirty = true;
+}
+
+void
+ImgWindow::SetCachedRenderRate (float hz)
+{
+    cacheRate = hz > 0.0f ? hz : 0.0f;
+    if (cacheRate <= 0.0f)
+        releaseCache();
+    Invalidate();
+}
+
+bool
+ImgWindow::SetGpuTiming (bool bEnable)
+{
+    if (!bEnable)
+        mGpuTimer.reset();
+    else if (!mGpuTimer && ImgGpuTimer::isAvailable())
+        mGpuTimer.reset(new ImgGpuTimer());
+    return IsGpuTiming();
+}
+
+void
+ImgWindow::DrawCached()
+{
+    ImGui::SetCurrentContext(mImGuiContext);
+
+    // The window's size in native pixels defines the texture size.
+    // The view matrices differ between in-sim, popped-out and VR windows,
+    // so this always matches the resolution the window is displayed in.
+    int left, top, right, bottom;
+    XPLMGetWindowGeometry(mWindowID, &left, &top, &right, &bottom);
+    updateMatrices();
+    int nLeft, nTop, nRight, nBottom;
+    boxelsToNative(left, top, nLeft, nTop);
+    boxelsToNative(right, bottom, nRight, nBottom);
+    const int texWidth  = nRight - nLeft;
+    const int texHeight = nTop - nBottom;
+    if (texWidth <= 0 || texHeight <= 0)
+        return;
+
+    const bool bResized = !mCacheTexture || texWidth != mCacheWidth || texHeight != mCacheHeight;
+    if (bResized || cacheRefreshDue()) {
+        // In retained mode the interface might not have changed at all
+        const bool bRebuild = needsRebuild();
+        if (bRebuild) {
+            updateImgui();
+            ImGui::SetCurrentContext(mImGuiContext);
+            IMG_PROFILE_ZONE("ImGui::Render");
+            ImGui::Render();
+        }
+        if (bRebuild || bResized) {
+            if (!renderToCache(ImGui::GetDrawData(), texWidth, texHeight)) {
+                // no render-to-texture available: render directly from now on
+                cacheRate = 0.0f;
+                releaseCache();
+                RenderImGui(ImGui::GetDrawData());
+                return;
+            }
+        }
+        lastCacheTime = XPLMGetElapsedTime();
+    }
+
+    drawCacheQuad(left, top, right, bottom);
+}
+
+bool
+ImgWindow::cacheRefreshDue()
+{
+    // Invalidated or input received? Then the user shall see it right away,
+    // and also while ImGui settles hover/active states
+    const float now = XPLMGetElapsedTime();
+    if (mFirstRender || bDirty)
+        return true;
+    if (lastInputTime >= 0.0f && now - lastInputTime < RETAINED_SETTLE_TIME)
+        return true;
+
+    // window moved or resized?
+    int left, top, right, bottom;
+    XPLMGetWindowGeometry(mWindowID, &left, &top, &right, &bottom);
+    if (left != mLeft || top != mTop || right != mRight || bottom != mBottom)
+        return true;
+
+    // regular refresh
+    return lastCacheTime < 0.0f || now - lastCacheTime >= 1.0f / cacheRate;
+}
+
+bool
+ImgWindow::renderToCache(ImDrawData *draw_data, int texWidth, int texHeight)
+{
+    static const bool bAvailable = OGL_UtilsInit() && OGL_HasFramebufferObjects();
+    if (!bAvailable || !draw_data)
+        return false;
+
+    // X-Plane renders popped-out and VR windows into framebuffers of its own,
+    // remember which one to return to
+#if APL
+    GLint prevDrawFBO = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevDrawFBO);
+#else
+    GLint prevDrawFBO = 0, prevReadFBO = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDrawFBO);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFBO);
+#endif
+
+    if (!mCacheFBO) {
+        glGenFramebuffers(1, &mCacheFBO);
+        XPLMGenerateTextureNumbers(&mCacheTexture, 1);
+        mCacheWidth = mCacheHeight = 0;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, mCacheFBO);
+
+    // (Re)allocate the texture in the window's current native size
+    if (texWidth != mCacheWidth || texHeight != mCacheHeight) {
+        ImgRenderState::get().bindTexture(mCacheTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, (GLuint)mCacheTexture, 0);
+        sRenderCacheBytes -= size_t(mCacheWidth) * size_t(mCacheHeight) * 4;
+        sRenderCacheBytes += size_t(texWidth) * size_t(texHeight) * 4;
+        mCacheWidth  = texWidth;
+        mCacheHeight = texHeight;
+    }
+
+    const bool bComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (bComplete) {
+        // Only done at the cache's refresh rate, so pushing attributes is affordable here
+        glPushAttrib(GL_VIEWPORT_BIT | GL_SCISSOR_BIT | GL_COLOR_BUFFER_BIT);
+        glViewport(0, 0, mCacheWidth, mCacheHeight);
+        glDisable(GL_SCISSOR_TEST);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        // Keep correct alpha in the texture, which then holds premultiplied colors
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        bRenderingToCache = true;
+        RenderImGui(draw_data);
+        bRenderingToCache = false;
+
+        glPopAttrib();
+    }
+
+#if APL
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prevDrawFBO);
+#else
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)prevDrawFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)prevReadFBO);
+#endif
+    return bComplete;
+}
+
+void
+ImgWindow::drawCacheQuad(int left, int top, int right, int bottom)
+{
+    ImgRenderState& renderState = ImgRenderState::get();
+    renderState.beginCacheQuad();
+    renderState.bindTexture(mCacheTexture);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f); glVertex2i(left,  bottom);
+    glTexCoord2f(1.0f, 0.0f); glVertex2i(right, bottom);
+    glTexCoord2f(1.0f, 1.0f); glVertex2i(right, top);
+    glTexCoord2f(0.0f, 1.0f); glVertex2i(left,  top);
+    glEnd();
+    renderState.endCacheQuad();
+}
+
+void
+ImgWindow::RebuildFontAtlas(ImgFontAtlasBuilder::Factory factory)
+{
+    if (!sFontAtlasBuilder)
+        sFontAtlasBuilder.reset(new ImgFontAtlasBuilder());
+    sFontAtlasBuilder->Start(std::move(factory));
+}
+
+bool
+ImgWindow::IsRebuildingFontAtlas()
+{
+    return (sFontAtlasBuilder && sFontAtlasBuilder->IsBusy()) || sUploadingFontAtlas;
+}
+
+void
+ImgWindow::CancelFontAtlasRebuild()
+{
+    sFontAtlasBuilder.reset();
+    sUploadingFontAtlas.reset();
+}
+
+void
+ImgWindow::swapInRebuiltFontAtlas()
+{
+    if (!sFontAtlasBuilder)
+        return;
+    std::string error;
+    std::shared_ptr<ImgFontAtlas> atlas = sFontAtlasBuilder->TakeResult(error);
+    if (!error.empty()) {
+        error = "ImgWindow: Font atlas rebuild failed: " + error + "\n";
+        XPLMDebugString(error.c_str());
+    }
+    if (atlas) {
+        // Only the upload is left to do, the pixels are ready. It takes a few
+        // frames, a newer atlas replaces one still uploading.
+        IMG_PROFILE_ZONE("ImgWindow::swapInRebuiltFontAtlas");
+        atlas->bindTexture(true);
+        sUploadingFontAtlas = std::move(atlas);
+    }
+    if (sUploadingFontAtlas && sUploadingFontAtlas->isTextureReady())
+        sFontAtlas = std::move(sUploadingFontAtlas);
+}
+
+void
+ImgWindow::useFontAtlas()
+{
+    // The old atlas goes once the last window lets go of it. Nothing in our
+    // context refers to its fonts outside of a frame, NewFrame() picks the new default font.
+    mFontAtlas = sFontAtlas;
+    ImGui::SetCurrentContext(mImGuiContext);
+    ImGuiIO& io = ImGui::GetIO();
+    io.Fonts = mFontAtlas->getAtlas();
+    io.FontDefault = nullptr;
+    mFontTexture = static_cast<GLuint>(reinterpret_cast<intptr_t>(io.Fonts->TexID));
+
+    // Retained or cached draw data still points into the old texture
+    Invalidate();
+}
+
+void
+ImgWindow::RequestGlyphs(const char* text, const char* text_end)
+{
+    if (ImgGlyphCache *glyphCache = mFontAtlas ? mFontAtlas->getGlyphCache() : nullptr)
+        glyphCache->request(text, text_end);
+}
+
+ImgWindow::VramUsage
+ImgWindow::GetVramUsage()
+{
+    VramUsage usage;
+    usage.fontAtlas     = sFontAtlas ? sFontAtlas->getTextureBytes() : 0;
+    usage.renderCaches  = sRenderCacheBytes;
+    usage.streamBuffers = gStreamBuffers.allocatedBytes();
+    usage.images        = ImgImageService::get().getTextureBytes();
+    return usage;
+}
+
+void
+ImgWindow::releaseCache()
+{
+    if (mCacheFBO) {
+        glDeleteFramebuffers(1, &mCacheFBO);
+        mCacheFBO = 0;
+    }
+    if (mCacheTexture) {
+        GLuint tex = (GLuint)mCacheTexture;
+        glDeleteTextures(1, &tex);
+        mCacheTexture = 0;
+    }
+    sRenderCacheBytes -= size_t(mCacheWidth) * size_t(mCacheHeight) * 4;
+    mCacheWidth = mCacheHeight = 0;
+    lastCacheTime = -1.0f;
 }
 
 void
@@ -771,6 +1426,7 @@ ImgWindow::SelfDestructCallback(float /*inElapsedSinceLastCall*/,
                                 int   /*inCounter*/,
                                 void* /*inRefcon*/)
 {
+    IMG_PROFILE_ZONE("ImgWindow::SelfDestructCallback");
     while (!sPendingDestruction.empty()) {
         auto *thisObj = sPendingDestruction.front();
         sPendingDestruction.pop();
@@ -47,6 +47,8 @@
 #include <queue>
 
 #include "ImgFontAtlas.h"
+#include "ImgFontAtlasBuilder.h"
+#include "ImgGpuTimer.h"
 
 /** ImgWindow is a Window for creating dear imgui widgets within.
  *
@@ -83,6 +85,51 @@ public:
      */
     static std::shared_ptr<ImgFontAtlas> sFontAtlas;
 
+    /** sUseBufferObjects selects the buffer-object streaming renderer.
+     *
+     * If set (the default) each frame's vertex and index data is streamed
+     * into vertex/index buffer objects shared by all windows instead of
+     * being drawn from client-side arrays.  If the driver doesn't offer
+     * buffer objects the client-side array path is used regardless.
+     */
+    static bool sUseBufferObjects;
+
+    /** Video memory allocated for ImgWindow rendering, in bytes
+     *
+     * Counts what was requested from the driver, which may pad or
+     * store formats differently. */
+    struct VramUsage {
+        size_t  fontAtlas       = 0;    ///< shared font atlas texture (sFontAtlas)
+        size_t  renderCaches    = 0;    ///< render-to-texture caches of all windows
+        size_t  streamBuffers   = 0;    ///< vertex/index stream buffers shared by all windows
+        size_t  images          = 0;    ///< textures of ImgImageService
+
+        size_t total () const { return fontAtlas + renderCaches + streamBuffers + images; }
+    };
+
+    /** Current video memory usage of all windows */
+    static VramUsage GetVramUsage ();
+
+    /** Replace sFontAtlas with one built on a worker thread
+     *
+     * `factory` creates and sets up the new atlas like it is done at startup,
+     * e.g. with another font size, but runs on the worker thread together
+     * with rasterizing the fonts, so it must not call XPLM or OpenGL.
+     * Meanwhile all windows keep drawing with the current atlas. Once the
+     * build finished, ImgTextureUploader uploads the new texture over the
+     * next frames, then it becomes sFontAtlas. Each window switches over
+     * (and rebuilds) in its next draw callback. A rebuild requested while
+     * one is running replaces the pending one.
+     */
+    static void RebuildFontAtlas (ImgFontAtlasBuilder::Factory factory);
+
+    /** Is a font atlas rebuild requested or not yet swapped in? */
+    static bool IsRebuildingFontAtlas ();
+
+    /** Drop any pending rebuild, waiting for one in progress to finish.
+     * Call before resetting sFontAtlas at shutdown. */
+    static void CancelFontAtlasRebuild ();
+
     virtual ~ImgWindow();
     
     /** Gets the current window geometry */
@@ -180,6 +227,71 @@ public:
      * @param y Vertical position in ImGui coordinates
      */
     bool IsInsideWindowDragArea (int x, int y) const;
+
+    /** @brief Retained mode: rebuild the interface only if something changed
+     * @details In retained mode NewFrame(), buildInterface() and Render() are
+     * skipped on idle frames, ie. if there was no mouse, key or wheel input
+     * recently, the window geometry didn't change, and nobody called
+     * Invalidate(). The previous frame's draw data is rendered again instead.
+     * Content that changes by itself needs to call Invalidate() or declare
+     * an animation rate via SetAnimationRate().
+     * Off by default. */
+    void SetRetainedMode (bool bRetained);
+    
+    /** Is retained mode on? */
+    bool IsRetainedMode () const { return bRetainedMode; }
+    
+    /** Mark the window dirty, so that the interface gets rebuilt with the next frame */
+    void Invalidate () { bDirty = true; }
+    
+    /** @brief Declare how often animated content needs rebuilding in retained mode
+     * @param hz Minimum rebuild rate in Hz, 0 for static content */
+    void SetAnimationRate (float hz) { animationRate = hz > 0.0f ? hz : 0.0f; }
+    
+    /** Current animation rate in Hz (0 for static content) */
+    float GetAnimationRate () const { return animationRate; }
+    
+    /** @brief Render-to-texture caching: render the interface at most `hz` times per second
+     * @details The window's ImGui output is rendered into a texture of the
+     * window's native pixel size, in between the cached texture is drawn as
+     * one single quad. Input, Invalidate(), and changes to the window's geometry
+     * force an immediate re-render. Works for in-sim, popped-out and VR windows.
+     * Combined with retained mode, a due refresh is skipped if the interface
+     * doesn't need rebuilding.
+     * @param hz Refresh rate in Hz, 0 (the default) switches caching off.
+     * @note Falls back to direct rendering if framebuffer objects aren't available. */
+    void SetCachedRenderRate (float hz);
+    
+    /** Current render-to-texture refresh rate in Hz (0 if caching is off) */
+    float GetCachedRenderRate () const { return cacheRate; }
+    
+    /** @brief Measure the GPU time of this window's draws
+     * @details Each draw is bracketed with GL timestamp queries, which are
+     * read back asynchronously a few frames later. Results are kept in a
+     * ring buffer of the last ImgGpuTimer::MAX_SAMPLES draws.
+     * @return Is GPU timing on now? (Not possible without ARB_timer_query) */
+    bool SetGpuTiming (bool bEnable);
+    
+    /** Is GPU timing on? */
+    bool IsGpuTiming () const { return bool(mGpuTimer); }
+    
+    /** @brief Scale all text of this window, e.g. for VR or a high-DPI pop-out
+     * @details Sets ImGuiIO::FontGlobalScale of the window's context. With a
+     * distance field font atlas (ImgFontAtlas::setDistanceField()) text stays
+     * crisp at any scale, a coverage atlas is stretched. */
+    void SetFontScale (float scale);
+    
+    /** Current text scale of this window, 1 by default */
+    float GetFontScale () const;
+    
+    /** min/avg/p99 GPU time of the recorded draws, all 0 if not timing */
+    ImgGpuTimer::Stats GetGpuTimingStats () const
+    { return mGpuTimer ? mGpuTimer->getStats() : ImgGpuTimer::Stats(); }
+    
+    /** Write the recorded GPU times as CSV lines `"label",frame,gpu_ms`
+     * @param label Identifies the window in the CSV, defaults to the window title */
+    void WriteGpuTimingCSV (std::ostream& out, const std::string& label = std::string()) const
+    { if (mGpuTimer) mGpuTimer->writeCSV(out, label.empty() ? mWindowTitle : label); }
     
 protected:
     /** mFirstRender can be checked during buildInterface() to see if we're
@@ -272,9 +384,25 @@ protected:
     /** Returns X-Plane's internal Window id */
     XPLMWindowID GetWindowId () const { return mWindowID; }
 
+    /** Make sure the font has glyphs for all characters in `text`
+     *
+     * Only needed with the atlas' glyph cache enabled, and only for text that
+     * may hold characters beyond the baked ranges, like names from data files.
+     * Call in buildInterface() before the text is measured or drawn. */
+    void RequestGlyphs (const char* text, const char* text_end = nullptr);
+
 private:
     std::shared_ptr<ImgFontAtlas> mFontAtlas;
 
+    /** Background rebuilds of sFontAtlas, created on first use */
+    static std::unique_ptr<ImgFontAtlasBuilder> sFontAtlasBuilder;
+    /** Rebuilt atlas whose texture ImgTextureUploader is still filling */
+    static std::shared_ptr<ImgFontAtlas> sUploadingFontAtlas;
+    /** Make a finished rebuild sFontAtlas once uploaded (needs the GL context) */
+    static void swapInRebuiltFontAtlas ();
+    /** Switch our ImGui context over to sFontAtlas */
+    void useFontAtlas ();
+
     static void DrawWindowCB(XPLMWindowID inWindowID, void *inRefcon);
 
     static int HandleMouseClickCB(
@@ -316,6 +444,11 @@ private:
     static std::queue<ImgWindow *>  sPendingDestruction;
     static XPLMFlightLoopID         sSelfDestructHandler;
 
+    /** Number of existing windows, shared GL resources are freed with the last one */
+    static int                      sNumWindows;
+    /** Bytes of all windows' render-to-texture caches */
+    static size_t                   sRenderCacheBytes;
+
     int HandleMouseClickGeneric(
         int x, int y,
         XPLMMouseStatus inMouse,
@@ -323,8 +456,30 @@ private:
 
     void RenderImGui(ImDrawData *draw_data);
 
+    /** Render-to-texture mode: refresh the cache if needed, then draw it */
+    void DrawCached();
+
+    /** Render-to-texture mode: is a refresh of the cached texture due? */
+    bool cacheRefreshDue();
+
+    /** Render draw_data into the cache texture of the given size
+     * @return false if render-to-texture isn't possible */
+    bool renderToCache(ImDrawData *draw_data, int texWidth, int texHeight);
+
+    /** Draw the cache texture as one quad covering the given boxels */
+    void drawCacheQuad(int left, int top, int right, int bottom);
+
+    /** Free cache texture and framebuffer */
+    void releaseCache();
+
     void updateImgui();
 
+    /** In retained mode: does the interface need rebuilding this frame? */
+    bool needsRebuild();
+
+    /** Record user input for retained mode */
+    void noteInput();
+
     void updateMatrices();
 
     void boxelsToNative(int x, int y, int &outX, int &outY);
@@ -352,6 +507,31 @@ private:
     /** Shall reset the backspace key? (see HandleKeyFuncCB for details) */
     bool bResetBackspace = false;
     
+    /** Retained mode: is on, window needs rebuilding, minimum rebuild rate */
+    bool bRetainedMode      = false;
+    bool bDirty             = true;
+    float animationRate     = 0.0f;
+    /** Retained mode: time (XPLMGetElapsedTime) of last rebuild and last input */
+    float lastBuildTime     = -1.0f;
+    float lastInputTime     = -1.0f;
+    /** Retained mode: glyph cache and image generation, and font scale the draw data was built with */
+    unsigned glyphGeneration = 0;
+    unsigned imageGeneration = 0;
+    float builtFontScale     = 1.0f;
+    
+    /** Render-to-texture: refresh rate, framebuffer and texture, texture size, time of last refresh */
+    float cacheRate         = 0.0f;
+    GLuint mCacheFBO        = 0;
+    int mCacheTexture       = 0;
+    int mCacheWidth         = 0;
+    int mCacheHeight        = 0;
+    float lastCacheTime     = -1.0f;
+    /** Set while RenderImGui() renders into the cache texture */
+    bool bRenderingToCache  = false;
+    
+    /** GPU timing of our draws, if enabled */
+    std::unique_ptr<ImgGpuTimer> mGpuTimer;
+    
     /** Set if `xplm_WindowDecorationSelfDecoratedResizable`,
      *  ie. we need to handle resizing ourselves: X-Plane provides
      *  the "hand" mouse icon but as we catch mouse events X-Plane
@@ -44,6 +44,37 @@ PFNGLMULTITEXCOORD2FVARBPROC	glMultiTexCoord2fvARB	 = NULL;
 PFNGLGENERATEMIPMAPPROC			glGenerateMipmap		 = NULL;
 PFNGLGENVERTEXARRAYSPROC 		glGenVertexArrays   	 = NULL;
 PFNGLDELETEVERTEXARRAYSPROC		glDeleteVertexArrays	 = NULL;
+PFNGLGENBUFFERSPROC				glGenBuffers			 = NULL;
+PFNGLDELETEBUFFERSPROC			glDeleteBuffers			 = NULL;
+PFNGLBINDBUFFERPROC				glBindBuffer			 = NULL;
+PFNGLBUFFERDATAPROC				glBufferData			 = NULL;
+PFNGLBUFFERSUBDATAPROC			glBufferSubData			 = NULL;
+PFNGLMAPBUFFERRANGEPROC			glMapBufferRange		 = NULL;
+PFNGLUNMAPBUFFERPROC			glUnmapBuffer			 = NULL;
+PFNGLBLENDFUNCSEPARATEPROC		glBlendFuncSeparate		 = NULL;
+PFNGLGENFRAMEBUFFERSPROC		glGenFramebuffers		 = NULL;
+PFNGLDELETEFRAMEBUFFERSPROC		glDeleteFramebuffers	 = NULL;
+PFNGLBINDFRAMEBUFFERPROC		glBindFramebuffer		 = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DPROC	glFramebufferTexture2D	 = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC	glCheckFramebufferStatus = NULL;
+PFNGLGENQUERIESPROC				glGenQueries			 = NULL;
+PFNGLDELETEQUERIESPROC			glDeleteQueries			 = NULL;
+PFNGLQUERYCOUNTERPROC			glQueryCounter			 = NULL;
+PFNGLGETQUERYOBJECTIVPROC		glGetQueryObjectiv		 = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC	glGetQueryObjectui64v	 = NULL;
+PFNGLCREATESHADERPROC			glCreateShader			 = NULL;
+PFNGLSHADERSOURCEPROC			glShaderSource			 = NULL;
+PFNGLCOMPILESHADERPROC			glCompileShader			 = NULL;
+PFNGLGETSHADERIVPROC			glGetShaderiv			 = NULL;
+PFNGLGETSHADERINFOLOGPROC		glGetShaderInfoLog		 = NULL;
+PFNGLDELETESHADERPROC			glDeleteShader			 = NULL;
+PFNGLCREATEPROGRAMPROC			glCreateProgram			 = NULL;
+PFNGLATTACHSHADERPROC			glAttachShader			 = NULL;
+PFNGLLINKPROGRAMPROC			glLinkProgram			 = NULL;
+PFNGLGETPROGRAMIVPROC			glGetProgramiv			 = NULL;
+PFNGLDELETEPROGRAMPROC			glDeleteProgram			 = NULL;
+PFNGLUSEPROGRAMPROC				glUseProgram			 = NULL;
+PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC	glCompressedTexSubImage2D = NULL;
 #endif
 
 #ifdef DEBUG
@@ -88,6 +119,9 @@ OGL_EnumerateExtensions()
 		xpmp_glExtensions.insert(allExtensions.substr(0, offs));
 		allExtensions = allExtensions.substr(offs+1);
 	}
+	// the list is not necessarily terminated by a blank
+	if (!allExtensions.empty())
+		xpmp_glExtensions.insert(allExtensions);
 }
 
 bool	OGL_UtilsInit()
@@ -108,6 +142,37 @@ bool	OGL_UtilsInit()
 		glGenerateMipmap		 = (PFNGLGENERATEMIPMAPPROC)		 wglGetProcAddress("glGenerateMipmap"		 );
 		glGenVertexArrays   	 = (PFNGLGENVERTEXARRAYSPROC)		 wglGetProcAddress("glGenVertexArrays");
 		glDeleteVertexArrays	 = (PFNGLDELETEVERTEXARRAYSPROC)	 wglGetProcAddress("glDeleteVertexArrays");
+		glGenBuffers			 = (PFNGLGENBUFFERSPROC)			 wglGetProcAddress("glGenBuffers");
+		glDeleteBuffers			 = (PFNGLDELETEBUFFERSPROC)			 wglGetProcAddress("glDeleteBuffers");
+		glBindBuffer			 = (PFNGLBINDBUFFERPROC)			 wglGetProcAddress("glBindBuffer");
+		glBufferData			 = (PFNGLBUFFERDATAPROC)			 wglGetProcAddress("glBufferData");
+		glBufferSubData			 = (PFNGLBUFFERSUBDATAPROC)			 wglGetProcAddress("glBufferSubData");
+		glMapBufferRange		 = (PFNGLMAPBUFFERRANGEPROC)		 wglGetProcAddress("glMapBufferRange");
+		glUnmapBuffer			 = (PFNGLUNMAPBUFFERPROC)			 wglGetProcAddress("glUnmapBuffer");
+		glBlendFuncSeparate		 = (PFNGLBLENDFUNCSEPARATEPROC)		 wglGetProcAddress("glBlendFuncSeparate");
+		glGenFramebuffers		 = (PFNGLGENFRAMEBUFFERSPROC)		 wglGetProcAddress("glGenFramebuffers");
+		glDeleteFramebuffers	 = (PFNGLDELETEFRAMEBUFFERSPROC)	 wglGetProcAddress("glDeleteFramebuffers");
+		glBindFramebuffer		 = (PFNGLBINDFRAMEBUFFERPROC)		 wglGetProcAddress("glBindFramebuffer");
+		glFramebufferTexture2D	 = (PFNGLFRAMEBUFFERTEXTURE2DPROC)	 wglGetProcAddress("glFramebufferTexture2D");
+		glCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC) wglGetProcAddress("glCheckFramebufferStatus");
+		glGenQueries			 = (PFNGLGENQUERIESPROC)			 wglGetProcAddress("glGenQueries");
+		glDeleteQueries			 = (PFNGLDELETEQUERIESPROC)			 wglGetProcAddress("glDeleteQueries");
+		glQueryCounter			 = (PFNGLQUERYCOUNTERPROC)			 wglGetProcAddress("glQueryCounter");
+		glGetQueryObjectiv		 = (PFNGLGETQUERYOBJECTIVPROC)		 wglGetProcAddress("glGetQueryObjectiv");
+		glGetQueryObjectui64v	 = (PFNGLGETQUERYOBJECTUI64VPROC)	 wglGetProcAddress("glGetQueryObjectui64v");
+		glCreateShader			 = (PFNGLCREATESHADERPROC)			 wglGetProcAddress("glCreateShader");
+		glShaderSource			 = (PFNGLSHADERSOURCEPROC)			 wglGetProcAddress("glShaderSource");
+		glCompileShader			 = (PFNGLCOMPILESHADERPROC)			 wglGetProcAddress("glCompileShader");
+		glGetShaderiv			 = (PFNGLGETSHADERIVPROC)			 wglGetProcAddress("glGetShaderiv");
+		glGetShaderInfoLog		 = (PFNGLGETSHADERINFOLOGPROC)		 wglGetProcAddress("glGetShaderInfoLog");
+		glDeleteShader			 = (PFNGLDELETESHADERPROC)			 wglGetProcAddress("glDeleteShader");
+		glCreateProgram			 = (PFNGLCREATEPROGRAMPROC)			 wglGetProcAddress("glCreateProgram");
+		glAttachShader			 = (PFNGLATTACHSHADERPROC)			 wglGetProcAddress("glAttachShader");
+		glLinkProgram			 = (PFNGLLINKPROGRAMPROC)			 wglGetProcAddress("glLinkProgram");
+		glGetProgramiv			 = (PFNGLGETPROGRAMIVPROC)			 wglGetProcAddress("glGetProgramiv");
+		glDeleteProgram			 = (PFNGLDELETEPROGRAMPROC)			 wglGetProcAddress("glDeleteProgram");
+		glUseProgram			 = (PFNGLUSEPROGRAMPROC)			 wglGetProcAddress("glUseProgram");
+		glCompressedTexSubImage2D = (PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC) wglGetProcAddress("glCompressedTexSubImage2D");
 #endif
 #ifdef DEBUG_GL
 		if (OGL_HasExtension("GL_KHR_debug")) {
@@ -152,3 +217,86 @@ bool	OGL_HasExtension(const std::string &inExtensionName)
 {
 	return (xpmp_glExtensions.count(inExtensionName) > 0);
 }
+
+bool	OGL_HasBufferObjects()
+{
+#if IBM
+	if (!glGenBuffers || !glDeleteBuffers || !glBindBuffer ||
+		!glBufferData || !glBufferSubData || !glUnmapBuffer)
+		return false;
+#endif
+	// core since GL 1.5, but drivers still advertise the ARB extension
+	return OGL_HasExtension("GL_ARB_vertex_buffer_object");
+}
+
+bool	OGL_HasMapBufferRange()
+{
+#if APL
+	// not available in the legacy context on Mac
+	return false;
+#else
+#if IBM
+	if (!glMapBufferRange)
+		return false;
+#endif
+	return OGL_HasBufferObjects() && OGL_HasExtension("GL_ARB_map_buffer_range");
+#endif
+}
+
+bool	OGL_HasPixelBufferObjects()
+{
+	// core since GL 2.1, which also the legacy context on Mac offers
+	return OGL_HasBufferObjects() && OGL_HasExtension("GL_ARB_pixel_buffer_object");
+}
+
+bool	OGL_HasTextureCompression()
+{
+#if IBM
+	if (!glCompressedTexSubImage2D)
+		return false;
+#endif
+	return OGL_HasExtension("GL_EXT_texture_compression_s3tc");
+}
+
+bool	OGL_HasFramebufferObjects()
+{
+#if APL
+	// the legacy context on Mac offers the EXT version only
+	return OGL_HasExtension("GL_EXT_framebuffer_object");
+#else
+#if IBM
+	if (!glBlendFuncSeparate || !glGenFramebuffers || !glDeleteFramebuffers ||
+		!glBindFramebuffer || !glFramebufferTexture2D || !glCheckFramebufferStatus)
+		return false;
+#endif
+	return OGL_HasExtension("GL_ARB_framebuffer_object");
+#endif
+}
+
+bool	OGL_HasTimerQuery()
+{
+#if APL
+	// the legacy context on Mac has no timestamp queries
+	return false;
+#else
+#if IBM
+	if (!glGenQueries || !glDeleteQueries || !glQueryCounter ||
+		!glGetQueryObjectiv || !glGetQueryObjectui64v)
+		return false;
+#endif
+	return OGL_HasExtension("GL_ARB_timer_query");
+#endif
+}
+
+bool	OGL_HasShaders()
+{
+#if IBM
+	if (!glCreateShader || !glShaderSource || !glCompileShader || !glGetShaderiv ||
+		!glGetShaderInfoLog || !glDeleteShader || !glCreateProgram || !glAttachShader ||
+		!glLinkProgram || !glGetProgramiv || !glDeleteProgram || !glUseProgram)
+		return false;
+#endif
+	// core since GL 2.0, which also the legacy context on Mac offers
+	const char *version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+	return version && version[0] >= '2' && version[0] <= '9';
+}
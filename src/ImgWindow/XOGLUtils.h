@@ -49,6 +49,29 @@
 #define GL_ARRAY_BUFFER_ARB               0x8892
 #define GL_ARRAY_BUFFER_BINDING_ARB       0x8894
 #endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER            0x88EC
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+#endif
+#if APL
+// The legacy 2.1 context on Mac doesn't know ARB_map_buffer_range
+#define GL_MAP_WRITE_BIT                  0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT       0x0004
+#define GL_MAP_UNSYNCHRONIZED_BIT         0x0020
+// ...and offers framebuffer objects only as EXT_framebuffer_object
+#define glGenFramebuffers                 glGenFramebuffersEXT
+#define glDeleteFramebuffers              glDeleteFramebuffersEXT
+#define glBindFramebuffer                 glBindFramebufferEXT
+#define glFramebufferTexture2D            glFramebufferTexture2DEXT
+#define glCheckFramebufferStatus          glCheckFramebufferStatusEXT
+#define GL_FRAMEBUFFER                    GL_FRAMEBUFFER_EXT
+#define GL_FRAMEBUFFER_BINDING            GL_FRAMEBUFFER_BINDING_EXT
+#define GL_FRAMEBUFFER_COMPLETE           GL_FRAMEBUFFER_COMPLETE_EXT
+#define GL_COLOR_ATTACHMENT0              GL_COLOR_ATTACHMENT0_EXT
+#endif
 
 typedef void (APIENTRY * PFNGLBINDBUFFERARBPROC )			(GLenum, GLuint);
 typedef void (APIENTRY * PFNGLACTIVETEXTUREARBPROC)			(GLenum);
@@ -63,6 +86,37 @@ extern PFNGLMULTITEXCOORD2FVARBPROC		glMultiTexCoord2fvARB;
 extern PFNGLACTIVETEXTUREARBPROC		glActiveTextureARB;
 extern PFNGLCLIENTACTIVETEXTUREARBPROC	glClientActiveTextureARB;
 extern PFNGLGENERATEMIPMAPPROC          glGenerateMipmap;
+extern PFNGLGENBUFFERSPROC              glGenBuffers;
+extern PFNGLDELETEBUFFERSPROC           glDeleteBuffers;
+extern PFNGLBINDBUFFERPROC              glBindBuffer;
+extern PFNGLBUFFERDATAPROC              glBufferData;
+extern PFNGLBUFFERSUBDATAPROC           glBufferSubData;
+extern PFNGLMAPBUFFERRANGEPROC          glMapBufferRange;
+extern PFNGLUNMAPBUFFERPROC             glUnmapBuffer;
+extern PFNGLBLENDFUNCSEPARATEPROC       glBlendFuncSeparate;
+extern PFNGLGENFRAMEBUFFERSPROC         glGenFramebuffers;
+extern PFNGLDELETEFRAMEBUFFERSPROC      glDeleteFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC         glBindFramebuffer;
+extern PFNGLFRAMEBUFFERTEXTURE2DPROC    glFramebufferTexture2D;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC  glCheckFramebufferStatus;
+extern PFNGLGENQUERIESPROC              glGenQueries;
+extern PFNGLDELETEQUERIESPROC           glDeleteQueries;
+extern PFNGLQUERYCOUNTERPROC            glQueryCounter;
+extern PFNGLGETQUERYOBJECTIVPROC        glGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC     glGetQueryObjectui64v;
+extern PFNGLCREATESHADERPROC            glCreateShader;
+extern PFNGLSHADERSOURCEPROC            glShaderSource;
+extern PFNGLCOMPILESHADERPROC           glCompileShader;
+extern PFNGLGETSHADERIVPROC             glGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC        glGetShaderInfoLog;
+extern PFNGLDELETESHADERPROC            glDeleteShader;
+extern PFNGLCREATEPROGRAMPROC           glCreateProgram;
+extern PFNGLATTACHSHADERPROC            glAttachShader;
+extern PFNGLLINKPROGRAMPROC             glLinkProgram;
+extern PFNGLGETPROGRAMIVPROC            glGetProgramiv;
+extern PFNGLDELETEPROGRAMPROC           glDeleteProgram;
+extern PFNGLUSEPROGRAMPROC              glUseProgram;
+extern PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC  glCompressedTexSubImage2D;
 #endif
 
 #ifdef DEBUG_GL
@@ -101,6 +155,27 @@ enum GLDebug_Group {
 
 bool	OGL_UtilsInit();
 
+/** Can we use vertex/index buffer objects (GL 1.5 / ARB_vertex_buffer_object)? */
+bool	OGL_HasBufferObjects();
+
+/** Can we map sub-ranges of buffer objects (ARB_map_buffer_range)? */
+bool	OGL_HasMapBufferRange();
+
+/** Can we source texture uploads from buffer objects (ARB_pixel_buffer_object)? */
+bool	OGL_HasPixelBufferObjects();
+
+/** Can we upload BC1/BC3 compressed textures (EXT_texture_compression_s3tc)? */
+bool	OGL_HasTextureCompression();
+
+/** Can we render into textures via framebuffer objects (ARB/EXT_framebuffer_object)? */
+bool	OGL_HasFramebufferObjects();
+
+/** Can we take GPU timestamps (ARB_timer_query)? */
+bool	OGL_HasTimerQuery();
+
+/** Can we use GLSL fragment programs (GL 2.0)? */
+bool	OGL_HasShaders();
+
 #ifdef __cplusplus
 
 #include <string>
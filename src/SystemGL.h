@@ -6,6 +6,9 @@
 #ifdef __APPLE__
 #include <OpenGL/gl.h>
 #else
+#if !defined(_WIN32) && !defined(GL_GLEXT_PROTOTYPES)
+#define GL_GLEXT_PROTOTYPES     // Linux: entry points beyond GL 1.1 are linked directly (Windows uses XOGLUtils)
+#endif
 #include <GL/gl.h>
 #include <GL/glext.h>
 #endif
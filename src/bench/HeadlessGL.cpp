@@ -0,0 +1,176 @@
+/*
+ * HeadlessGL.cpp
+ *
+ * Integration for dear imgui into X-Plane: Offscreen GL Context
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "HeadlessGL.h"
+
+#include "SystemGL.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdio>
+
+HeadlessGL::~HeadlessGL ()
+{
+    if (!mDisplay)
+        return;
+    if (mContext) {
+        if (mFBO)       glDeleteFramebuffers(1, &mFBO);
+        if (mColorRB)   glDeleteRenderbuffers(1, &mColorRB);
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(mDisplay, mContext);
+    }
+    if (mSurface)
+        eglDestroySurface(mDisplay, mSurface);
+    eglTerminate(mDisplay);
+}
+
+bool HeadlessGL::Init (int width, int height)
+{
+    mWidth  = width;
+    mHeight = height;
+
+    // Surfaceless Mesa if available, which needs no window system at all
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    const char* clientExt = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    const bool bSurfaceless = clientExt && getPlatformDisplay &&
+                              std::string(clientExt).find("EGL_MESA_platform_surfaceless") != std::string::npos;
+    if (bSurfaceless)
+        dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (dpy == EGL_NO_DISPLAY)
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, nullptr, nullptr)) {
+        mError = "No EGL display";
+        return false;
+    }
+    mDisplay = dpy;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        mError = "EGL does not support desktop OpenGL";
+        return false;
+    }
+
+    // A small pbuffer config serves as fallback where surfaceless contexts aren't supported
+    const EGLint cfgAttr[] = {
+        EGL_SURFACE_TYPE,       EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE,    EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig cfg = nullptr;
+    EGLint numCfg = 0;
+    eglChooseConfig(dpy, cfgAttr, &cfg, 1, &numCfg);
+
+    mContext = eglCreateContext(dpy, numCfg > 0 ? cfg : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+    if (mContext == EGL_NO_CONTEXT) {
+        mContext = nullptr;
+        mError = "Could not create an OpenGL context";
+        return false;
+    }
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, mContext)) {
+        if (numCfg <= 0) {
+            mError = "Surfaceless context not supported and no pbuffer config";
+            return false;
+        }
+        const EGLint pbAttr[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+        mSurface = eglCreatePbufferSurface(dpy, cfg, pbAttr);
+        if (mSurface == EGL_NO_SURFACE || !eglMakeCurrent(dpy, mSurface, mSurface, mContext)) {
+            mSurface = nullptr;
+            mError = "Could not make the OpenGL context current";
+            return false;
+        }
+    }
+
+    // Our "screen"
+    glGenRenderbuffers(1, &mColorRB);
+    glBindRenderbuffer(GL_RENDERBUFFER, mColorRB);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, mWidth, mHeight);
+    glGenFramebuffers(1, &mFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorRB);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        mError = "Framebuffer incomplete";
+        return false;
+    }
+    return true;
+}
+
+void HeadlessGL::BeginFrame ()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+    glViewport(0, 0, mWidth, mHeight);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, mWidth, 0, mHeight, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void HeadlessGL::Finish ()
+{
+    glFinish();
+}
+
+void HeadlessGL::ReadPixels (std::vector<unsigned char>& out) const
+{
+    out.resize(size_t(mWidth) * size_t(mHeight) * 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, out.data());
+}
+
+bool HeadlessGL::WritePPM (const std::string& fileName) const
+{
+    std::vector<unsigned char> px;
+    ReadPixels(px);
+    std::FILE* f = std::fopen(fileName.c_str(), "wb");
+    if (!f)
+        return false;
+    std::fprintf(f, "P6\n%d %d\n255\n", mWidth, mHeight);
+    for (int y = mHeight - 1; y >= 0; y--)              // PPM is top row first
+        for (int x = 0; x < mWidth; x++)
+            std::fwrite(&px[(size_t(y) * size_t(mWidth) + size_t(x)) * 4], 1, 3, f);
+    std::fclose(f);
+    return true;
+}
+
+std::string HeadlessGL::GetRenderer () const
+{
+    const GLubyte* r = glGetString(GL_RENDERER);
+    return r ? std::string((const char*)r) : std::string();
+}
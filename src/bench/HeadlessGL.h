@@ -0,0 +1,88 @@
+/*
+ * HeadlessGL.h
+ *
+ * Integration for dear imgui into X-Plane: Offscreen GL Context
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef HEADLESSGL_H
+#define HEADLESSGL_H
+
+#include <string>
+#include <vector>
+
+/** An offscreen OpenGL context for running windows without X-Plane
+ *
+ * Uses EGL, preferably Mesa's surfaceless platform, which needs neither
+ * a display server nor a GPU (llvmpipe, force it with LIBGL_ALWAYS_SOFTWARE=1).
+ * Rendering goes into a framebuffer object of the requested size, which
+ * stays bound as the default target, just like X-Plane's window drawing
+ * phase renders into the screen. The context is a compatibility profile
+ * as ImgWindow uses fixed-function GL.
+ */
+class HeadlessGL {
+public:
+    HeadlessGL () = default;
+    ~HeadlessGL ();
+
+    HeadlessGL (const HeadlessGL&) = delete;
+    HeadlessGL& operator = (const HeadlessGL&) = delete;
+
+    /** Create context and framebuffer, make it current
+     * @return `false` if no context could be created, see GetError() */
+    bool Init (int width, int height);
+
+    /** Prepare a new frame: bind framebuffer, set viewport and a screen-sized ortho projection, clear */
+    void BeginFrame ();
+    /** Wait for all rendering to finish */
+    void Finish ();
+
+    /** Read back the framebuffer, RGBA, bottom row first */
+    void ReadPixels (std::vector<unsigned char>& out) const;
+    /** Write the framebuffer to a binary PPM file */
+    bool WritePPM (const std::string& fileName) const;
+
+    /** The GL renderer string, for reporting */
+    std::string GetRenderer () const;
+    /** What went wrong in Init() */
+    const std::string& GetError () const { return mError; }
+
+private:
+    void*       mDisplay    = nullptr;  ///< EGLDisplay
+    void*       mContext    = nullptr;  ///< EGLContext
+    void*       mSurface    = nullptr;  ///< EGLSurface (pbuffer, if surfaceless isn't available)
+    unsigned    mFBO        = 0;
+    unsigned    mColorRB    = 0;
+    int         mWidth      = 0;
+    int         mHeight     = 0;
+    std::string mError;
+};
+
+#endif // HEADLESSGL_H
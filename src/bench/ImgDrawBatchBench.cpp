@@ -0,0 +1,274 @@
+/*
+ * ImgDrawBatchBench.cpp
+ *
+ * Integration for dear imgui into X-Plane: Draw Command Batching Benchmark
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Host-only benchmark, doesn't need X-Plane: Records the draw data of a
+ * table-heavy window similar to the starter window's "Table" demo, then
+ * compares the per-command clip rect transformation RenderImGui() used to do
+ * with the ImgDrawBatcher pre-pass.  Reports draw calls and CPU time per frame.
+ *
+ * Usage: ImgDrawBatchBench [rows] [iterations]
+ */
+
+#include "ImgDrawBatch.h"
+
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Screen and window in boxels, as X-Plane would report them
+constexpr int SCREEN_W  = 1920;
+constexpr int SCREEN_H  = 1080;
+constexpr int WND_LEFT  = 100;
+constexpr int WND_TOP   = 1000;
+constexpr int WND_W     = 900;
+constexpr int WND_H     = 950;
+
+/** Builds a table similar to the starter window's one */
+static void buildTableWindow(int rows)
+{
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f), ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImVec2(float(WND_W), float(WND_H)), ImGuiCond_Always);
+    ImGui::Begin("Bench", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse);
+    ImGui::TextUnformatted("Table-heavy window");
+    ImGui::Separator();
+    ImGui::PushStyleColor(ImGuiCol_TableRowBgAlt, IM_COL32(0x1a, 0x1a, 0x1a, 0xff));
+    if (ImGui::BeginTable("Table", 7,
+                          ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable |
+                          ImGuiTableFlags_Hideable | ImGuiTableFlags_Sortable |
+                          ImGuiTableFlags_RowBg |
+                          ImGuiTableFlags_SizingFixedFit |
+                          ImGuiTableFlags_ScrollX | ImGuiTableFlags_ScrollY, ImVec2(0.0f, 600.0f)))
+    {
+        ImGui::TableSetupColumn("Tail", ImGuiTableColumnFlags_DefaultSort, 60);
+        ImGui::TableSetupColumn("Type", ImGuiTableColumnFlags_None, 50);
+        ImGui::TableSetupColumn("Model", ImGuiTableColumnFlags_None, 180);
+        ImGui::TableSetupColumn("Owner", ImGuiTableColumnFlags_None, 200);
+        ImGui::TableSetupColumn("Heading", ImGuiTableColumnFlags_None, 110);
+        ImGui::TableSetupColumn("Left", ImGuiTableColumnFlags_None, 30);
+        ImGui::TableSetupColumn("Actions", ImGuiTableColumnFlags_NoSort, 150);
+        ImGui::TableSetupScrollFreeze(1,1);
+        ImGui::TableHeadersRow();
+
+        for (int i = 0; i < rows; i++) {
+            ImGui::PushID(i);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("D-E%03d", i);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(i % 2 ? "C172" : "B738");
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(i % 2 ? "Cessna 172 SP Skyhawk" : "Boeing 737-800");
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(i % 3 ? "Private owner" : "Some airline");
+            ImGui::TableNextColumn();
+            ImGui::TextColored(i % 2 ? ImVec4(1.0f, 0.0f, 0.0f, 1.0f) : ImVec4(0.0f, 1.0f, 0.0f, 1.0f),
+                               "%03d", (i * 37) % 360);
+            ImGui::TableNextColumn();
+            bool bLeft = (i % 2) != 0;
+            ImGui::Checkbox("##Left", &bLeft);
+            ImGui::TableNextColumn();
+            ImGui::ArrowButton("N", ImGuiDir_Up);       ImGui::SameLine();
+            ImGui::ArrowButton("E", ImGuiDir_Right);    ImGui::SameLine();
+            ImGui::ArrowButton("S", ImGuiDir_Down);     ImGui::SameLine();
+            ImGui::ArrowButton("W", ImGuiDir_Left);     ImGui::SameLine();
+            ImGui::SmallButton("Del");
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+    ImGui::PopStyleColor();
+    // legacy columns, each column clips separately
+    ImGui::Columns(3, "cols", true);
+    for (int i = 0; i < 30; i++) { ImGui::Text("cell %d", i); ImGui::NextColumn(); }
+    ImGui::Columns();
+    ImGui::End();
+}
+
+/** A deep copy of one frame's draw data */
+struct RecordedFrame {
+    std::vector<ImDrawList*>    lists;
+    ImDrawData                  drawData;
+
+    explicit RecordedFrame (const ImDrawData& src)
+    {
+        drawData = src;
+        for (int n = 0; n < src.CmdListsCount; n++)
+            lists.push_back(src.CmdLists[n]->CloneOutput());
+        drawData.CmdLists = lists.data();
+    }
+
+    ~RecordedFrame ()
+    {
+        for (ImDrawList* l: lists)
+            IM_DELETE(l);
+    }
+};
+
+//
+// The way RenderImGui() used to compute scissor boxes, for reference
+//
+
+static void multMatrixVec4f(float dst[4], const float m[16], const float v[4])
+{
+    dst[0] = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + v[3] * m[12];
+    dst[1] = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + v[3] * m[13];
+    dst[2] = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + v[3] * m[14];
+    dst[3] = v[0] * m[3] + v[1] * m[7] + v[2] * m[11] + v[3] * m[15];
+}
+
+struct LegacyView {
+    float mModelView[16], mProjection[16];
+    int mViewport[4];
+    int mLeft, mTop;
+
+    void boxelsToNative(int x, int y, int &outX, int &outY) const
+    {
+        float boxelPos[4] = { (float)x, (float)y, 0, 1 };
+        float eye[4], ndc[4];
+
+        multMatrixVec4f(eye, mModelView, boxelPos);
+        multMatrixVec4f(ndc, mProjection, eye);
+        ndc[3] = 1.0f / ndc[3];
+        ndc[0] *= ndc[3];
+        ndc[1] *= ndc[3];
+
+        outX = static_cast<int>((ndc[0] * 0.5f + 0.5f) * mViewport[2] + mViewport[0]);
+        outY = static_cast<int>((ndc[1] * 0.5f + 0.5f) * mViewport[3] + mViewport[1]);
+    }
+
+    void translateImguiToBoxel(float inX, float inY, int &outX, int &outY) const
+    {
+        outX = (int)(mLeft + inX);
+        outY = (int)(mTop - inY);
+    }
+};
+
+/** Per-command scissor computation, returns number of draw calls, sums up the boxes to keep the optimizer honest */
+static unsigned long legacyPass(const LegacyView& view, const ImDrawData& dd, long& checksum)
+{
+    unsigned long draws = 0;
+    for (int n = 0; n < dd.CmdListsCount; n++) {
+        const ImDrawList* cmd_list = dd.CmdLists[n];
+        for (const ImDrawCmd& cmd: cmd_list->CmdBuffer) {
+            if (cmd.UserCallback)
+                continue;
+            int bTop, bLeft, bRight, bBottom;
+            view.translateImguiToBoxel(cmd.ClipRect.x, cmd.ClipRect.y, bLeft, bTop);
+            view.translateImguiToBoxel(cmd.ClipRect.z, cmd.ClipRect.w, bRight, bBottom);
+            int nTop, nLeft, nRight, nBottom;
+            view.boxelsToNative(bLeft, bTop, nLeft, nTop);
+            view.boxelsToNative(bRight, bBottom, nRight, nBottom);
+            checksum += nLeft + nBottom + (nRight-nLeft) + (nTop-nBottom);
+            draws++;
+        }
+    }
+    return draws;
+}
+
+int main (int argc, char* argv[])
+{
+    const int rows       = argc > 1 ? std::atoi(argv[1]) : 200;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 20000;
+
+    // Headless ImGui: a font atlas is needed, but no texture upload
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(float(WND_W), float(WND_H));
+    io.DeltaTime = 1.0f / 60.0f;
+    unsigned char* pixels = nullptr;
+    int texW = 0, texH = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &texW, &texH);
+    io.Fonts->SetTexID((ImTextureID)(intptr_t)1);
+
+    // A few frames to settle table layout, then record the last one
+    for (int i = 0; i < 3; i++) {
+        ImGui::NewFrame();
+        buildTableWindow(rows);
+        ImGui::Render();
+    }
+    RecordedFrame frame(*ImGui::GetDrawData());
+
+    // X-Plane-like view: identity modelview, orthographic projection over the screen
+    LegacyView view = {};
+    view.mModelView[0] = view.mModelView[5] = view.mModelView[10] = view.mModelView[15] = 1.0f;
+    view.mProjection[0]  =  2.0f / SCREEN_W;
+    view.mProjection[5]  =  2.0f / SCREEN_H;
+    view.mProjection[10] = -1.0f;
+    view.mProjection[12] = -1.0f;
+    view.mProjection[13] = -1.0f;
+    view.mProjection[15] =  1.0f;
+    view.mViewport[2] = SCREEN_W;
+    view.mViewport[3] = SCREEN_H;
+    view.mLeft = WND_LEFT;
+    view.mTop  = WND_TOP;
+
+    typedef std::chrono::steady_clock clk;
+    long checksum = 0;
+
+    // Legacy: per command
+    unsigned long legacyDraws = 0;
+    clk::time_point t0 = clk::now();
+    for (int i = 0; i < iterations; i++)
+        legacyDraws = legacyPass(view, frame.drawData, checksum);
+    const double legacyUs = std::chrono::duration<double, std::micro>(clk::now() - t0).count() / iterations;
+
+    // Batched: one transform per frame, clip rects in one go, merged commands
+    ImgDrawBatcher batcher;
+    t0 = clk::now();
+    for (int i = 0; i < iterations; i++) {
+        const ImgClipTransform xform =
+            ImgClipTransform::fromView(view.mModelView, view.mProjection, view.mViewport, view.mLeft, view.mTop);
+        batcher.build(&frame.drawData, xform);
+        checksum += long(batcher.batches().size());
+    }
+    const double batchUs = std::chrono::duration<double, std::micro>(clk::now() - t0).count() / iterations;
+    const ImgDrawBatcher::Stats& stats = batcher.getStats();
+
+    std::printf("Recorded frame: %d rows, %d draw lists, %d vertices, %d indices, %lu commands\n",
+                rows, frame.drawData.CmdListsCount, frame.drawData.TotalVtxCount,
+                frame.drawData.TotalIdxCount, stats.commands);
+    std::printf("%-10s %12s %14s\n", "", "draw calls", "CPU us/frame");
+    std::printf("%-10s %12lu %14.3f\n", "legacy", legacyDraws, legacyUs);
+    std::printf("%-10s %12lu %14.3f   (%lu culled)\n", "batched", stats.batches, batchUs, stats.culled);
+    std::printf("(checksum %ld)\n", checksum);
+
+    ImGui::DestroyContext();
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * ImgWindowBench.cpp
+ *
+ * Integration for dear imgui into X-Plane: Headless Window Benchmark
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Runs the plugin without X-Plane: XPLMStub stands in for the sim and
+ * HeadlessGL provides an offscreen (software) GL context.  The plugin is
+ * started and enabled as X-Plane would, more windows are opened through
+ * its menu, then a number of frames is rendered while synthetic input
+ * is fed to the first window.  Reports CPU time per frame.
+ *
+ * Usage: ImgWindowBench [options]
+ *   --frames N      frames to measure (default 600)
+ *   --warmup N      frames to run before measuring (default 60)
+ *   --windows N     number of windows to open (default 1)
+ *   --size WxH      screen size (default 1920x1080)
+ *   --input LIST    synthetic input, comma-separated of: none, move, scroll, click, keys (default move)
+ *   --menu N        select item N of the plugin's menu before measuring (repeatable)
+ *   --finish        include glFinish() in the measured time (adds the GPU/llvmpipe rendering)
+ *   --font-rebuild N  change the font size every N frames (rebuilds the atlas in the background,
+ *                     or just rescales distance field fonts)
+ *   --root DIR      X-Plane root folder with Resources/fonts (default: set by CMake)
+ *   --csv FILE      write per-frame times to FILE
+ *   --ppm FILE      write the last frame to FILE
+ */
+
+#include "HeadlessGL.h"
+#include "XPLMStub.h"
+
+#include "XPLMDefs.h"
+#include "XPLMDisplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#ifndef FLIGHTMAX_BENCH_ROOT
+#define FLIGHTMAX_BENCH_ROOT "."
+#endif
+
+// The plugin's entry points
+PLUGIN_API int  XPluginStart (char* outName, char* outSig, char* outDesc);
+PLUGIN_API void XPluginStop ();
+PLUGIN_API int  XPluginEnable ();
+PLUGIN_API void XPluginDisable ();
+// The starter window's font size control
+void changeFontSize (float fontSize);
+
+/// Sim frame period we pretend to run at
+constexpr float FRAME_PERIOD = 1.0f / 60.0f;
+/// Index of "Add Window (solid)" in the plugin's menu
+constexpr int MENU_ADD_WINDOW = 1;
+
+/** Command line options */
+struct OptionsTy {
+    int         frames      = 600;
+    int         warmup      = 60;
+    int         windows     = 1;
+    int         width       = 1920;
+    int         height      = 1080;
+    bool        bMove       = true;
+    bool        bScroll     = false;
+    bool        bClick      = false;
+    bool        bKeys       = false;
+    bool        bFinish     = false;
+    int         fontRebuild = 0;
+    std::vector<int> menuItems;
+    std::string root        = FLIGHTMAX_BENCH_ROOT;
+    std::string csvFile;
+    std::string ppmFile;
+};
+
+static bool parseOptions (int argc, char* argv[], OptionsTy& opt)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string a = argv[i];
+        const char* val = i + 1 < argc ? argv[i+1] : nullptr;
+        if (a == "--finish") { opt.bFinish = true; continue; }
+        if (!val) {
+            std::fprintf(stderr, "Missing value for %s\n", a.c_str());
+            return false;
+        }
+        i++;
+        if      (a == "--frames")   opt.frames  = std::max(1, std::atoi(val));
+        else if (a == "--warmup")   opt.warmup  = std::max(0, std::atoi(val));
+        else if (a == "--windows")  opt.windows = std::max(1, std::atoi(val));
+        else if (a == "--menu")     opt.menuItems.push_back(std::atoi(val));
+        else if (a == "--font-rebuild") opt.fontRebuild = std::max(0, std::atoi(val));
+        else if (a == "--root")     opt.root    = val;
+        else if (a == "--csv")      opt.csvFile = val;
+        else if (a == "--ppm")      opt.ppmFile = val;
+        else if (a == "--size") {
+            if (std::sscanf(val, "%dx%d", &opt.width, &opt.height) != 2 ||
+                opt.width <= 0 || opt.height <= 0) {
+                std::fprintf(stderr, "Invalid size %s\n", val);
+                return false;
+            }
+        }
+        else if (a == "--input") {
+            const std::string in = std::string(",") + val + ",";
+            opt.bMove   = in.find(",move,")   != std::string::npos;
+            opt.bScroll = in.find(",scroll,") != std::string::npos;
+            opt.bClick  = in.find(",click,")  != std::string::npos;
+            opt.bKeys   = in.find(",keys,")   != std::string::npos;
+        }
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", a.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Feed this frame's synthetic input to the first window */
+static void syntheticInput (const OptionsTy& opt, int frame)
+{
+    int left, top, right, bottom;
+    if (!XPLMStub::WindowGeometry(0, left, top, right, bottom))
+        return;
+    // Circle around the center of the window's content
+    const float angle = float(frame) * 0.05f;
+    const int cx = (left + right) / 2, cy = (top + bottom) / 2;
+    const int x = cx + int(std::cos(angle) * float(right - left) / 4.0f);
+    const int y = cy + int(std::sin(angle) * float(top - bottom) / 4.0f);
+
+    if (opt.bMove)
+        XPLMStub::MouseMove(x, y);
+    if (opt.bScroll && frame % 10 == 0)
+        XPLMStub::MouseWheel(x, y, 0, (frame / 100) % 2 ? 1 : -1);
+    if (opt.bClick && frame % 30 == 0) {
+        XPLMStub::MouseButton(x, y, xplm_MouseDown);
+        XPLMStub::MouseButton(x, y, xplm_MouseUp);
+    }
+    if (opt.bKeys && frame % 5 == 0) {
+        const char c = char('a' + frame / 5 % 26);
+        XPLMStub::Key(c, xplm_DownFlag, char(c - 'a' + XPLM_VK_A));
+        XPLMStub::Key(c, xplm_UpFlag,   char(c - 'a' + XPLM_VK_A));
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    OptionsTy opt;
+    if (!parseOptions(argc, argv, opt))
+        return 1;
+
+    // The plugin loads its resources relative to X-Plane's root
+    if (chdir(opt.root.c_str()) != 0) {
+        std::fprintf(stderr, "Cannot change to root folder %s\n", opt.root.c_str());
+        return 1;
+    }
+    XPLMStub::SetSystemPath((opt.root + "/").c_str());
+    XPLMStub::Init(opt.width, opt.height);
+
+    HeadlessGL gl;
+    if (!gl.Init(opt.width, opt.height)) {
+        std::fprintf(stderr, "OpenGL: %s\n", gl.GetError().c_str());
+        return 1;
+    }
+    std::printf("Renderer:  %s\n", gl.GetRenderer().c_str());
+
+    // Start the plugin just like X-Plane does
+    char name[256], sig[256], desc[256];
+    if (!XPluginStart(name, sig, desc)) {
+        std::fprintf(stderr, "Plugin failed to start\n");
+        return 1;
+    }
+    const auto tEnable = std::chrono::steady_clock::now();
+    if (!XPluginEnable()) {
+        std::fprintf(stderr, "Plugin failed to enable\n");
+        return 1;
+    }
+    std::printf("Plugin:    %s\n", name);
+    std::printf("Enable:    %.3f ms\n", std::chrono::duration<double, std::milli>
+                (std::chrono::steady_clock::now() - tEnable).count());
+    for (int i = 1; i < opt.windows; i++)
+        XPLMStub::SelectMenuItem(XPLMStub::PluginMenu(), MENU_ADD_WINDOW);
+    for (int item: opt.menuItems)
+        XPLMStub::SelectMenuItem(XPLMStub::PluginMenu(), item);
+
+    // Warm up: font atlas upload, first layouts, caches
+    for (int f = 0; f < opt.warmup; f++) {
+        gl.BeginFrame();
+        syntheticInput(opt, f);
+        XPLMStub::RunFrame(FRAME_PERIOD);
+    }
+    gl.Finish();
+
+    // Measure
+    std::vector<double> ms;
+    ms.reserve(size_t(opt.frames));
+    for (int f = 0; f < opt.frames; f++) {
+        gl.BeginFrame();
+        syntheticInput(opt, opt.warmup + f);
+        const auto t0 = std::chrono::steady_clock::now();
+        if (opt.fontRebuild > 0 && f % opt.fontRebuild == 0)
+            changeFontSize((f / opt.fontRebuild) % 2 ? 15.0f : 18.0f);
+        XPLMStub::RunFrame(FRAME_PERIOD);
+        if (opt.bFinish)
+            gl.Finish();
+        const auto t1 = std::chrono::steady_clock::now();
+        ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    gl.Finish();
+
+    if (!opt.ppmFile.empty() && !gl.WritePPM(opt.ppmFile))
+        std::fprintf(stderr, "Could not write %s\n", opt.ppmFile.c_str());
+    if (!opt.csvFile.empty()) {
+        if (std::FILE* f = std::fopen(opt.csvFile.c_str(), "w")) {
+            std::fprintf(f, "frame,cpu_ms\n");
+            for (size_t i = 0; i < ms.size(); i++)
+                std::fprintf(f, "%lu,%.4f\n", (unsigned long)i, ms[i]);
+            std::fclose(f);
+        }
+        else
+            std::fprintf(stderr, "Could not write %s\n", opt.csvFile.c_str());
+    }
+
+    // Report
+    std::vector<double> sorted = ms;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double v: ms) sum += v;
+    const auto pct = [&sorted](double p)
+    { return sorted[std::min(sorted.size() - 1, size_t(p * double(sorted.size())))]; };
+    std::printf("Windows:   %d, %dx%d, %d frames%s\n", XPLMStub::NumWindows(),
+                opt.width, opt.height, opt.frames, opt.bFinish ? " (incl. glFinish)" : "");
+    std::printf("CPU ms/frame: min %.3f  avg %.3f  p50 %.3f  p99 %.3f  max %.3f\n",
+                sorted.front(), sum / double(ms.size()), pct(0.50), pct(0.99), sorted.back());
+
+    // Shut down like X-Plane, the plugin should leave no windows behind
+    XPluginDisable();
+    XPluginStop();
+    if (XPLMStub::NumWindows() > 0) {
+        std::fprintf(stderr, "%d window(s) left after XPluginDisable\n", XPLMStub::NumWindows());
+        return 2;
+    }
+    return 0;
+}
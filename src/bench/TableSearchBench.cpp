@@ -0,0 +1,259 @@
+/*
+ * TableSearchBench.cpp
+ *
+ * Integration for dear imgui into X-Plane: Traffic Table Search Benchmark
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Host-only benchmark, doesn't need X-Plane: Generates a registry-sized
+ * traffic table, then searches it for a few filter texts the way
+ * tableDataTy::contains() used to (upper-cased copies of each text and
+ * std::string::find), with each TextSearch kernel scanning all texts packed
+ * into one buffer, and through TableSearchIndex. Reports milliseconds per
+ * search over all rows. Then compares the memory the rows take and the time
+ * sorting them by owner takes as std::string rows and in a TrafficStore,
+ * which interns the texts in StringPool.
+ *
+ * Usage: TableSearchBench [rows] [iterations]
+ */
+
+#include "FlightMAX_string_pool.h"
+#include "FlightMAX_table_search.h"
+#include "FlightMAX_text_search.h"
+#include "FlightMAX_traffic_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/** The texts of a table row, as in ImguiWidget::tableDataTy */
+struct Row {
+    std::string     reg;
+    std::string     model;
+    std::string     typecode;
+    std::string     owner;
+};
+
+/** Deterministic pseudo-random numbers, same table on every run */
+struct Rand {
+    unsigned long long s = 88172645463325252ull;
+    unsigned operator() (unsigned n)
+    {
+        s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+        return unsigned(s % n);
+    }
+};
+
+static std::vector<Row> makeTable(size_t rows)
+{
+    static const char* MODELS[] = {
+        "Cessna 172 SP Skyhawk", "Boeing 737-800", "Airbus A320-232", "Citation Excel", "SR22T",
+        "DHC-8-402", "EC135T1", "R44 II", "AS 350 B2", "Sukhoi Superjet 100-95LR", "G-IV", "PA-28-181 Archer",
+    };
+    static const char* TYPES[] = { "C172", "B738", "A320", "C56X", "S22T", "DH8D", "EC35", "R44", "AS50", "SU95", "GLF4", "P28A" };
+    static const char* OWNER_WORDS[] = {
+        "Aircraft", "Guaranty", "Corp", "Trustee", "Wilmington", "Trust", "Air", "Med", "Services", "Llc",
+        "Helicopters", "Inc", "Danish", "Transport", "Castle", "Horizon", "Industries", "Sundance", "Bank", "Leasing",
+    };
+    Rand rnd;
+    std::vector<Row> table(rows);
+    for (Row& r: table) {
+        char reg[16];
+        std::snprintf(reg, sizeof(reg), "N%u%c%c", 1 + rnd(9999), char('A' + rnd(26)), char('A' + rnd(26)));
+        const unsigned m = rnd(12);
+        r.reg       = reg;
+        r.model     = MODELS[m];
+        r.typecode  = TYPES[m];
+        r.owner     = std::string(OWNER_WORDS[rnd(20)]) + ' ' + OWNER_WORDS[rnd(20)] + ' ' + OWNER_WORDS[rnd(20)];
+    }
+    return table;
+}
+
+/** What tableDataTy::contains() used to do, `s` is upper case */
+static bool legacyContains(const Row& r, const std::string& s)
+{
+    for (const std::string& t: {r.reg, r.model, r.typecode, r.owner}) {
+        std::string l = t;
+        std::for_each(l.begin(), l.end(), [](char& c) { c = char(toupper(c)); });
+        if (l.find(s) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+/** All texts in one buffer, like TableSearchIndex keeps them */
+struct PackedTable {
+    std::string         text;
+    std::vector<size_t> rowStart;
+
+    explicit PackedTable (const std::vector<Row>& table)
+    {
+        rowStart.push_back(0);
+        for (const Row& r: table) {
+            for (const std::string* t: {&r.reg, &r.model, &r.typecode, &r.owner})
+                (text += *t) += '\x1f';
+            rowStart.push_back(text.size());
+        }
+    }
+
+    /** Rows containing `s`, scanning all text in one go */
+    size_t count(const std::string& s) const
+    {
+        size_t n = 0, pos = 0, row = 0;
+        while (const char* match = TextSearch::findNoCase(text.data() + pos, text.size() - pos, s.data(), s.size())) {
+            const size_t at = size_t(match - text.data());
+            row = size_t(std::upper_bound(rowStart.begin() + std::ptrdiff_t(row) + 1, rowStart.end(), at) -
+                         rowStart.begin()) - 1;
+            n++;
+            pos = rowStart[row+1];
+        }
+        return n;
+    }
+};
+
+int main (int argc, char* argv[])
+{
+    const size_t rows     = argc > 1 ? size_t(std::atol(argv[1])) : 100000;
+    const int iterations  = argc > 2 ? std::atoi(argv[2]) : 20;
+    const std::vector<std::string> filters = { "N1", "TRUST", "WILMINGTON TRUST", "B738", "XYZ", "A" };
+
+    typedef std::chrono::steady_clock clk;
+    const std::vector<Row> table = makeTable(rows);
+    const PackedTable packed(table);
+
+    clk::time_point t0 = clk::now();
+    TableSearchIndex index;
+    index.build(table.size(), [&table](size_t i, std::vector<const char*>& texts)
+    {
+        texts.insert(texts.end(), { table[i].reg.c_str(), table[i].model.c_str(),
+                                    table[i].typecode.c_str(), table[i].owner.c_str() });
+    });
+    const double buildMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count();
+    t0 = clk::now();
+    index.indexTrigrams();
+    const double trigramMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count();
+
+    std::printf("%zu rows, %.1f MB of text, index built in %.1f ms + %.1f ms for the trigrams, best kernel %s\n",
+                rows, double(packed.text.size()) / 1e6, buildMs, trigramMs,
+                TextSearch::kernelName(TextSearch::bestKernel()));
+    std::printf("%-18s %8s %10s %10s %10s %10s %10s\n", "ms per search", "rows",
+                "legacy", "scalar", "SSE2", "AVX2", "index");
+
+    bool bMismatch = false;
+    for (const std::string& f: filters) {
+        // legacy
+        size_t legacyRows = 0;
+        t0 = clk::now();
+        for (int i = 0; i < iterations; i++) {
+            legacyRows = 0;
+            for (const Row& r: table)
+                legacyRows += legacyContains(r, f) ? 1 : 0;
+        }
+        const double legacyMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count() / iterations;
+
+        // each kernel over the packed text
+        double kernelMs[3] = { -1.0, -1.0, -1.0 };
+        for (int k = TextSearch::KERNEL_SCALAR; k <= TextSearch::KERNEL_AVX2; k++) {
+            if (!TextSearch::setKernel(TextSearch::Kernel(k)))
+                continue;
+            size_t n = 0;
+            t0 = clk::now();
+            for (int i = 0; i < iterations; i++)
+                n = packed.count(f);
+            kernelMs[k] = std::chrono::duration<double, std::milli>(clk::now() - t0).count() / iterations;
+            bMismatch |= n != legacyRows;
+        }
+        TextSearch::setKernel(TextSearch::bestKernel());
+
+        // the index, as if typed anew each time
+        size_t indexRows = 0;
+        t0 = clk::now();
+        for (int i = 0; i < iterations; i++) {
+            index.find("");
+            indexRows = index.find(f.c_str()).size();
+        }
+        const double indexMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count() / iterations;
+        bMismatch |= indexRows != legacyRows;
+
+        std::printf("%-18s %8zu %10.3f", ('"' + f + '"').c_str(), legacyRows, legacyMs);
+        for (double ms: kernelMs) {
+            if (ms < 0.0)
+                std::printf(" %10s", "n/a");
+            else
+                std::printf(" %10.3f", ms);
+        }
+        std::printf(" %10.3f\n", indexMs);
+    }
+
+    // Memory: the strings' own heap blocks count with their capacity, not with malloc's overhead
+    size_t stringBytes = table.capacity() * sizeof(Row);
+    for (const Row& r: table)
+        for (const std::string* t: {&r.reg, &r.model, &r.typecode, &r.owner})
+            if (t->data() < (const char*)t || t->data() >= (const char*)(t + 1))
+                stringBytes += t->capacity() + 1;
+    TrafficStore traffic;
+    for (const Row& r: table)
+        traffic.add(r.reg.c_str(), r.model.c_str(), r.typecode.c_str(), r.owner.c_str(), 0.0f, false);
+    const size_t storeBytes = traffic.bytesUsed();
+    const size_t poolBytes = StringPool::get().bytesUsed();
+    std::printf("\nmemory: std::string rows %.1f MB, TrafficStore %.1f MB + StringPool %.1f MB (%zu strings)\n",
+                double(stringBytes) / 1e6, double(storeBytes) / 1e6, double(poolBytes) / 1e6,
+                StringPool::get().size());
+
+    // Sorting by owner: comparing strings vs. comparing ranks
+    std::vector<size_t> byOwner(table.size());
+    std::iota(byOwner.begin(), byOwner.end(), size_t(0));
+    t0 = clk::now();
+    std::sort(byOwner.begin(), byOwner.end(), [&table](size_t a, size_t b)
+    {
+        const int cmp = std::strcmp(table[a].owner.c_str(), table[b].owner.c_str());
+        return cmp != 0 ? cmp < 0 : a < b;
+    });
+    const double stringSortMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count();
+    t0 = clk::now();
+    StringPool::get().ranks();
+    const double rankMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count();
+    t0 = clk::now();
+    traffic.sort(TrafficStore::COL_OWNER, true);
+    const double storeSortMs = std::chrono::duration<double, std::milli>(clk::now() - t0).count();
+    bMismatch |= byOwner != traffic.order();
+    std::printf("sort by owner: std::string rows %.1f ms, TrafficStore %.1f ms (+ %.1f ms ranking new strings)\n",
+                stringSortMs, storeSortMs, rankMs);
+
+    if (bMismatch)
+        std::printf("MISMATCH: the searches or sorts found different rows\n");
+    return bMismatch ? 1 : 0;
+}
@@ -0,0 +1,588 @@
+/*
+ * XPLMStub.cpp
+ *
+ * Integration for dear imgui into X-Plane: Headless XPLM Stand-In
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "XPLMStub.h"
+
+#include "XPLMDataAccess.h"
+#include "XPLMGraphics.h"
+#include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
+
+#include "SystemGL.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** A window as created by XPLMCreateWindowEx */
+struct StubWindow {
+    XPLMCreateWindow_t  params;             ///< as passed in, geometry kept up to date
+    bool                bVisible = false;
+    int                 creationNr = 0;     ///< order of creation
+};
+
+/** A flight loop as created by XPLMCreateFlightLoop */
+struct StubFlightLoop {
+    XPLMCreateFlightLoop_t params;
+    bool                bScheduled  = false;
+    bool                bByCycles   = false;    ///< next call due by cycle number (else by time)
+    double              nextTime    = 0.0;
+    int                 nextCycle   = 0;
+    double              lastCallTime = 0.0;
+    int                 counter     = 0;
+};
+
+/** A dataref: fixed values only */
+struct StubDataRef {
+    int                 i = 0;
+    float               f = 0.0f;
+    std::vector<float>  vf;
+    std::vector<int>    vi;
+};
+
+/** A menu: its handler and item refs */
+struct StubMenu {
+    XPLMMenuHandler_f       handler = nullptr;
+    void*                   menuRef = nullptr;
+    std::vector<void*>      itemRefs;
+};
+
+int     gScreenW    = 1920;
+int     gScreenH    = 1080;
+double  gElapsed    = 0.0;                  ///< XPLMGetElapsedTime
+double  gLastFrameTime = 0.0;               ///< time of previous frame
+int     gCycle      = 0;                    ///< XPLMGetCycleNumber
+int     gCreationNr = 0;
+std::string gSystemPath = "./";
+
+/** All windows, bottom to top */
+std::vector<std::unique_ptr<StubWindow>>        gWindows;
+std::vector<std::unique_ptr<StubFlightLoop>>    gFlightLoops;
+std::map<std::string, StubDataRef>              gDataRefs;
+std::vector<std::unique_ptr<StubMenu>>          gMenus;
+XPLMWindowID    gKeyboardFocus  = nullptr;
+XPLMWindowID    gMouseCapture   = nullptr;  ///< window which received mouse down
+
+StubWindow* findWindow (XPLMWindowID id)
+{
+    for (std::unique_ptr<StubWindow>& w: gWindows)
+        if (w.get() == id)
+            return w.get();
+    return nullptr;
+}
+
+StubFlightLoop* findFlightLoop (XPLMFlightLoopID id)
+{
+    for (std::unique_ptr<StubFlightLoop>& fl: gFlightLoops)
+        if (fl.get() == id)
+            return fl.get();
+    return nullptr;
+}
+
+/** Topmost visible window containing the point */
+StubWindow* windowAt (int x, int y)
+{
+    for (auto it = gWindows.rbegin(); it != gWindows.rend(); ++it) {
+        const XPLMCreateWindow_t& p = (*it)->params;
+        if ((*it)->bVisible &&
+            p.left <= x && x < p.right && p.bottom <= y && y < p.top)
+            return it->get();
+    }
+    return nullptr;
+}
+
+/** Column-major orthographic projection covering the screen */
+void orthoMatrix (float* m, float w, float h)
+{
+    std::fill(m, m + 16, 0.0f);
+    m[0]  =  2.0f / w;
+    m[5]  =  2.0f / h;
+    m[10] = -1.0f;
+    m[12] = -1.0f;
+    m[13] = -1.0f;
+    m[15] =  1.0f;
+}
+
+}
+
+//
+// MARK: Harness control
+//
+
+void XPLMStub::Init (int screenWidth, int screenHeight)
+{
+    gScreenW = screenWidth;
+    gScreenH = screenHeight;
+
+    StubDataRef& mv = gDataRefs["sim/graphics/view/modelview_matrix"];
+    mv.vf.assign(16, 0.0f);
+    mv.vf[0] = mv.vf[5] = mv.vf[10] = mv.vf[15] = 1.0f;
+    StubDataRef& proj = gDataRefs["sim/graphics/view/projection_matrix"];
+    proj.vf.assign(16, 0.0f);
+    orthoMatrix(proj.vf.data(), float(gScreenW), float(gScreenH));
+    gDataRefs["sim/graphics/view/viewport"].vi = { 0, 0, gScreenW, gScreenH };
+    gDataRefs["sim/graphics/VR/enabled"].i = 0;
+    gDataRefs["sim/operation/misc/frame_rate_period"].f = 1.0f / 60.0f;
+}
+
+void XPLMStub::RunFrame (float period)
+{
+    gElapsed += double(period);
+    gCycle++;
+    gDataRefs["sim/operation/misc/frame_rate_period"].f = period;
+
+    // Flight loops: callbacks may create or destroy flight loops, so work on a copy of the list
+    std::vector<StubFlightLoop*> loops;
+    for (std::unique_ptr<StubFlightLoop>& fl: gFlightLoops)
+        loops.push_back(fl.get());
+    for (StubFlightLoop* p: loops) {
+        StubFlightLoop* fl = findFlightLoop(p);
+        if (!fl || !fl->bScheduled ||
+            (fl->bByCycles ? gCycle < fl->nextCycle : gElapsed < fl->nextTime))
+            continue;
+        const float next = fl->params.callbackFunc(float(gElapsed - fl->lastCallTime),
+                                                   float(gElapsed - gLastFrameTime),
+                                                   ++fl->counter, fl->params.refcon);
+        if (!(fl = findFlightLoop(p)))                      // destroyed itself
+            continue;
+        fl->lastCallTime = gElapsed;
+        XPLMScheduleFlightLoop(fl, next, 1);
+    }
+    gLastFrameTime = gElapsed;
+
+    // Windows, bottom to top
+    std::vector<StubWindow*> wnds;
+    for (std::unique_ptr<StubWindow>& w: gWindows)
+        wnds.push_back(w.get());
+    for (StubWindow* p: wnds) {
+        StubWindow* w = findWindow(p);
+        if (w && w->bVisible && w->params.drawWindowFunc)
+            w->params.drawWindowFunc(w, w->params.refcon);
+    }
+}
+
+void XPLMStub::MouseMove (int x, int y)
+{
+    StubWindow* w = gMouseCapture ? findWindow(gMouseCapture) : windowAt(x, y);
+    if (!w)
+        return;
+    if (gMouseCapture)
+        w->params.handleMouseClickFunc(w, x, y, xplm_MouseDrag, w->params.refcon);
+    else if (w->params.handleCursorFunc)
+        w->params.handleCursorFunc(w, x, y, w->params.refcon);
+}
+
+void XPLMStub::MouseButton (int x, int y, XPLMMouseStatus status)
+{
+    StubWindow* w = nullptr;
+    if (status == xplm_MouseDown) {
+        w = windowAt(x, y);
+        gMouseCapture = w;
+        // A click moves keyboard focus away from other windows
+        if (gKeyboardFocus != w)
+            gKeyboardFocus = nullptr;
+    }
+    else {
+        w = findWindow(gMouseCapture);
+        if (status == xplm_MouseUp)
+            gMouseCapture = nullptr;
+    }
+    if (w && w->params.handleMouseClickFunc)
+        w->params.handleMouseClickFunc(w, x, y, status, w->params.refcon);
+}
+
+void XPLMStub::MouseWheel (int x, int y, int wheel, int clicks)
+{
+    StubWindow* w = windowAt(x, y);
+    if (w && w->params.handleMouseWheelFunc)
+        w->params.handleMouseWheelFunc(w, x, y, wheel, clicks, w->params.refcon);
+}
+
+void XPLMStub::Key (char key, XPLMKeyFlags flags, char virtualKey)
+{
+    StubWindow* w = findWindow(gKeyboardFocus);
+    if (w && w->params.handleKeyFunc)
+        w->params.handleKeyFunc(w, key, flags, virtualKey, w->params.refcon, 0);
+}
+
+void XPLMStub::SelectMenuItem (XPLMMenuID menu, int index)
+{
+    StubMenu* m = static_cast<StubMenu*>(menu);
+    if (m && m->handler && index >= 0 && index < int(m->itemRefs.size()))
+        m->handler(m->menuRef, m->itemRefs[size_t(index)]);
+}
+
+XPLMMenuID XPLMStub::PluginMenu ()
+{
+    return gMenus.size() > 1 ? gMenus[1].get() : nullptr;  // [0] is the "Plugins" menu
+}
+
+int XPLMStub::NumWindows ()
+{
+    return int(gWindows.size());
+}
+
+int XPLMStub::NumFlightLoops ()
+{
+    return int(gFlightLoops.size());
+}
+
+bool XPLMStub::WindowGeometry (int n, int& left, int& top, int& right, int& bottom)
+{
+    // gWindows is in z order, find by creation order
+    std::vector<StubWindow*> wnds;
+    for (std::unique_ptr<StubWindow>& w: gWindows)
+        wnds.push_back(w.get());
+    std::sort(wnds.begin(), wnds.end(), [](StubWindow* a, StubWindow* b)
+              { return a->creationNr < b->creationNr; });
+    if (n < 0 || n >= int(wnds.size()))
+        return false;
+    XPLMGetWindowGeometry(wnds[size_t(n)], &left, &top, &right, &bottom);
+    return true;
+}
+
+void XPLMStub::SetSystemPath (const char* path)
+{
+    gSystemPath = path;
+}
+
+//
+// MARK: XPLMDisplay
+//
+
+XPLMWindowID XPLMCreateWindowEx (XPLMCreateWindow_t* inParams)
+{
+    gWindows.emplace_back(new StubWindow());
+    StubWindow* w = gWindows.back().get();
+    w->params       = *inParams;
+    w->bVisible     = inParams->visible != 0;
+    w->creationNr   = gCreationNr++;
+    return w;
+}
+
+void XPLMDestroyWindow (XPLMWindowID inWindowID)
+{
+    if (gKeyboardFocus == inWindowID) gKeyboardFocus = nullptr;
+    if (gMouseCapture == inWindowID)  gMouseCapture = nullptr;
+    gWindows.erase(std::remove_if(gWindows.begin(), gWindows.end(),
+                                  [inWindowID](const std::unique_ptr<StubWindow>& w)
+                                  { return w.get() == inWindowID; }),
+                   gWindows.end());
+}
+
+void XPLMGetWindowGeometry (XPLMWindowID inWindowID, int* outLeft, int* outTop, int* outRight, int* outBottom)
+{
+    const StubWindow* w = findWindow(inWindowID);
+    if (!w) return;
+    if (outLeft)    *outLeft    = w->params.left;
+    if (outTop)     *outTop     = w->params.top;
+    if (outRight)   *outRight   = w->params.right;
+    if (outBottom)  *outBottom  = w->params.bottom;
+}
+
+void XPLMSetWindowGeometry (XPLMWindowID inWindowID, int inLeft, int inTop, int inRight, int inBottom)
+{
+    StubWindow* w = findWindow(inWindowID);
+    if (!w) return;
+    w->params.left      = inLeft;
+    w->params.top       = inTop;
+    w->params.right     = inRight;
+    w->params.bottom    = inBottom;
+}
+
+void XPLMGetWindowGeometryOS (XPLMWindowID inWindowID, int* outLeft, int* outTop, int* outRight, int* outBottom)
+{
+    XPLMGetWindowGeometry(inWindowID, outLeft, outTop, outRight, outBottom);
+}
+
+void XPLMSetWindowGeometryOS (XPLMWindowID inWindowID, int inLeft, int inTop, int inRight, int inBottom)
+{
+    XPLMSetWindowGeometry(inWindowID, inLeft, inTop, inRight, inBottom);
+}
+
+void XPLMGetWindowGeometryVR (XPLMWindowID inWindowID, int* outWidthBoxels, int* outHeightBoxels)
+{
+    int left = 0, top = 0, right = 0, bottom = 0;
+    XPLMGetWindowGeometry(inWindowID, &left, &top, &right, &bottom);
+    if (outWidthBoxels)     *outWidthBoxels  = right - left;
+    if (outHeightBoxels)    *outHeightBoxels = top - bottom;
+}
+
+void XPLMSetWindowGeometryVR (XPLMWindowID inWindowID, int widthBoxels, int heightBoxels)
+{
+    int left = 0, top = 0, right = 0, bottom = 0;
+    XPLMGetWindowGeometry(inWindowID, &left, &top, &right, &bottom);
+    XPLMSetWindowGeometry(inWindowID, left, top, left + widthBoxels, top - heightBoxels);
+}
+
+int  XPLMWindowIsPoppedOut (XPLMWindowID)                   { return 0; }
+int  XPLMWindowIsInVR (XPLMWindowID)                        { return 0; }
+void XPLMSetWindowPositioningMode (XPLMWindowID, XPLMWindowPositioningMode, int) {}
+void XPLMSetWindowResizingLimits (XPLMWindowID, int, int, int, int) {}
+void XPLMSetWindowTitle (XPLMWindowID, const char*)         {}
+
+void XPLMBringWindowToFront (XPLMWindowID inWindowID)
+{
+    auto it = std::find_if(gWindows.begin(), gWindows.end(),
+                           [inWindowID](const std::unique_ptr<StubWindow>& w)
+                           { return w.get() == inWindowID; });
+    if (it != gWindows.end())
+        std::rotate(it, it + 1, gWindows.end());
+}
+
+int XPLMIsWindowInFront (XPLMWindowID inWindowID)
+{
+    return !gWindows.empty() && gWindows.back().get() == inWindowID;
+}
+
+int XPLMHasKeyboardFocus (XPLMWindowID inWindowID)
+{
+    return inWindowID && gKeyboardFocus == inWindowID;
+}
+
+void XPLMTakeKeyboardFocus (XPLMWindowID inWindowID)
+{
+    // Losing focus is reported to the window which had it
+    StubWindow* prev = findWindow(gKeyboardFocus);
+    gKeyboardFocus = inWindowID;
+    if (prev && prev != inWindowID && prev->params.handleKeyFunc)
+        prev->params.handleKeyFunc(prev, 0, 0, 0, prev->params.refcon, 1);
+}
+
+void XPLMSetWindowIsVisible (XPLMWindowID inWindowID, int inIsVisible)
+{
+    if (StubWindow* w = findWindow(inWindowID))
+        w->bVisible = inIsVisible != 0;
+}
+
+int XPLMGetWindowIsVisible (XPLMWindowID inWindowID)
+{
+    const StubWindow* w = findWindow(inWindowID);
+    return w && w->bVisible;
+}
+
+void XPLMGetScreenBoundsGlobal (int* outLeft, int* outTop, int* outRight, int* outBottom)
+{
+    if (outLeft)    *outLeft    = 0;
+    if (outTop)     *outTop     = gScreenH;
+    if (outRight)   *outRight   = gScreenW;
+    if (outBottom)  *outBottom  = 0;
+}
+
+//
+// MARK: XPLMGraphics
+//
+
+void XPLMSetGraphicsState (int inEnableFog, int inNumberTexUnits, int inEnableLighting,
+                           int inEnableAlphaTesting, int inEnableAlphaBlending,
+                           int inEnableDepthTesting, int inEnableDepthWriting)
+{
+    if (inEnableFog)            glEnable(GL_FOG);         else glDisable(GL_FOG);
+    if (inNumberTexUnits > 0)   glEnable(GL_TEXTURE_2D);  else glDisable(GL_TEXTURE_2D);
+    if (inEnableLighting)       glEnable(GL_LIGHTING);    else glDisable(GL_LIGHTING);
+    if (inEnableAlphaTesting)   glEnable(GL_ALPHA_TEST);  else glDisable(GL_ALPHA_TEST);
+    if (inEnableAlphaBlending) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else
+        glDisable(GL_BLEND);
+    if (inEnableDepthTesting)   glEnable(GL_DEPTH_TEST);  else glDisable(GL_DEPTH_TEST);
+    glDepthMask(inEnableDepthWriting ? GL_TRUE : GL_FALSE);
+}
+
+void XPLMBindTexture2d (int inTextureNum, int inTextureUnit)
+{
+    glActiveTexture(GLenum(GL_TEXTURE0 + inTextureUnit));
+    glBindTexture(GL_TEXTURE_2D, GLuint(inTextureNum));
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void XPLMGenerateTextureNumbers (int* outTextureIDs, int inCount)
+{
+    std::vector<GLuint> ids(size_t(std::max(inCount, 0)));
+    glGenTextures(GLsizei(ids.size()), ids.data());
+    for (size_t i = 0; i < ids.size(); i++)
+        outTextureIDs[i] = int(ids[i]);
+}
+
+//
+// MARK: XPLMProcessing
+//
+
+XPLMFlightLoopID XPLMCreateFlightLoop (XPLMCreateFlightLoop_t* inParams)
+{
+    gFlightLoops.emplace_back(new StubFlightLoop());
+    StubFlightLoop* fl = gFlightLoops.back().get();
+    fl->params = *inParams;
+    fl->lastCallTime = gElapsed;
+    return fl;
+}
+
+void XPLMDestroyFlightLoop (XPLMFlightLoopID inFlightLoopID)
+{
+    gFlightLoops.erase(std::remove_if(gFlightLoops.begin(), gFlightLoops.end(),
+                                      [inFlightLoopID](const std::unique_ptr<StubFlightLoop>& fl)
+                                      { return fl.get() == inFlightLoopID; }),
+                       gFlightLoops.end());
+}
+
+void XPLMScheduleFlightLoop (XPLMFlightLoopID inFlightLoopID, float inInterval, int inRelativeToNow)
+{
+    StubFlightLoop* fl = findFlightLoop(inFlightLoopID);
+    if (!fl) return;
+    const double base = inRelativeToNow ? gElapsed : fl->lastCallTime;
+    fl->bScheduled = inInterval != 0.0f;
+    fl->bByCycles  = inInterval < 0.0f;
+    if (fl->bByCycles)
+        fl->nextCycle = gCycle + int(-inInterval);
+    else
+        fl->nextTime = base + double(inInterval);
+}
+
+float XPLMGetElapsedTime ()
+{
+    return float(gElapsed);
+}
+
+int XPLMGetCycleNumber ()
+{
+    return gCycle;
+}
+
+//
+// MARK: XPLMDataAccess
+//
+
+XPLMDataRef XPLMFindDataRef (const char* inDataRefName)
+{
+    auto it = gDataRefs.find(inDataRefName);
+    return it == gDataRefs.end() ? nullptr : &it->second;
+}
+
+int XPLMGetDatai (XPLMDataRef inDataRef)
+{
+    return inDataRef ? static_cast<StubDataRef*>(inDataRef)->i : 0;
+}
+
+float XPLMGetDataf (XPLMDataRef inDataRef)
+{
+    return inDataRef ? static_cast<StubDataRef*>(inDataRef)->f : 0.0f;
+}
+
+int XPLMGetDatavf (XPLMDataRef inDataRef, float* outValues, int inOffset, int inMax)
+{
+    if (!inDataRef) return 0;
+    const std::vector<float>& v = static_cast<StubDataRef*>(inDataRef)->vf;
+    if (!outValues) return int(v.size());
+    int n = 0;
+    for (; n < inMax && size_t(inOffset + n) < v.size(); n++)
+        outValues[n] = v[size_t(inOffset + n)];
+    return n;
+}
+
+int XPLMGetDatavi (XPLMDataRef inDataRef, int* outValues, int inOffset, int inMax)
+{
+    if (!inDataRef) return 0;
+    const std::vector<int>& v = static_cast<StubDataRef*>(inDataRef)->vi;
+    if (!outValues) return int(v.size());
+    int n = 0;
+    for (; n < inMax && size_t(inOffset + n) < v.size(); n++)
+        outValues[n] = v[size_t(inOffset + n)];
+    return n;
+}
+
+//
+// MARK: XPLMUtilities
+//
+
+void XPLMDebugString (const char* inString)
+{
+    std::fputs(inString, stderr);
+}
+
+void XPLMEnableFeature (const char*, int) {}
+
+void XPLMGetSystemPath (char* outSystemPath)
+{
+    // X-Plane's buffer is expected to be 512 bytes
+    std::strncpy(outSystemPath, gSystemPath.c_str(), 511);
+    outSystemPath[511] = '\0';
+}
+
+const char* XPLMGetDirectorySeparator ()
+{
+    return "/";
+}
+
+//
+// MARK: XPLMMenus
+//
+
+XPLMMenuID XPLMFindPluginsMenu ()
+{
+    if (gMenus.empty())
+        gMenus.emplace_back(new StubMenu());
+    return gMenus.front().get();
+}
+
+XPLMMenuID XPLMCreateMenu (const char*, XPLMMenuID, int, XPLMMenuHandler_f inHandler, void* inMenuRef)
+{
+    XPLMFindPluginsMenu();
+    gMenus.emplace_back(new StubMenu());
+    gMenus.back()->handler = inHandler;
+    gMenus.back()->menuRef = inMenuRef;
+    return gMenus.back().get();
+}
+
+int XPLMAppendMenuItem (XPLMMenuID inMenu, const char*, void* inItemRef, int)
+{
+    StubMenu* m = static_cast<StubMenu*>(inMenu);
+    m->itemRefs.push_back(inItemRef);
+    return int(m->itemRefs.size() - 1);
+}
+
+void XPLMAppendMenuSeparator (XPLMMenuID inMenu)
+{
+    static_cast<StubMenu*>(inMenu)->itemRefs.push_back(nullptr);
+}
+
+void XPLMCheckMenuItem (XPLMMenuID, int, XPLMMenuCheck)    {}
+void XPLMEnableMenuItem (XPLMMenuID, int, int)              {}
@@ -0,0 +1,87 @@
+/*
+ * XPLMStub.h
+ *
+ * Integration for dear imgui into X-Plane: Headless XPLM Stand-In
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Implements the XPLM functions FlightMAX calls, so that ImgWindow and
+ * the plugin's windows can run outside X-Plane.  Windows, flight loops,
+ * datarefs and menus are kept in simple lists; X-Plane's part of the
+ * deal (running flight loops, drawing windows, delivering input) is
+ * done by the functions below, which the harness calls.
+ *
+ * Not thread-safe, just like the real thing is to be called from the
+ * main thread only.
+ */
+
+#ifndef XPLMSTUB_H
+#define XPLMSTUB_H
+
+#include "XPLMDisplay.h"
+#include "XPLMMenus.h"
+
+namespace XPLMStub {
+
+/** Set screen size in boxels, sets up matching view matrices and viewport */
+void Init (int screenWidth, int screenHeight);
+
+/** Run one sim frame: advance time by `period` seconds,
+ *  run all due flight loops, then draw all visible windows bottom to top */
+void RunFrame (float period);
+
+/** Move the mouse, delivered to the topmost window below it
+ *  (or to the window which received the mouse down while dragging) */
+void MouseMove (int x, int y);
+/** Mouse button down/up at a position */
+void MouseButton (int x, int y, XPLMMouseStatus status);
+/** Mouse wheel, vertical (`wheel = 0`) or horizontal (`wheel = 1`) */
+void MouseWheel (int x, int y, int wheel, int clicks);
+/** Key press/release, delivered to the window with keyboard focus */
+void Key (char key, XPLMKeyFlags flags, char virtualKey);
+
+/** Select a menu item as if the user clicked it */
+void SelectMenuItem (XPLMMenuID menu, int index);
+/** The menu created by the plugin (first one passed to XPLMCreateMenu) */
+XPLMMenuID PluginMenu ();
+
+/** Number of existing windows/flight loops (for leak checks) */
+int NumWindows ();
+int NumFlightLoops ();
+/** Geometry of the n-th window in creation order, `false` if there is no such window */
+bool WindowGeometry (int n, int& left, int& top, int& right, int& bottom);
+
+/** X-Plane's root folder, reported by XPLMGetSystemPath (with trailing separator) */
+void SetSystemPath (const char* path);
+
+}
+
+#endif // XPLMSTUB_H
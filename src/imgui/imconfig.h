@@ -85,6 +85,10 @@
 // Another way to allow large meshes while keeping 16-bit indices is to handle ImDrawCmd::VtxOffset in your renderer.
 // Read about ImGuiBackendFlags_RendererHasVtxOffset for details.
 //#define ImDrawIdx unsigned int
+// FlightMAX: ImgWindow handles VtxOffset, 32-bit indices are a build option (FLIGHTMAX_IMGUI_32BIT_INDICES in CMakeLists.txt)
+#ifdef FLIGHTMAX_IMDRAWIDX_32
+#define ImDrawIdx unsigned int
+#endif
 
 //---- Override ImDrawCallback signature (will need to modify renderer backends accordingly)
 //struct ImDrawList;
@@ -0,0 +1,680 @@
+/*
+ * FontSubset.cpp
+ *
+ * FlightMAX build tool: Icon Font Subsetting
+ *
+ * Copyright (C) 2021, FlightMAX contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Build tool, runs on the host: Finds the ICON_FA_* icons the plugin's
+ * sources actually use and cuts just their glyphs out of the icon font.
+ * Writes
+ *  - the subsetted font, compressed the way binary_to_compressed_c.cpp does,
+ *    for ImFontAtlas::AddFontFromMemoryCompressedTTF(), and
+ *  - a header with the glyph ranges of these icons (ICONS_USED_RANGES).
+ * Outputs are only rewritten if their content changed.
+ *
+ * Usage: FontSubset <font.inc|font.ttf> <IconsFontAwesome5.h> <out.inc> <out.h> <source>...
+ *
+ * The font can be a TTF file or binary_to_compressed_c's output (not base85).
+ * The symbol of the latter is kept, so code using it needn't change.
+ * The subset keeps the glyph outlines, metrics and hinting programs, plus the
+ * name and OS/2 tables, and maps the icons with a single format 12 cmap.
+ * Layout tables (GSUB, GPOS, kern, ...) are dropped, icons don't need them.
+ */
+
+// stb_compress() of ImGui's own converter, so the output is what it would write
+#define main binary_to_compressed_c_main
+#include "../imgui/misc/fonts/binary_to_compressed_c.cpp"
+#undef main
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::vector<unsigned char> Bytes;
+
+namespace decompress {
+
+// Decompression from stb.h (public domain) by Sean Barrett, as in imgui_draw.cpp
+
+static unsigned int stb_decompress_length(const unsigned char *input)
+{
+    return (input[8] << 24) + (input[9] << 16) + (input[10] << 8) + input[11];
+}
+
+static unsigned char *stb__barrier_out_e, *stb__barrier_out_b;
+static const unsigned char *stb__barrier_in_b;
+static unsigned char *stb__dout;
+static void stb__match(const unsigned char *data, unsigned int length)
+{
+    // INVERSE of memmove... write each byte before copying the next...
+    if (stb__dout + length > stb__barrier_out_e) { stb__dout += length; return; }
+    if (data < stb__barrier_out_b) { stb__dout = stb__barrier_out_e+1; return; }
+    while (length--) *stb__dout++ = *data++;
+}
+
+static void stb__lit(const unsigned char *data, unsigned int length)
+{
+    if (stb__dout + length > stb__barrier_out_e) { stb__dout += length; return; }
+    if (data < stb__barrier_in_b) { stb__dout = stb__barrier_out_e+1; return; }
+    memcpy(stb__dout, data, length);
+    stb__dout += length;
+}
+
+#define stb__in2(x)   ((i[x] << 8) + i[(x)+1])
+#define stb__in3(x)   ((i[x] << 16) + stb__in2((x)+1))
+#define stb__in4(x)   ((i[x] << 24) + stb__in3((x)+1))
+
+static const unsigned char *stb_decompress_token(const unsigned char *i)
+{
+    if (*i >= 0x20) { // use fewer if's for cases that expand small
+        if (*i >= 0x80)       stb__match(stb__dout-i[1]-1, i[0] - 0x80 + 1), i += 2;
+        else if (*i >= 0x40)  stb__match(stb__dout-(stb__in2(0) - 0x4000 + 1), i[2]+1), i += 3;
+        else /* *i >= 0x20 */ stb__lit(i+1, i[0] - 0x20 + 1), i += 1 + (i[0] - 0x20 + 1);
+    } else { // more ifs for cases that expand large, since overhead is amortized
+        if (*i >= 0x18)       stb__match(stb__dout-(stb__in3(0) - 0x180000 + 1), i[3]+1), i += 4;
+        else if (*i >= 0x10)  stb__match(stb__dout-(stb__in3(0) - 0x100000 + 1), stb__in2(3)+1), i += 5;
+        else if (*i >= 0x08)  stb__lit(i+2, stb__in2(0) - 0x0800 + 1), i += 2 + (stb__in2(0) - 0x0800 + 1);
+        else if (*i == 0x07)  stb__lit(i+3, stb__in2(1) + 1), i += 3 + (stb__in2(1) + 1);
+        else if (*i == 0x06)  stb__match(stb__dout-(stb__in3(1)+1), i[4]+1), i += 5;
+        else if (*i == 0x04)  stb__match(stb__dout-(stb__in3(1)+1), stb__in2(4)+1), i += 6;
+    }
+    return i;
+}
+
+static unsigned int stb_decompress(unsigned char *output, const unsigned char *i, unsigned int /*length*/)
+{
+    if (stb__in4(0) != 0x57bC0000) return 0;
+    if (stb__in4(4) != 0)          return 0; // error! stream is > 4GB
+    const unsigned int olen = stb_decompress_length(i);
+    stb__barrier_in_b = i;
+    stb__barrier_out_e = output + olen;
+    stb__barrier_out_b = output;
+    i += 16;
+
+    stb__dout = output;
+    for (;;) {
+        const unsigned char *old_i = i;
+        i = stb_decompress_token(i);
+        if (i == old_i) {
+            if (*i == 0x05 && i[1] == 0xfa) {
+                if (stb__dout != output + olen) return 0;
+                if (stb_adler32(1, output, olen) != (unsigned int) stb__in4(2))
+                    return 0;
+                return olen;
+            } else {
+                return 0;
+            }
+        }
+        if (stb__dout > output + olen)
+            return 0;
+    }
+}
+
+#undef stb__in2
+#undef stb__in3
+#undef stb__in4
+
+}
+
+namespace {
+
+//
+// MARK: Files
+//
+
+bool readFile (const std::string& path, std::string& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+        return false;
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+/** Write `content` unless the file has it already, so dependents don't rebuild for nothing */
+bool writeIfChanged (const std::string& path, const std::string& content)
+{
+    std::string old;
+    if (readFile(path, old) && old == content)
+        return true;
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f << content;
+    return bool(f);
+}
+
+/** Get the font out of binary_to_compressed_c's output
+ * @param[out] symbol The symbol the data was exported as */
+bool loadInc (const std::string& text, Bytes& ttf, std::string& symbol)
+{
+    // static const unsigned int <name>_data[<size>/4] =
+    const size_t dataPos = text.find("_data[");
+    if (dataPos == std::string::npos)
+        return false;
+    const size_t nameStart = text.find_last_of(" \t", dataPos) + 1;
+    const std::string name = text.substr(nameStart, dataPos - nameStart);
+    const std::string compressedSuffix = "_compressed";
+    const bool bCompressed = name.size() > compressedSuffix.size() &&
+        name.compare(name.size() - compressedSuffix.size(), std::string::npos, compressedSuffix) == 0;
+    symbol = bCompressed ? name.substr(0, name.size() - compressedSuffix.size()) : name;
+
+    const std::string sizeKey = name + "_size = ";
+    const size_t sizePos = text.find(sizeKey);
+    if (sizePos == std::string::npos)
+        return false;
+    const unsigned long size = std::strtoul(text.c_str() + sizePos + sizeKey.size(), nullptr, 10);
+
+    // The words hold the bytes in little endian order
+    Bytes raw;
+    const size_t end = text.find('}', dataPos);
+    for (size_t p = text.find("0x", dataPos); p < end; p = text.find("0x", p + 2)) {
+        const unsigned long w = std::strtoul(text.c_str() + p, nullptr, 16);
+        for (int b = 0; b < 4; b++)
+            raw.push_back((unsigned char)(w >> (8 * b)));
+    }
+    if (raw.size() < size)
+        return false;
+    raw.resize(size);
+
+    if (!bCompressed) {
+        ttf = raw;
+        return true;
+    }
+    ttf.resize(decompress::stb_decompress_length(raw.data()));
+    return decompress::stb_decompress(ttf.data(), raw.data(), (unsigned int)raw.size()) == ttf.size();
+}
+
+/** Format `data` as binary_to_compressed_c would, compressed */
+std::string toCompressedC (const Bytes& ttf, const std::string& symbol, const std::string& comment)
+{
+    // stb_compress may look a few bytes beyond the end
+    Bytes data(ttf);
+    data.resize(ttf.size() + 4, 0);
+    Bytes compressed(ttf.size() + 512 + (ttf.size() >> 2) + sizeof(int), 0);
+    const size_t compressedSize = stb_compress(compressed.data(), data.data(), (stb_uint)ttf.size());
+
+    std::string out = comment;
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "static const unsigned int %s_compressed_size = %d;\n", symbol.c_str(), int(compressedSize));
+    out += buf;
+    std::snprintf(buf, sizeof(buf), "static const unsigned int %s_compressed_data[%d/4] =\n{", symbol.c_str(), int((compressedSize + 3) / 4) * 4);
+    out += buf;
+    for (size_t i = 0, column = 0; i < compressedSize; i += 4, column++) {
+        const unsigned int d = compressed[i] | (compressed[i + 1] << 8) | (compressed[i + 2] << 16) | ((unsigned int)compressed[i + 3] << 24);
+        std::snprintf(buf, sizeof(buf), (column % 12) == 0 ? "\n    0x%08x, " : "0x%08x, ", d);
+        out += buf;
+    }
+    out += "\n};\n";
+    return out;
+}
+
+//
+// MARK: Icons
+//
+
+/** Read the `#define ICON_FA_NAME u8""` lines: name -> codepoint */
+std::map<std::string, unsigned> readIconDefines (const std::string& text)
+{
+    std::map<std::string, unsigned> icons;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string define, name, value;
+        if (!(ls >> define >> name >> value) || define != "#define" || name.compare(0, 8, "ICON_FA_") != 0)
+            continue;
+        // Either a \u escape or UTF-8 bytes as \x escapes
+        unsigned cp = 0;
+        const size_t u = value.find("\\u");
+        if (u != std::string::npos)
+            cp = (unsigned)std::strtoul(value.substr(u + 2, 4).c_str(), nullptr, 16);
+        else {
+            std::vector<unsigned> bytes;
+            for (size_t x = value.find("\\x"); x != std::string::npos; x = value.find("\\x", x + 2))
+                bytes.push_back((unsigned)std::strtoul(value.substr(x + 2, 2).c_str(), nullptr, 16));
+            if (bytes.size() == 3)
+                cp = ((bytes[0] & 0x0f) << 12) | ((bytes[1] & 0x3f) << 6) | (bytes[2] & 0x3f);
+            else if (bytes.size() == 4)
+                cp = ((bytes[0] & 0x07) << 18) | ((bytes[1] & 0x3f) << 12) | ((bytes[2] & 0x3f) << 6) | (bytes[3] & 0x3f);
+        }
+        if (cp)
+            icons[name] = cp;
+    }
+    return icons;
+}
+
+bool isIdentChar (char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/** Add the names of all ICON_FA_* identifiers in `text` */
+void scanIconUses (const std::string& text, std::set<std::string>& used)
+{
+    for (size_t p = text.find("ICON_FA_"); p != std::string::npos; p = text.find("ICON_FA_", p + 1)) {
+        if (p > 0 && isIdentChar(text[p - 1]))
+            continue;
+        size_t e = p;
+        while (e < text.size() && isIdentChar(text[e]))
+            e++;
+        if (e > p + 8)                          // not just the prefix, as in comments
+            used.insert(text.substr(p, e - p));
+    }
+}
+
+//
+// MARK: TrueType
+//
+
+unsigned rd16 (const Bytes& d, size_t o) { return o + 2 <= d.size() ? (d[o] << 8) | d[o + 1] : 0; }
+unsigned rd32 (const Bytes& d, size_t o) { return o + 4 <= d.size() ? ((unsigned)d[o] << 24) | (d[o + 1] << 16) | (d[o + 2] << 8) | d[o + 3] : 0; }
+void put16 (Bytes& d, size_t o, unsigned v) { d[o] = (unsigned char)(v >> 8); d[o + 1] = (unsigned char)v; }
+void put32 (Bytes& d, size_t o, unsigned v) { put16(d, o, v >> 16); put16(d, o + 2, v & 0xffff); }
+void add16 (Bytes& d, unsigned v) { d.push_back((unsigned char)(v >> 8)); d.push_back((unsigned char)v); }
+void add32 (Bytes& d, unsigned v) { add16(d, v >> 16); add16(d, v & 0xffff); }
+
+/** The tables of a TrueType font, read-only */
+class TrueType {
+public:
+    explicit TrueType (const Bytes& data): mData(data)
+    {
+        const unsigned numTables = rd16(mData, 4);
+        for (unsigned t = 0; t < numTables; t++) {
+            const size_t rec = 12 + 16 * size_t(t);
+            const unsigned offset = rd32(mData, rec + 8), length = rd32(mData, rec + 12);
+            if (size_t(offset) + length <= mData.size())
+                mTables[std::string(reinterpret_cast<const char*>(&mData[rec]), 4)] =
+                    Bytes(mData.begin() + offset, mData.begin() + offset + length);
+        }
+    }
+
+    bool isValid () const
+    {
+        for (const char* tag: { "cmap", "glyf", "head", "hhea", "hmtx", "loca", "maxp" })
+            if (!mTables.count(tag))
+                return false;
+        return true;
+    }
+
+    const Bytes* table (const std::string& tag) const
+    {
+        auto it = mTables.find(tag);
+        return it == mTables.end() ? nullptr : &it->second;
+    }
+
+    unsigned numGlyphs () const { return rd16(*table("maxp"), 4); }
+
+    /** Glyph index of codepoint `c`, 0 if missing (cmap format 4 or 12) */
+    unsigned glyphIndex (unsigned c) const
+    {
+        const Bytes& cmap = *table("cmap");
+        const unsigned numSub = rd16(cmap, 2);
+        for (unsigned s = 0; s < numSub; s++) {
+            const unsigned platform = rd16(cmap, 4 + 8 * s), encoding = rd16(cmap, 6 + 8 * s);
+            if (!(platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10))))
+                continue;
+            const size_t sub = rd32(cmap, 8 + 8 * s);
+            const unsigned format = rd16(cmap, sub);
+            if (format == 12) {
+                const unsigned numGroups = rd32(cmap, sub + 12);
+                for (unsigned g = 0; g < numGroups; g++) {
+                    const size_t grp = sub + 16 + 12 * size_t(g);
+                    if (c >= rd32(cmap, grp) && c <= rd32(cmap, grp + 4))
+                        return rd32(cmap, grp + 8) + (c - rd32(cmap, grp));
+                }
+            } else if (format == 4 && c <= 0xffff) {
+                const unsigned segX2 = rd16(cmap, sub + 6);
+                const size_t ends = sub + 14, starts = ends + segX2 + 2;
+                const size_t deltas = starts + segX2, rangeOffsets = deltas + segX2;
+                for (unsigned i = 0; i < segX2; i += 2) {
+                    if (rd16(cmap, ends + i) < c)
+                        continue;
+                    const unsigned start = rd16(cmap, starts + i);
+                    if (c < start)
+                        break;
+                    const unsigned delta = rd16(cmap, deltas + i), ro = rd16(cmap, rangeOffsets + i);
+                    if (!ro)
+                        return (c + delta) & 0xffff;
+                    const unsigned g = rd16(cmap, rangeOffsets + i + ro + 2 * (c - start));
+                    return g ? (g + delta) & 0xffff : 0;
+                }
+            }
+        }
+        return 0;
+    }
+
+    /** Outline data of glyph `g` (may be empty) */
+    Bytes glyph (unsigned g) const
+    {
+        const Bytes& loca = *table("loca");
+        const Bytes& glyf = *table("glyf");
+        const bool bLong = rd16(*table("head"), 50) != 0;
+        const size_t from = bLong ? rd32(loca, 4 * g)     : 2 * size_t(rd16(loca, 2 * g));
+        const size_t to   = bLong ? rd32(loca, 4 * g + 4) : 2 * size_t(rd16(loca, 2 * g + 2));
+        if (from >= to || to > glyf.size())
+            return Bytes();
+        return Bytes(glyf.begin() + from, glyf.begin() + to);
+    }
+
+    /** Advance width and left side bearing of glyph `g` */
+    void hMetrics (unsigned g, unsigned& advance, unsigned& lsb) const
+    {
+        const Bytes& hmtx = *table("hmtx");
+        const unsigned numHMetrics = rd16(*table("hhea"), 34);
+        if (g < numHMetrics) {
+            advance = rd16(hmtx, 4 * g);
+            lsb     = rd16(hmtx, 4 * g + 2);
+        } else {
+            advance = rd16(hmtx, 4 * (numHMetrics - 1));
+            lsb     = rd16(hmtx, 4 * numHMetrics + 2 * (g - numHMetrics));
+        }
+    }
+
+private:
+    const Bytes&                    mData;
+    std::map<std::string, Bytes>    mTables;
+};
+
+// Composite glyph flags
+constexpr unsigned ARG_1_AND_2_ARE_WORDS    = 0x0001;
+constexpr unsigned WE_HAVE_A_SCALE          = 0x0008;
+constexpr unsigned MORE_COMPONENTS          = 0x0020;
+constexpr unsigned WE_HAVE_AN_X_AND_Y_SCALE = 0x0040;
+constexpr unsigned WE_HAVE_A_TWO_BY_TWO     = 0x0080;
+
+/** Offsets of the component glyph indexes in a composite glyph (none for simple glyphs) */
+std::vector<size_t> componentOffsets (const Bytes& glyph)
+{
+    std::vector<size_t> offsets;
+    if (glyph.size() < 10 || (short)rd16(glyph, 0) >= 0)
+        return offsets;
+    size_t p = 10;
+    unsigned flags;
+    do {
+        flags = rd16(glyph, p);
+        offsets.push_back(p + 2);
+        p += 4 + ((flags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2);
+        if (flags & WE_HAVE_A_SCALE)                p += 2;
+        else if (flags & WE_HAVE_AN_X_AND_Y_SCALE)  p += 4;
+        else if (flags & WE_HAVE_A_TWO_BY_TWO)      p += 8;
+    } while ((flags & MORE_COMPONENTS) && p + 4 <= glyph.size());
+    return offsets;
+}
+
+unsigned checksum (const Bytes& d)
+{
+    unsigned sum = 0;
+    for (size_t i = 0; i < d.size(); i += 4)
+        sum += ((unsigned)d[i] << 24) |
+               ((i + 1 < d.size() ? d[i + 1] : 0) << 16) |
+               ((i + 2 < d.size() ? d[i + 2] : 0) << 8) |
+                (i + 3 < d.size() ? d[i + 3] : 0);
+    return sum;
+}
+
+/** A font with just the glyphs for `codepoints` (and .notdef) */
+Bytes subset (const TrueType& font, const std::set<unsigned>& codepoints)
+{
+    // Glyphs to keep, including components of composites
+    std::set<unsigned> keep = { 0 };
+    std::vector<unsigned> todo;
+    for (unsigned c: codepoints)
+        todo.push_back(font.glyphIndex(c));
+    while (!todo.empty()) {
+        const unsigned g = todo.back();
+        todo.pop_back();
+        if (g >= font.numGlyphs() || !keep.insert(g).second)
+            continue;
+        const Bytes outline = font.glyph(g);
+        for (size_t o: componentOffsets(outline))
+            todo.push_back(rd16(outline, o));
+    }
+    // ...numbered anew in their original order
+    std::map<unsigned, unsigned> newIndex;
+    for (unsigned g: keep)
+        newIndex.emplace(g, unsigned(newIndex.size()));
+
+    std::map<std::string, Bytes> tables;
+    Bytes& glyf = tables["glyf"];
+    Bytes& loca = tables["loca"];
+    Bytes& hmtx = tables["hmtx"];
+    for (unsigned g: keep) {
+        Bytes outline = font.glyph(g);
+        for (size_t o: componentOffsets(outline))
+            put16(outline, o, newIndex[rd16(outline, o)]);
+        outline.resize((outline.size() + 3) & ~size_t(3), 0);
+        add32(loca, unsigned(glyf.size()));
+        glyf.insert(glyf.end(), outline.begin(), outline.end());
+
+        unsigned advance, lsb;
+        font.hMetrics(g, advance, lsb);
+        add16(hmtx, advance);
+        add16(hmtx, lsb);
+    }
+    add32(loca, unsigned(glyf.size()));
+
+    Bytes& head = tables["head"] = *font.table("head");
+    put32(head, 8, 0);                          // checkSumAdjustment, set below
+    put16(head, 50, 1);                         // long loca offsets
+    Bytes& hhea = tables["hhea"] = *font.table("hhea");
+    put16(hhea, 34, unsigned(keep.size()));     // all glyphs have full metrics
+    Bytes& maxp = tables["maxp"] = *font.table("maxp");
+    put16(maxp, 4, unsigned(keep.size()));
+
+    // post version 3: no glyph names
+    Bytes& post = tables["post"];
+    if (const Bytes* p = font.table("post"))
+        post.assign(p->begin(), p->begin() + std::min(p->size(), size_t(32)));
+    post.resize(32, 0);
+    put32(post, 0, 0x00030000);
+
+    // cmap: one format 12 subtable, consecutive codepoints and glyphs share a group
+    std::vector<std::pair<unsigned, unsigned>> map;             // codepoint, new glyph
+    for (unsigned c: codepoints)
+        if (const unsigned g = font.glyphIndex(c))
+            map.emplace_back(c, newIndex[g]);
+    std::vector<unsigned> groups;                               // start, end, glyph
+    for (const auto& m: map) {
+        if (!groups.empty() && m.first == groups[groups.size() - 2] + 1 &&
+            m.second == groups.back() + (m.first - groups[groups.size() - 3]))
+            groups[groups.size() - 2] = m.first;
+        else
+            groups.insert(groups.end(), { m.first, m.first, m.second });
+    }
+    Bytes& cmap = tables["cmap"];
+    add16(cmap, 0);                             // version
+    add16(cmap, 1);                             // one subtable:
+    add16(cmap, 3);                             // Windows
+    add16(cmap, 10);                            // Unicode full repertoire
+    add32(cmap, 12);                            // offset
+    add16(cmap, 12);                            // format
+    add16(cmap, 0);
+    add32(cmap, unsigned(16 + 4 * groups.size()));
+    add32(cmap, 0);                             // language
+    add32(cmap, unsigned(groups.size() / 3));
+    for (unsigned v: groups)
+        add32(cmap, v);
+
+    // taken as they are: naming, metrics, and hinting programs the outlines may call
+    for (const char* tag: { "name", "OS/2", "cvt ", "fpgm", "prep", "gasp" })
+        if (const Bytes* t = font.table(tag))
+            tables[tag] = *t;
+
+    // Table directory, tables sorted by tag, each 4-byte aligned
+    const unsigned numTables = unsigned(tables.size());
+    unsigned searchRange = 1, entrySelector = 0;
+    while (searchRange * 2 <= numTables) {
+        searchRange *= 2;
+        entrySelector++;
+    }
+    Bytes out;
+    add32(out, 0x00010000);
+    add16(out, numTables);
+    add16(out, searchRange * 16);
+    add16(out, entrySelector);
+    add16(out, numTables * 16 - searchRange * 16);
+    size_t offset = 12 + 16 * size_t(numTables);
+    size_t headOffset = 0;
+    for (const auto& t: tables) {
+        out.insert(out.end(), t.first.begin(), t.first.end());
+        add32(out, checksum(t.second));
+        add32(out, unsigned(offset));
+        add32(out, unsigned(t.second.size()));
+        if (t.first == "head")
+            headOffset = offset;
+        offset += (t.second.size() + 3) & ~size_t(3);
+    }
+    for (const auto& t: tables) {
+        out.insert(out.end(), t.second.begin(), t.second.end());
+        out.resize((out.size() + 3) & ~size_t(3), 0);
+    }
+    put32(out, headOffset + 8, 0xB1B0AFBA - checksum(out));
+    return out;
+}
+
+}
+
+int main (int argc, char** argv)
+{
+    if (argc < 5) {
+        std::fprintf(stderr, "Usage: %s <font.inc|font.ttf> <IconsFontAwesome5.h> <out.inc> <out.h> <source>...\n", argv[0]);
+        return 1;
+    }
+    const std::string fontPath = argv[1], iconsPath = argv[2], outInc = argv[3], outHeader = argv[4];
+
+    // The font, and the symbol its data goes by
+    std::string text;
+    if (!readFile(fontPath, text)) {
+        std::fprintf(stderr, "FontSubset: Can't read %s\n", fontPath.c_str());
+        return 1;
+    }
+    Bytes ttf;
+    std::string symbol;
+    if (text.compare(0, 4, std::string("\0\1\0\0", 4)) == 0 || text.compare(0, 4, "true") == 0) {
+        ttf.assign(text.begin(), text.end());
+        const size_t slash = fontPath.find_last_of("/\\");
+        symbol = fontPath.substr(slash == std::string::npos ? 0 : slash + 1);
+        symbol = symbol.substr(0, symbol.find('.'));
+        for (char& c: symbol)
+            if (!isIdentChar(c))
+                c = '_';
+    } else if (!loadInc(text, ttf, symbol)) {
+        std::fprintf(stderr, "FontSubset: %s is neither TTF nor binary_to_compressed_c output\n", fontPath.c_str());
+        return 1;
+    }
+    const TrueType font(ttf);
+    if (!font.isValid()) {
+        std::fprintf(stderr, "FontSubset: %s lacks TrueType tables\n", fontPath.c_str());
+        return 1;
+    }
+
+    // Which icons are there, which are used?
+    if (!readFile(iconsPath, text)) {
+        std::fprintf(stderr, "FontSubset: Can't read %s\n", iconsPath.c_str());
+        return 1;
+    }
+    const std::map<std::string, unsigned> icons = readIconDefines(text);
+    std::set<std::string> used;
+    for (int i = 5; i < argc; i++) {
+        if (argv[i] == iconsPath)
+            continue;
+        if (!readFile(argv[i], text)) {
+            std::fprintf(stderr, "FontSubset: Can't read %s\n", argv[i]);
+            return 1;
+        }
+        scanIconUses(text, used);
+    }
+    std::map<unsigned, std::string> codepoints;                 // codepoint -> names
+    for (const std::string& name: used) {
+        const auto it = icons.find(name);
+        if (it == icons.end()) {
+            std::fprintf(stderr, "FontSubset: warning: %s is not defined in %s\n", name.c_str(), iconsPath.c_str());
+            continue;
+        }
+        std::string& names = codepoints[it->second];
+        names += (names.empty() ? "" : ", ") + name;
+    }
+    std::set<unsigned> cpSet;
+    for (const auto& cp: codepoints) {
+        if (!font.glyphIndex(cp.first))
+            std::fprintf(stderr, "FontSubset: warning: %s has no glyph in %s\n", cp.second.c_str(), fontPath.c_str());
+        cpSet.insert(cp.first);
+    }
+
+    // The subsetted font...
+    const Bytes sub = subset(font, cpSet);
+    const std::string fontName = fontPath.substr(fontPath.find_last_of("/\\") + 1);
+    std::ostringstream comment;
+    comment << "// Subset of '" << fontName << "' (" << ttf.size() << " bytes) to the "
+            << cpSet.size() << " icons used (" << sub.size() << " bytes)\n"
+            << "// Generated by tools/FontSubset.cpp at build time, don't edit\n";
+    if (!writeIfChanged(outInc, toCompressedC(sub, symbol, comment.str()))) {
+        std::fprintf(stderr, "FontSubset: Can't write %s\n", outInc.c_str());
+        return 1;
+    }
+
+    // ...and its glyph ranges
+    std::ostringstream header;
+    header << "// Glyph ranges of the ICON_FA_* icons used in the sources\n"
+           << "// Generated by tools/FontSubset.cpp at build time, don't edit\n\n"
+           << "#ifndef ICONS_USED_H\n#define ICONS_USED_H\n\n"
+           << "/** Number of icons in the subsetted icon font */\n"
+           << "constexpr int ICONS_USED_COUNT = " << cpSet.size() << ";\n\n"
+           << "/** Pairs of first and last codepoint, 0-terminated, for ImFontAtlas::AddFont*() */\n"
+           << "constexpr ImWchar ICONS_USED_RANGES[] = {\n";
+    char buf[64];
+    for (auto it = codepoints.begin(); it != codepoints.end(); ) {
+        const unsigned first = it->first;
+        std::string names = it->second;
+        unsigned last = first;
+        for (++it; it != codepoints.end() && it->first == last + 1; ++it) {
+            last = it->first;
+            names += ", " + it->second;
+        }
+        std::snprintf(buf, sizeof(buf), "    0x%04x, 0x%04x,     // ", first, last);
+        header << buf << names << "\n";
+    }
+    header << "    0\n};\n\n#endif // ICONS_USED_H\n";
+    if (!writeIfChanged(outHeader, header.str())) {
+        std::fprintf(stderr, "FontSubset: Can't write %s\n", outHeader.c_str());
+        return 1;
+    }
+
+    std::printf("FontSubset: %zu icons, %zu of %zu bytes of %s\n",
+                cpSet.size(), sub.size(), ttf.size(), fontName.c_str());
+    return 0;
+}